@@ -0,0 +1,1019 @@
+#include "asset.h"
+#include "defrag.h"
+#include "draw.h"
+#include "indirect.h"
+#include "offscreen.h"
+#include "render.h"
+#include "residency.h"
+#include "resource.h"
+#include "scene.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+
+#ifndef ENGINE_ASSET_DIRECTORY
+#define ENGINE_ASSET_DIRECTORY "."
+#endif
+
+// Every heap allocation in the process is counted, including the record and submission threads
+std::atomic<uint64_t> allocation_count{0};
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    void* pointer = malloc(size > 0 ? size : 1);
+    if (pointer == nullptr) {
+        throw std::bad_alloc{};
+    }
+    return pointer;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* pointer) noexcept { free(pointer); }
+void operator delete[](void* pointer) noexcept { free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free(pointer); }
+
+enum Scenario {
+    SCENARIO_DRAWS,
+    SCENARIO_PIPELINES,
+    SCENARIO_RESIZE,
+    SCENARIO_UPLOADS,
+    SCENARIO_PIPELINE_FLOOD,
+    SCENARIO_INDIRECT,
+    SCENARIO_SORTED,
+    SCENARIO_INSTANCED,
+    SCENARIO_SCENE,
+    SCENARIO_DEFRAG,
+    SCENARIO_RESIDENCY,
+    SCENARIO_COUNT,
+};
+const char* scenario_names[SCENARIO_COUNT] = {"draws",     "pipelines", "resize",    "uploads", "pipeline_flood",
+                                              "indirect",  "sorted",    "instanced", "scene",   "defrag",
+                                              "residency"};
+
+struct BenchOptions {
+    std::vector<Scenario> scenarios{};
+    uint32_t frame_count = 500;
+    uint32_t warmup_frame_count = 50;
+    Extent3D extent = {1280, 720, 1};
+
+    uint32_t draw_count = 10000;
+    uint32_t pipeline_count = 16;
+    uint32_t resize_interval = 4;
+    VkDeviceSize upload_size = 16ull * 1024 * 1024;
+    uint32_t upload_interval = 1;
+    uint32_t flood_count = 4;
+    uint32_t object_count = 100000;
+    uint32_t node_count = 100000;
+    uint32_t fragment_count = 1024;
+    uint32_t texture_count = 256;
+    // Checks the objects the GPU kept against the host culling every frame, and fails the run on a mismatch
+    bool verify = false;
+    uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+
+    bool json = false;
+    std::string output{};
+};
+
+struct FrameSample {
+    double cpu_ms = 0.0;
+    double record_ms = 0.0;
+    double submit_ms = 0.0;
+    uint64_t allocations = 0;
+};
+/* Timestamps written by the record and submission threads for the frame occupying a slot. They are
+ * only read once the slot fence has been awaited, which orders them after both threads are done. */
+struct SlotTiming {
+    std::chrono::steady_clock::time_point record_begin{};
+    std::chrono::steady_clock::time_point record_end{};
+    std::chrono::steady_clock::time_point submit_call{};
+    std::chrono::steady_clock::time_point submitted{};
+    int64_t frame = -1;
+
+    // The range of surviving objects the host expects, within floating point tolerance of the planes
+    uint32_t expected_min_count = 0;
+    uint32_t expected_max_count = 0;
+};
+
+struct Summary {
+    double mean = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double max = 0.0;
+};
+struct ScenarioResult {
+    Scenario scenario;
+    uint32_t frame_count;
+    double seconds;
+    Summary cpu_ms;
+    Summary record_ms;
+    Summary submit_ms;
+    Summary allocations;
+    uint32_t verification_failure_count = 0;
+};
+
+render::OffscreenTarget* offscreen_target;
+render::Renderpass* renderpass;
+render::Framebuffer* framebuffer;
+std::vector<render::Pipeline*> pipelines{};
+render::CommandPool* command_pool;
+render::Fence* fence[MAX_FRAMES_IN_FLIGHT];
+
+render::Buffer* staging_buffer[MAX_FRAMES_IN_FLIGHT];
+render::Buffer* upload_buffer;
+
+core::ThreadPool* worker_pool;
+render::DrawQueue* draw_queue[MAX_FRAMES_IN_FLIGHT];
+std::vector<render::Pipeline*> instanced_pipelines{};
+render::DrawQueue* instanced_draw_queue[MAX_FRAMES_IN_FLIGHT];
+
+core::TransformHierarchy* transform_hierarchy;
+
+render::IndirectScene* indirect_scene;
+render::Pipeline* indirect_pipeline;
+render::Buffer* indirect_vertex_buffer;
+render::Buffer* indirect_index_buffer;
+render::Buffer* count_readback[MAX_FRAMES_IN_FLIGHT];
+
+// The resources the defrag scenario fragments device memory with, every other one is freed up front
+std::vector<render::Buffer*> fragment_buffers{};
+std::vector<render::Image*> fragment_images{};
+
+/* The textures of the residency scenario, one image per level from 32x32 up to 256x256. Levels are created by
+ * jobs on the worker pool and evicted through render::Retire, as a loader streaming from disk would. */
+const uint32_t STREAMED_LEVEL_COUNT = 4;
+struct StreamedTexture {
+    render::ResidentAsset* asset = nullptr;
+    render::Image* levels[STREAMED_LEVEL_COUNT]{};
+};
+std::vector<StreamedTexture*> streamed_textures{};
+
+Summary Summarize(std::vector<double> values) {
+    Summary summary{};
+    if (values.size() == 0) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    // Nearest rank, so every reported value is one that was actually measured
+    auto percentile = [&values](double p) {
+        size_t rank = (size_t)(p * values.size() + 0.999999);
+        return values[std::min(std::max(rank, (size_t)1), values.size()) - 1];
+    };
+    double total = 0.0;
+    for (double value : values) {
+        total += value;
+    }
+    summary.mean = total / values.size();
+    summary.p50 = percentile(0.50);
+    summary.p90 = percentile(0.90);
+    summary.p99 = percentile(0.99);
+    summary.max = values.back();
+    return summary;
+}
+
+render::FramebufferInfo TargetFramebufferInfo() {
+    auto framebuffer_info = render::FramebufferInfo{};
+    framebuffer_info.renderpass = renderpass;
+    framebuffer_info.offscreen_target = offscreen_target;
+    framebuffer_info.extent = offscreen_target->extent;
+    return framebuffer_info;
+}
+
+// Objects spread over a cube around the camera, the same for every run
+void PopulateIndirectScene(uint32_t object_count) {
+    uint32_t state = 1;
+    auto random = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) / float(1u << 24) * 2.0f - 1.0f;
+    };
+    for (uint32_t i = 0; i < object_count; i++) {
+        render::GpuObject object{};
+        float scale = 0.5f + 0.25f * random();
+        object.transform[0] = object.transform[5] = object.transform[10] = scale;
+        object.transform[12] = 100.0f * random();
+        object.transform[13] = 100.0f * random();
+        object.transform[14] = 100.0f * random();
+        object.transform[15] = 1.0f;
+        object.bounding_sphere[3] = 1.0f;
+        object.index_count = 3;
+        render::indirect_scene::AddObject(indirect_scene, object);
+    }
+}
+
+// A hundred roots, every other node the child of a random earlier node, at most eight levels deep
+void PopulateTransformHierarchy(uint32_t node_count) {
+    uint32_t state = 1;
+    auto random = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    };
+    for (uint32_t i = 0; i < node_count; i++) {
+        uint32_t parent = i < 100 ? core::NO_PARENT : random() % i;
+        while (parent != core::NO_PARENT && transform_hierarchy->depths[parent] >= 7) {
+            parent = transform_hierarchy->parents[parent];
+        }
+        core::Transform local{};
+        local.position = {(random() % 200) / 100.0f - 1.0f, 1.0f, 0.0f};
+        local.rotation = core::quat::FromAxisAngle({0.0f, 0.0f, 1.0f}, (random() % 628) / 100.0f);
+        local.scale = {0.9f, 0.9f, 0.9f};
+        core::transform_hierarchy::AddNode(transform_hierarchy, parent, local);
+    }
+}
+
+/* Allocates fragment_count buffers and a quarter as many images, then frees every other one, which leaves
+ * holes a Defragmenter can close. The images are cleared by the first frame, so moves copy them. */
+void FragmentMemory(uint32_t fragment_count) {
+    for (uint32_t i = 0; i < fragment_count; i++) {
+        fragment_buffers.emplace_back(render::CreateBuffer({
+            256 * 1024,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+            0,
+            true,
+        }));
+    }
+    for (uint32_t i = 0; i < fragment_count / 4; i++) {
+        fragment_images.emplace_back(render::CreateImage({
+            {256, 256, 1},
+            VK_FORMAT_R8G8B8A8_UNORM,
+            VK_IMAGE_USAGE_SAMPLED_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            VMA_MEMORY_USAGE_AUTO,
+            true,
+        }));
+    }
+    for (size_t i = 0; i < fragment_buffers.size(); i += 2) {
+        render::DestroyBuffer(fragment_buffers[i]);
+        fragment_buffers[i] = nullptr;
+    }
+    for (size_t i = 0; i < fragment_images.size(); i += 2) {
+        render::DestroyImage(fragment_images[i]);
+        fragment_images[i] = nullptr;
+    }
+    fragment_buffers.erase(std::remove(fragment_buffers.begin(), fragment_buffers.end(), nullptr),
+                           fragment_buffers.end());
+    fragment_images.erase(std::remove(fragment_images.begin(), fragment_images.end(), nullptr),
+                          fragment_images.end());
+}
+// Records the clears of the first frame, which leave every image in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+void ClearFragmentImages(render::CommandBuffer* command_buffer) {
+    VkImageSubresourceRange range{VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    VkClearColorValue color{{0.25f, 0.5f, 0.75f, 1.0f}};
+    for (render::Image* image : fragment_images) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image->vk_image;
+        barrier.subresourceRange = range;
+        vkCmdPipelineBarrier(command_buffer->vk_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        vkCmdClearColorImage(command_buffer->vk_command_buffer, image->vk_image,
+                             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &color, 1, &range);
+    }
+}
+void ReleaseFragments() {
+    for (render::Buffer* buffer : fragment_buffers) {
+        render::DestroyBuffer(buffer);
+    }
+    for (render::Image* image : fragment_images) {
+        render::DestroyImage(image);
+    }
+    fragment_buffers.clear();
+    fragment_images.clear();
+}
+
+uint32_t StreamedLevelExtent(uint32_t level) { return 32u << level; }
+VkDeviceSize RegisterStreamedTextures(render::ResidencyManager* manager, uint32_t texture_count) {
+    VkDeviceSize texture_bytes = 0;
+    for (uint32_t i = 0; i < texture_count; i++) {
+        auto texture = new StreamedTexture{};
+        render::ResidentAssetInfo info{};
+        for (uint32_t level = 0; level < STREAMED_LEVEL_COUNT; level++) {
+            info.level_sizes.emplace_back(VkDeviceSize{StreamedLevelExtent(level)} * StreamedLevelExtent(level) * 4);
+            texture_bytes += info.level_sizes.back();
+        }
+        info.stream_in = [manager, texture](uint32_t level) {
+            core::threadpool::Enqueue(
+                worker_pool,
+                [manager, texture, level]() {
+                    uint32_t extent = StreamedLevelExtent(level);
+                    render::Image* image = render::CreateImage({
+                        {extent, extent, 1},
+                        VK_FORMAT_R8G8B8A8_UNORM,
+                        VK_IMAGE_USAGE_SAMPLED_BIT,
+                    });
+                    bool success = image->vk_image != VK_NULL_HANDLE;
+                    if (!success) {
+                        render::DestroyImage(image);
+                        image = nullptr;
+                    }
+                    texture->levels[level] = image;
+                    render::residency::CompleteStreamIn(manager, texture->asset, level, success);
+                },
+                core::JOB_PRIORITY_LOW);
+            return true;
+        };
+        // Frames in flight may still use the level
+        info.evict = [texture](uint32_t level) {
+            render::Image* image = texture->levels[level];
+            texture->levels[level] = nullptr;
+            render::Retire([image]() { render::DestroyImage(image); });
+        };
+        texture->asset = render::residency::Register(manager, std::move(info));
+        streamed_textures.emplace_back(texture);
+    }
+    return texture_bytes;
+}
+// A viewer sweeping across the textures, which want more of their levels the nearer they are
+void TouchStreamedTextures(render::ResidencyManager* manager, uint32_t frame_index) {
+    uint32_t texture_count = (uint32_t)streamed_textures.size();
+    for (uint32_t i = 0; i < texture_count; i++) {
+        uint32_t distance = (i + texture_count - frame_index % texture_count) % texture_count;
+        distance = std::min(distance, texture_count - distance);
+        uint32_t level_count =
+            STREAMED_LEVEL_COUNT - std::min(distance * 8 / texture_count, STREAMED_LEVEL_COUNT - 1);
+        render::residency::Touch(manager, streamed_textures[i]->asset, 1.0f / (1.0f + distance), level_count);
+    }
+}
+/* Unregisters every texture while some of them may still be streaming, those are freed by the job that
+ * completes them, so the worker pool is drained before the textures are. */
+void ReleaseStreamedTextures(render::ResidencyManager* manager) {
+    for (StreamedTexture* texture : streamed_textures) {
+        render::residency::Unregister(manager, texture->asset);
+    }
+    core::threadpool::AwaitIdle(worker_pool);
+    for (StreamedTexture* texture : streamed_textures) {
+        delete texture;
+    }
+    streamed_textures.clear();
+}
+
+void Initialize(const BenchOptions& options) {
+    core::Initialize(SDL_INIT_EVENTS);
+
+    ASSET_LOG_INITIALIZE
+    asset::vfs::MountDirectory("", ENGINE_ASSET_DIRECTORY);
+
+    RENDER_LOG_INITIALIZE
+    // Per frame logging would be measured along with the frame
+    render::logger->set_level(spdlog::level::warn);
+    asset::logger->set_level(spdlog::level::warn);
+
+    render::ContextInfo context_info{};
+    context_info.enable_validation_layers = false;
+    render::context = render::CreateContext(context_info);
+    render::SetFramesInFlight(options.frames_in_flight);
+    render::InitializeSubmission();
+
+    offscreen_target = render::CreateOffscreenTarget({options.extent});
+    render::Attachment offscreen_attachment = {
+        VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        offscreen_target->format,
+        render::LoadOp::CLEAR,
+        render::StoreOp::STORE,
+    };
+    renderpass = render::CreateRenderpass({offscreen_target->extent,
+                                           {offscreen_attachment},
+                                           {{
+                                               {},
+                                               {{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}},
+                                               nullptr,
+                                           }},
+                                           nullptr});
+    framebuffer = render::CreateFramebuffer(TargetFramebufferInfo());
+
+    // Identical pipelines, so the pipelines scenario measures binding cost rather than shader cost
+    render::PipelineInfo pipeline_info{};
+    pipeline_info.renderpass = renderpass;
+    pipeline_info.shaders = {
+        {render::SHADER_STAGE_VERTEX, render::SHADER_FORMAT_SPIRV, "bench.vert.spirv"},
+        {render::SHADER_STAGE_FRAGMENT, render::SHADER_FORMAT_SPIRV, "triangle.frag.spirv"},
+    };
+    pipeline_info.front_face = render::FRONT_FACE_CW;
+    pipeline_info.cull_mode = render::NGFX_CULL_MODE_NONE;
+    for (uint32_t i = 0; i < std::max(options.pipeline_count, 1u); i++) {
+        pipelines.emplace_back(render::CreatePipeline(pipeline_info));
+    }
+    render::PipelineInfo instanced_pipeline_info = pipeline_info;
+    instanced_pipeline_info.shaders[0].filepath = "instanced.vert.spirv";
+    instanced_pipeline_info.vertex_bindings = {{1, 4 * sizeof(float), VK_VERTEX_INPUT_RATE_INSTANCE}};
+    instanced_pipeline_info.vertex_attributes = {{0, 1, VK_FORMAT_R32G32B32A32_SFLOAT, 0}};
+    for (uint32_t i = 0; i < std::max(options.pipeline_count, 1u); i++) {
+        instanced_pipelines.emplace_back(render::CreatePipeline(instanced_pipeline_info));
+    }
+
+    command_pool = render::CreateCommandPool();
+    worker_pool = core::CreateThreadPool(0);
+    transform_hierarchy = core::CreateTransformHierarchy({options.node_count, worker_pool});
+    PopulateTransformHierarchy(options.node_count);
+    for (uint8_t i = 0; i < render::frames_in_flight; i++) {
+        draw_queue[i] = render::CreateDrawQueue({32768, worker_pool});
+        instanced_draw_queue[i] = render::CreateDrawQueue({32768, worker_pool, 4 * sizeof(float)});
+        fence[i] = render::CreateFence(render::fence::INITIALIZE_SIGNALED);
+        staging_buffer[i] = render::CreateBuffer({
+            options.upload_size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        });
+    }
+    upload_buffer = render::CreateBuffer({
+        options.upload_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+    });
+
+    // A triangle inside the unit bounding sphere, shared by every object of the indirect scenario
+    const float vertices[3][4] = {{0.0f, -0.8f, 0.0f, 1.0f}, {0.8f, 0.6f, 0.0f, 1.0f}, {-0.8f, 0.6f, 0.0f, 1.0f}};
+    const uint32_t indices[3] = {0, 1, 2};
+    indirect_vertex_buffer = render::CreateBuffer({
+        sizeof(vertices),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+    });
+    indirect_index_buffer = render::CreateBuffer({
+        sizeof(indices),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+    });
+    memcpy(indirect_vertex_buffer->mapping, vertices, sizeof(vertices));
+    memcpy(indirect_index_buffer->mapping, indices, sizeof(indices));
+    render::buffer::Flush(indirect_vertex_buffer);
+    render::buffer::Flush(indirect_index_buffer);
+
+    indirect_scene = render::CreateIndirectScene(
+        {std::max(options.object_count, 1u), indirect_vertex_buffer, indirect_index_buffer});
+    PopulateIndirectScene(options.object_count);
+    render::PipelineInfo indirect_pipeline_info = pipeline_info;
+    indirect_pipeline_info.shaders[0].filepath = "indirect.vert.spirv";
+    indirect_pipeline_info.push_constant_ranges = {{render::SHADER_STAGE_VERTEX, 0, 16 * sizeof(float)}};
+    indirect_pipeline_info.descriptor_set_layouts = {indirect_scene->vk_descriptor_set_layout};
+    indirect_pipeline = render::CreatePipeline(indirect_pipeline_info);
+    for (uint8_t i = 0; i < render::frames_in_flight; i++) {
+        count_readback[i] = render::CreateBuffer({
+            sizeof(uint32_t),
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        });
+    }
+}
+void Finalize() {
+    render::AwaitIdle();
+    render::FinalizeSubmission();
+    render::FlushRetired();
+
+    render::DestroyPipeline(indirect_pipeline);
+    render::DestroyIndirectScene(indirect_scene);
+    render::DestroyBuffer(indirect_index_buffer);
+    render::DestroyBuffer(indirect_vertex_buffer);
+    render::DestroyBuffer(upload_buffer);
+    for (uint8_t i = 0; i < render::frames_in_flight; i++) {
+        render::DestroyBuffer(count_readback[i]);
+        render::DestroyDrawQueue(draw_queue[i]);
+        render::DestroyDrawQueue(instanced_draw_queue[i]);
+        render::DestroyBuffer(staging_buffer[i]);
+        render::DestroyFence(fence[i]);
+    }
+    render::DestroyCommandPool(command_pool);
+    core::DestroyTransformHierarchy(transform_hierarchy);
+    core::DestroyThreadPool(worker_pool);
+
+    for (render::Pipeline* pipeline : pipelines) {
+        render::DestroyPipeline(pipeline);
+    }
+    for (render::Pipeline* pipeline : instanced_pipelines) {
+        render::DestroyPipeline(pipeline);
+    }
+    render::DestroyFramebuffer(framebuffer);
+    render::DestroyRenderpass(renderpass);
+    render::DestroyOffscreenTarget(offscreen_target);
+    render::DestroyContext(render::context);
+    RENDER_LOG_FINALIZE
+
+    asset::vfs::Finalize();
+    ASSET_LOG_FINALIZE
+    core::Finalize();
+}
+
+/* Runs warmup + measured frames of one scenario through the same loop as the runtime: await the slot
+ * fence, record asynchronously, submit asynchronously. Resizes cycle through a fixed list of extents and
+ * uploads write a fixed pattern, so two runs with the same options do the same work. */
+ScenarioResult RunScenario(Scenario scenario, const BenchOptions& options) {
+    using clock = std::chrono::steady_clock;
+    auto milliseconds = [](clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    };
+
+    uint32_t draw_count = scenario == SCENARIO_DRAWS || scenario == SCENARIO_PIPELINES ? options.draw_count : 1;
+    // Indirect, sorted and instanced issue their own draws instead
+    if (scenario == SCENARIO_INDIRECT || scenario == SCENARIO_SORTED || scenario == SCENARIO_INSTANCED) {
+        draw_count = 0;
+    }
+    uint32_t pipeline_count = scenario == SCENARIO_PIPELINES ? (uint32_t)pipelines.size() : 1;
+    const Extent3D resize_extents[4] = {
+        options.extent,
+        {options.extent.x / 2, options.extent.y / 2, 1},
+        {options.extent.x * 3 / 4, options.extent.y / 2, 1},
+        {options.extent.x / 2, options.extent.y * 3 / 4, 1},
+    };
+
+    uint32_t total_frame_count = options.warmup_frame_count + options.frame_count;
+    std::vector<FrameSample> samples(total_frame_count);
+    SlotTiming timing[MAX_FRAMES_IN_FLIGHT]{};
+    bool verify = scenario == SCENARIO_INDIRECT && options.verify && indirect_scene->supported;
+    uint32_t verification_failure_count = 0;
+    auto harvest = [&samples, &timing, &milliseconds, verify, &verification_failure_count](uint8_t slot) {
+        if (timing[slot].frame < 0) {
+            return;
+        }
+        if (verify) {
+            render::buffer::Invalidate(count_readback[slot]);
+            uint32_t count = *(uint32_t*)count_readback[slot]->mapping;
+            if (count < timing[slot].expected_min_count || count > timing[slot].expected_max_count) {
+                fprintf(stderr, "indirect: frame %lld kept %u objects, expected %u to %u\n",
+                        (long long)timing[slot].frame, count, timing[slot].expected_min_count,
+                        timing[slot].expected_max_count);
+                verification_failure_count++;
+            }
+        }
+        FrameSample& sample = samples[timing[slot].frame];
+        sample.record_ms = milliseconds(timing[slot].record_end - timing[slot].record_begin);
+        // Time from the later of the submit call and the end of recording until vkQueueSubmit returned
+        sample.submit_ms = milliseconds(timing[slot].submitted -
+                                        std::max(timing[slot].submit_call, timing[slot].record_end));
+        timing[slot].frame = -1;
+    };
+
+    render::Defragmenter* defragmenter = nullptr;
+    if (scenario == SCENARIO_DEFRAG) {
+        FragmentMemory(options.fragment_count);
+        // Passes start on the second frame, once the first has cleared the images
+        render::DefragmenterInfo defragmenter_info{};
+        defragmenter_info.idle_frames = 2;
+        defragmenter = render::CreateDefragmenter(defragmenter_info);
+    }
+    render::ResidencyManager* residency_manager = nullptr;
+    if (scenario == SCENARIO_RESIDENCY && options.texture_count > 0) {
+        residency_manager = render::CreateResidencyManager({});
+        VkDeviceSize texture_bytes = RegisterStreamedTextures(residency_manager, options.texture_count);
+        // Room for about half of the levels over what the heap already holds, so the sweep keeps evicting
+        VkDeviceSize usage = residency_manager->budgets[residency_manager->device_local_heap].usage;
+        residency_manager->info.budget_limit = usage + texture_bytes / 2;
+    }
+
+    uint8_t current_frame = 0;
+    auto frame_start = clock::now();
+    auto measure_start = frame_start;
+    uint64_t frame_allocations = allocation_count.load(std::memory_order_relaxed);
+    for (uint32_t frame_index = 0; frame_index <= total_frame_count; frame_index++) {
+        render::fence::Await(fence[current_frame]);
+        harvest(current_frame);
+
+        auto now = clock::now();
+        uint64_t allocations = allocation_count.load(std::memory_order_relaxed);
+        if (frame_index > 0) {
+            samples[frame_index - 1].cpu_ms = milliseconds(now - frame_start);
+            samples[frame_index - 1].allocations = allocations - frame_allocations;
+        }
+        frame_start = now;
+        frame_allocations = allocations;
+        if (frame_index == options.warmup_frame_count) {
+            measure_start = now;
+        }
+        if (frame_index == total_frame_count) {
+            break;
+        }
+
+        render::fence::Reset(fence[current_frame]);
+        render::BeginFrame();
+        render::command_pool::BeginFrame(command_pool);
+        render::DefragmentationPass* defragmentation_pass =
+            defragmenter != nullptr ? render::defragmenter::BeginFrame(defragmenter) : nullptr;
+        bool clear_fragments = defragmenter != nullptr && frame_index == 0;
+        if (clear_fragments) {
+            for (render::Image* image : fragment_images) {
+                image->layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            }
+        }
+        if (residency_manager != nullptr) {
+            TouchStreamedTextures(residency_manager, frame_index);
+            render::residency::Update(residency_manager);
+        }
+
+        if (scenario == SCENARIO_RESIZE && frame_index % std::max(options.resize_interval, 1u) == 0) {
+            Extent3D extent = resize_extents[(frame_index / std::max(options.resize_interval, 1u)) % 4];
+            render::offscreen_target::Recreate(offscreen_target, extent);
+            render::Framebuffer* retired_framebuffer = framebuffer;
+            render::Retire([retired_framebuffer]() { render::DestroyFramebuffer(retired_framebuffer); });
+            framebuffer = render::CreateFramebuffer(TargetFramebufferInfo());
+        }
+        if (scenario == SCENARIO_PIPELINE_FLOOD) {
+            for (uint32_t i = 0; i < options.flood_count; i++) {
+                VkPipeline vk_pipeline = render::pipeline::Compile(pipelines[0]->recreation_info.value(),
+                                                                   pipelines[0]->vk_pipeline_layout);
+                render::Retire([vk_pipeline]() { vkDestroyPipeline(render::context.vk_device, vk_pipeline, nullptr); });
+            }
+        }
+        render::Buffer* upload_source = nullptr;
+        if (scenario == SCENARIO_UPLOADS && frame_index % std::max(options.upload_interval, 1u) == 0) {
+            upload_source = staging_buffer[current_frame];
+            memset(upload_source->mapping, (int)(frame_index & 0xff), upload_source->size);
+            render::buffer::Flush(upload_source);
+        }
+
+        uint32_t image_index;
+        render::offscreen_target::AcquireImage(offscreen_target, &image_index);
+        Extent3D extent = offscreen_target->extent;
+        VkFramebuffer vk_framebuffer = framebuffer->vk_framebuffer[image_index];
+        SlotTiming* slot_timing = &timing[current_frame];
+        slot_timing->frame = frame_index;
+        render::CommandBuffer* frame_command_buffer = render::command_pool::AllocateFrameCommandBuffer(command_pool);
+
+        // Every root turns, so every world matrix changes
+        if (scenario == SCENARIO_SCENE && transform_hierarchy->levels.size() > 0) {
+            core::Quat rotation = core::quat::FromAxisAngle({0.0f, 1.0f, 0.0f}, frame_index * 0.0174533f);
+            for (uint32_t root : transform_hierarchy->levels[0]) {
+                transform_hierarchy->rotations[root] = rotation;
+            }
+            core::transform_hierarchy::Update(transform_hierarchy);
+        }
+
+        // The camera turns a full circle every 360 frames, so culling keeps a different set of objects
+        render::IndirectFrame* indirect_frame = nullptr;
+        core::Mat4 view_projection{};
+        render::Frustum frustum{};
+        if (scenario == SCENARIO_INDIRECT) {
+            core::Quat view_rotation = core::quat::FromAxisAngle({0.0f, 1.0f, 0.0f}, -(frame_index * 0.0174533f));
+            view_projection = core::mat4::Perspective(1.0472f, (float)extent.x / (float)extent.y, 0.1f, 150.0f) *
+                              core::mat4::FromQuat(view_rotation);
+            frustum = render::frustum::FromViewProjection(view_projection.m);
+            indirect_frame = render::indirect_scene::BeginFrame(indirect_scene);
+        }
+        if (verify) {
+            // The GPU tests the same planes in its own precision, objects this close to a plane may go either way
+            const float epsilon = 1e-3f;
+            slot_timing->expected_min_count = 0;
+            slot_timing->expected_max_count = 0;
+            for (const render::GpuObject& object : indirect_scene->objects) {
+                slot_timing->expected_min_count += render::indirect_scene::Visible(frustum, object, -epsilon);
+                slot_timing->expected_max_count += render::indirect_scene::Visible(frustum, object, epsilon);
+            }
+        }
+        render::Buffer* readback = verify ? count_readback[current_frame] : nullptr;
+
+        // The draws of the pipelines scenario submitted with the pipelines interleaved, the worst order to record
+        render::DrawQueue* frame_draw_queue = nullptr;
+        if (scenario == SCENARIO_SORTED) {
+            frame_draw_queue = draw_queue[current_frame];
+            render::draw_queue::Clear(frame_draw_queue);
+            render::DrawPacket packet{};
+            packet.count = 3;
+            for (uint32_t i = 0; i < options.draw_count; i++) {
+                uint32_t pipeline_index = i % (uint32_t)pipelines.size();
+                packet.key = render::draw_key::Pack(0, pipeline_index, 0, (i * 2654435761u >> 8) / float(1u << 24));
+                packet.pipeline = pipelines[pipeline_index];
+                packet.first_instance = i;
+                render::draw_queue::Submit(frame_draw_queue, packet);
+            }
+        }
+        // The same draws again, batched into one instanced draw per pipeline
+        if (scenario == SCENARIO_INSTANCED) {
+            frame_draw_queue = instanced_draw_queue[current_frame];
+            render::draw_queue::Clear(frame_draw_queue);
+            render::DrawPacket packet{};
+            packet.count = 3;
+            for (uint32_t i = 0; i < options.draw_count; i++) {
+                uint32_t pipeline_index = i % (uint32_t)instanced_pipelines.size();
+                uint32_t cell = i % 1024;
+                const float instance[4] = {(cell % 32 + 0.5f) / 16.0f - 1.0f, (cell / 32 + 0.5f) / 16.0f - 1.0f,
+                                           1.0f / 16.0f, 0.0f};
+                packet.key = render::draw_key::Pack(0, pipeline_index, 0, 0.0f);
+                packet.pipeline = instanced_pipelines[pipeline_index];
+                render::draw_queue::Submit(frame_draw_queue, packet, instance);
+            }
+        }
+
+        render::command_pool::RecordAsync(
+            command_pool, frame_command_buffer,
+            [frame_command_buffer, slot_timing, vk_framebuffer, extent, upload_source, draw_count, pipeline_count,
+             indirect_frame, view_projection, frustum, readback, frame_draw_queue, defragmenter,
+             defragmentation_pass, clear_fragments]() {
+                slot_timing->record_begin = clock::now();
+                VkCommandBuffer vk_command_buffer = frame_command_buffer->vk_command_buffer;
+                render::command::BeginCommandBuffer(command_pool, frame_command_buffer);
+
+                render::command::Defragment(frame_command_buffer, defragmenter, defragmentation_pass);
+                if (clear_fragments) {
+                    ClearFragmentImages(frame_command_buffer);
+                }
+
+                if (upload_source != nullptr) {
+                    render::command::CopyBuffer(frame_command_buffer, upload_source, upload_buffer,
+                                                upload_source->size);
+                }
+                if (indirect_frame != nullptr) {
+                    render::command::CullIndirectScene(frame_command_buffer, indirect_scene, indirect_frame, frustum);
+                }
+                if (readback != nullptr) {
+                    render::command::CopyBuffer(frame_command_buffer, indirect_scene->count_buffer, readback,
+                                                sizeof(uint32_t));
+                }
+
+                VkRenderPassBeginInfo begin_info{};
+                begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                begin_info.renderPass = renderpass->vk_render_pass;
+                begin_info.framebuffer = vk_framebuffer;
+                begin_info.renderArea = {0, 0, extent.x, extent.y};
+                VkClearValue clear_value = {{{0.0f, 0.0f, 0.0f, 0.0f}}};
+                begin_info.clearValueCount = 1;
+                begin_info.pClearValues = &clear_value;
+                vkCmdBeginRenderPass(vk_command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+                VkViewport viewport{0.0f, 0.0f, (float)extent.x, (float)extent.y, 0.0f, 1.0f};
+                VkRect2D scissor{{0, 0}, {extent.x, extent.y}};
+                if (indirect_frame != nullptr) {
+                    render::command::BindPipeline(frame_command_buffer, indirect_pipeline);
+                    vkCmdSetViewport(vk_command_buffer, 0, 1, &viewport);
+                    vkCmdSetScissor(vk_command_buffer, 0, 1, &scissor);
+                    render::command::DrawIndirectScene(frame_command_buffer, indirect_scene, indirect_frame,
+                                                       indirect_pipeline, view_projection.m);
+                }
+                if (frame_draw_queue != nullptr) {
+                    render::command::RecordDrawQueue(frame_command_buffer, frame_draw_queue, viewport, scissor);
+                }
+                uint32_t draws_per_pipeline = std::max(draw_count / pipeline_count, 1u);
+                for (uint32_t i = 0; i < draw_count; i++) {
+                    if (i % draws_per_pipeline == 0 && i / draws_per_pipeline < pipeline_count) {
+                        // Viewport and scissor are dynamic state, which a pipeline bind does not carry over
+                        render::command::BindPipeline(frame_command_buffer, pipelines[i / draws_per_pipeline]);
+                        vkCmdSetViewport(vk_command_buffer, 0, 1, &viewport);
+                        vkCmdSetScissor(vk_command_buffer, 0, 1, &scissor);
+                    }
+                    render::command::Draw(frame_command_buffer, 3, 1, 0, i);
+                }
+
+                vkCmdEndRenderPass(vk_command_buffer);
+                render::command::EndCommandBuffer(command_pool, frame_command_buffer);
+                slot_timing->record_end = clock::now();
+            });
+
+        auto submit_info = render::SubmitInfo{};
+        submit_info.wait_stage_flags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        submit_info.fence = fence[current_frame];
+        submit_info.command_pool = command_pool;
+        submit_info.command_buffer = frame_command_buffer;
+        submit_info.submitted = [slot_timing]() { slot_timing->submitted = clock::now(); };
+        slot_timing->submit_call = clock::now();
+        render::SubmitUniversalAsync(submit_info);
+
+        current_frame = (current_frame + 1) % render::frames_in_flight;
+    }
+    // Awaiting every slot, rather than only idling the device, also waits out the submission callbacks
+    for (uint8_t i = 0; i < render::frames_in_flight; i++) {
+        render::fence::Await(fence[i]);
+        harvest(i);
+    }
+    if (residency_manager != nullptr) {
+        render::ResidencyStatistics statistics = render::residency::GetStatistics(residency_manager);
+        fprintf(stderr, "residency: %u levels streamed, %u evicted, %llu KB resident, %llu KB streaming\n",
+                statistics.streamed_level_count, statistics.evicted_level_count,
+                (unsigned long long)(statistics.resident_bytes / 1024),
+                (unsigned long long)(statistics.streaming_bytes / 1024));
+        ReleaseStreamedTextures(residency_manager);
+        render::DestroyResidencyManager(residency_manager);
+    }
+    render::AwaitIdle();
+    // Destructions retired by this scenario are not charged to the next one
+    render::FlushRetired();
+    if (defragmenter != nullptr) {
+        render::DefragmenterStatistics statistics = render::defragmenter::GetStatistics(defragmenter);
+        fprintf(stderr, "defrag: %u passes, %u allocations moved, %llu KB moved, %u memory blocks freed\n",
+                statistics.pass_count, statistics.allocations_moved,
+                (unsigned long long)(statistics.bytes_moved / 1024), statistics.memory_blocks_freed);
+        render::DestroyDefragmenter(defragmenter);
+        ReleaseFragments();
+    }
+
+    ScenarioResult result{};
+    result.scenario = scenario;
+    result.frame_count = options.frame_count;
+    result.seconds = std::chrono::duration<double>(frame_start - measure_start).count();
+    std::vector<double> cpu_ms{}, record_ms{}, submit_ms{}, allocations{};
+    for (uint32_t i = options.warmup_frame_count; i < total_frame_count; i++) {
+        cpu_ms.emplace_back(samples[i].cpu_ms);
+        record_ms.emplace_back(samples[i].record_ms);
+        submit_ms.emplace_back(samples[i].submit_ms);
+        allocations.emplace_back((double)samples[i].allocations);
+    }
+    result.cpu_ms = Summarize(cpu_ms);
+    result.record_ms = Summarize(record_ms);
+    result.submit_ms = Summarize(submit_ms);
+    result.allocations = Summarize(allocations);
+    result.verification_failure_count = verification_failure_count;
+    if (scenario == SCENARIO_SORTED || scenario == SCENARIO_INSTANCED) {
+        const render::DrawQueueStats& draw_stats =
+            (scenario == SCENARIO_SORTED ? draw_queue : instanced_draw_queue)[0]->stats;
+        fprintf(stderr, "%s: %u draws, %u packets batched, %u pipeline binds, %u binds elided per frame\n",
+                scenario_names[scenario], draw_stats.draw_count, draw_stats.batched_packets,
+                draw_stats.pipeline_binds, draw_stats.elided_binds);
+    }
+
+    if (scenario == SCENARIO_RESIZE && offscreen_target->extent.x != options.extent.x) {
+        render::offscreen_target::Recreate(offscreen_target, options.extent);
+        render::DestroyFramebuffer(framebuffer);
+        framebuffer = render::CreateFramebuffer(TargetFramebufferInfo());
+        render::FlushRetired();
+    }
+    return result;
+}
+
+void WriteCSV(FILE* file, const std::vector<ScenarioResult>& results) {
+    fprintf(file, "scenario,frames,seconds,fps");
+    for (const char* metric : {"cpu_ms", "record_ms", "submit_ms", "allocations"}) {
+        for (const char* statistic : {"mean", "p50", "p90", "p99", "max"}) {
+            fprintf(file, ",%s_%s", metric, statistic);
+        }
+    }
+    fprintf(file, "\n");
+    for (const ScenarioResult& result : results) {
+        fprintf(file, "%s,%u,%.4f,%.2f", scenario_names[result.scenario], result.frame_count, result.seconds,
+                result.frame_count / result.seconds);
+        for (const Summary* summary : {&result.cpu_ms, &result.record_ms, &result.submit_ms, &result.allocations}) {
+            fprintf(file, ",%.4f,%.4f,%.4f,%.4f,%.4f", summary->mean, summary->p50, summary->p90, summary->p99,
+                    summary->max);
+        }
+        fprintf(file, "\n");
+    }
+}
+void WriteJSON(FILE* file, const std::vector<ScenarioResult>& results, const BenchOptions& options) {
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(render::context.vk_physical_device, &properties);
+
+    fprintf(file, "{\n  \"device\": \"%s\",\n  \"extent\": [%u, %u],\n  \"frames_in_flight\": %u,\n",
+            properties.deviceName, options.extent.x, options.extent.y, render::frames_in_flight);
+    fprintf(file, "  \"warmup_frames\": %u,\n  \"scenarios\": [\n", options.warmup_frame_count);
+    for (size_t i = 0; i < results.size(); i++) {
+        const ScenarioResult& result = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"frames\": %u, \"seconds\": %.4f, \"fps\": %.2f",
+                scenario_names[result.scenario], result.frame_count, result.seconds,
+                result.frame_count / result.seconds);
+        std::pair<const char*, const Summary*> metrics[] = {
+            {"cpu_ms", &result.cpu_ms},
+            {"record_ms", &result.record_ms},
+            {"submit_ms", &result.submit_ms},
+            {"allocations", &result.allocations},
+        };
+        for (auto& [name, summary] : metrics) {
+            fprintf(file, ",\n     \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, ", name, summary->mean,
+                    summary->p50, summary->p90);
+            fprintf(file, "\"p99\": %.4f, \"max\": %.4f}", summary->p99, summary->max);
+        }
+        fprintf(file, "}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+}
+
+void PrintUsage(const char* executable) {
+    printf("usage: %s [options]\n"
+           "  --scenario <all|draws|pipelines|resize|uploads|pipeline_flood|indirect|sorted|instanced|scene|defrag|\n"
+           "              residency> repeatable, default all\n"
+           "  --frames <n>           measured frames per scenario (500)\n"
+           "  --warmup <n>           unmeasured frames before each scenario (50)\n"
+           "  --extent <w>x<h>       offscreen target extent (1280x720)\n"
+           "  --draws <n>            draws per frame for draws, pipelines, sorted and instanced (10000)\n"
+           "  --pipelines <n>        pipelines bound in turn for pipelines, sorted and instanced (16)\n"
+           "  --resize-interval <n>  frames between resizes (4)\n"
+           "  --upload-size <MB>     bytes copied per upload (16)\n"
+           "  --upload-interval <n>  frames between uploads (1)\n"
+           "  --flood <n>            pipelines created per frame for pipeline_flood (4)\n"
+           "  --objects <n>          objects culled and drawn on the GPU for indirect (100000)\n"
+           "  --nodes <n>            transforms updated per frame for scene (100000)\n"
+           "  --fragments <n>        buffers defrag allocates and half frees, plus n/4 images (1024)\n"
+           "  --textures <n>         textures residency streams in and evicts, half fit the budget (256)\n"
+           "  --verify <0|1>         check the objects indirect keeps against the host, fail on a mismatch (0)\n"
+           "  --frames-in-flight <n> frames recorded ahead of the GPU, 1 to 4 (2)\n"
+           "  --format <csv|json>    result format (csv)\n"
+           "  --output <path>        result file, stdout by default\n",
+           executable);
+}
+
+/* Renders scripted scenarios headless and reports frame time percentiles, record and submit latency and
+ * allocations per frame. Runs on any Vulkan device, including software ones such as lavapipe. */
+int main(int argc, char** argv) {
+    BenchOptions options{};
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (argument == "--help" || value == nullptr) {
+            PrintUsage(argv[0]);
+            return argument == "--help" ? 0 : 1;
+        }
+        i++;
+        if (argument == "--scenario") {
+            if (strcmp(value, "all") == 0) {
+                options.scenarios = {};
+                continue;
+            }
+            auto name = std::find_if(std::begin(scenario_names), std::end(scenario_names),
+                                     [value](const char* name) { return strcmp(name, value) == 0; });
+            if (name == std::end(scenario_names)) {
+                printf("unknown scenario %s\n", value);
+                return 1;
+            }
+            options.scenarios.emplace_back((Scenario)(name - std::begin(scenario_names)));
+        } else if (argument == "--frames") {
+            options.frame_count = std::max((uint32_t)atoi(value), 1u);
+        } else if (argument == "--warmup") {
+            options.warmup_frame_count = (uint32_t)atoi(value);
+        } else if (argument == "--extent") {
+            if (sscanf(value, "%ux%u", &options.extent.x, &options.extent.y) != 2) {
+                PrintUsage(argv[0]);
+                return 1;
+            }
+        } else if (argument == "--draws") {
+            options.draw_count = (uint32_t)atoi(value);
+        } else if (argument == "--pipelines") {
+            options.pipeline_count = (uint32_t)atoi(value);
+        } else if (argument == "--resize-interval") {
+            options.resize_interval = (uint32_t)atoi(value);
+        } else if (argument == "--upload-size") {
+            options.upload_size = std::max(VkDeviceSize(atoi(value)), VkDeviceSize{1}) * 1024 * 1024;
+        } else if (argument == "--upload-interval") {
+            options.upload_interval = (uint32_t)atoi(value);
+        } else if (argument == "--flood") {
+            options.flood_count = (uint32_t)atoi(value);
+        } else if (argument == "--objects") {
+            options.object_count = (uint32_t)atoi(value);
+        } else if (argument == "--nodes") {
+            options.node_count = (uint32_t)atoi(value);
+        } else if (argument == "--fragments") {
+            options.fragment_count = (uint32_t)atoi(value);
+        } else if (argument == "--textures") {
+            options.texture_count = (uint32_t)atoi(value);
+        } else if (argument == "--verify") {
+            options.verify = atoi(value) != 0;
+        } else if (argument == "--frames-in-flight") {
+            options.frames_in_flight = (uint32_t)atoi(value);
+        } else if (argument == "--format") {
+            options.json = strcmp(value, "json") == 0;
+        } else if (argument == "--output") {
+            options.output = value;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (options.scenarios.size() == 0) {
+        for (uint32_t i = 0; i < SCENARIO_COUNT; i++) {
+            options.scenarios.emplace_back((Scenario)i);
+        }
+    }
+
+    Initialize(options);
+    std::vector<ScenarioResult> results{};
+    uint32_t verification_failure_count = 0;
+    for (Scenario scenario : options.scenarios) {
+        results.emplace_back(RunScenario(scenario, options));
+        fprintf(stderr, "%s: %.2f FPS, p99 %.3f ms, %.1f allocations per frame\n", scenario_names[scenario],
+                results.back().frame_count / results.back().seconds, results.back().cpu_ms.p99,
+                results.back().allocations.mean);
+        verification_failure_count += results.back().verification_failure_count;
+    }
+    if (options.verify && !indirect_scene->supported) {
+        fprintf(stderr, "indirect: multiDrawIndirect is not supported, nothing was verified\n");
+    } else if (options.verify) {
+        fprintf(stderr, "indirect: %u frames failed verification\n", verification_failure_count);
+    }
+
+    FILE* file = options.output.empty() ? stdout : fopen(options.output.c_str(), "w");
+    if (file == nullptr) {
+        fprintf(stderr, "failed to open %s\n", options.output.c_str());
+    } else {
+        if (options.json) {
+            WriteJSON(file, results, options);
+        } else {
+            WriteCSV(file, results);
+        }
+        if (file != stdout) {
+            fclose(file);
+        }
+    }
+    Finalize();
+    return file == nullptr || verification_failure_count > 0 ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace core {
+struct ArenaInfo {
+    // Bytes of each block, a larger allocation gets a block of its own size
+    size_t block_size = 64 * 1024;
+};
+struct ArenaBlock {
+    uint8_t* memory = nullptr;
+    size_t size = 0;
+};
+/* Bump allocator for data that is freed all at once. Blocks are kept when the arena is reset, so an arena
+ * that is filled and reset every frame stops allocating once it has grown to its largest frame. Not
+ * synchronized, an arena belongs to one thread at a time. */
+struct Arena {
+    ArenaInfo info{};
+    std::vector<ArenaBlock> blocks{};
+    // Block allocations currently come from, and the bytes of it that are used
+    uint32_t block = 0;
+    size_t offset = 0;
+};
+// Where an arena stood, to rewind to
+struct ArenaMark {
+    uint32_t block = 0;
+    size_t offset = 0;
+};
+Arena* CreateArena(ArenaInfo info = {});
+void DestroyArena(Arena* arena);
+namespace arena {
+void Initialize(Arena* arena, ArenaInfo info = {});
+void Finalize(Arena* arena);
+
+void* Allocate(Arena* arena, size_t size, size_t alignment = alignof(std::max_align_t));
+// Constructs in the arena, nothing calls the destructor
+template <typename T, typename... Arguments> T* New(Arena* arena, Arguments&&... arguments) {
+    return new (Allocate(arena, sizeof(T), alignof(T))) T(std::forward<Arguments>(arguments)...);
+}
+// Frees everything allocated from the arena, keeping its blocks
+void Reset(Arena* arena);
+ArenaMark Mark(Arena* arena);
+// Frees everything allocated since mark was taken
+void Rewind(Arena* arena, ArenaMark mark);
+// Bytes of all blocks, what the arena costs while it is not in use
+size_t Capacity(Arena* arena);
+} // namespace arena
+
+// An arena of the calling thread for data that does not outlive the function allocating it
+Arena* ScratchArena();
+// Rewinds the scratch arena of the calling thread to where it stood at construction
+struct ScratchScope {
+    Arena* arena;
+    ArenaMark mark;
+
+    ScratchScope() : arena(ScratchArena()), mark(arena::Mark(arena)) {}
+    ~ScratchScope() { arena::Rewind(arena, mark); }
+    ScratchScope(const ScratchScope&) = delete;
+    ScratchScope& operator=(const ScratchScope&) = delete;
+};
+
+/* Allocates from an arena, or from the heap without one, so containers that usually live in an arena can
+ * still be filled anywhere. Deallocation from an arena does nothing, the memory returns on reset. The
+ * arena travels with the container on copy, move and swap. */
+template <typename T> struct ArenaAllocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    Arena* arena = nullptr;
+
+    ArenaAllocator() = default;
+    ArenaAllocator(Arena* arena) : arena(arena) {}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        if (arena == nullptr) {
+            return static_cast<T*>(::operator new(count * sizeof(T)));
+        }
+        return static_cast<T*>(arena::Allocate(arena, count * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* pointer, size_t) {
+        if (arena == nullptr) {
+            ::operator delete(pointer);
+        }
+    }
+};
+template <typename T, typename U> bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena == b.arena;
+}
+template <typename T, typename U> bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+    return a.arena != b.arena;
+}
+template <typename T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+} // namespace core
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <spdlog/sinks/stdout_sinks.h>
+#include <spdlog/spdlog.h>
+
+#define ASSET_LOGGER_DECLARATION                                                                                       \
+    namespace asset {                                                                                                  \
+    extern std::shared_ptr<spdlog::logger> logger;                                                                     \
+    };
+#define ASSET_LOGGER_DEFINITION                                                                                        \
+    namespace asset {                                                                                                  \
+    std::shared_ptr<spdlog::logger> logger;                                                                            \
+    };
+
+#define ASSET_LOG_INITIALIZE                                                                                           \
+    asset::logger = spdlog::stdout_logger_mt("asset");                                                                 \
+    asset::logger->info("ASSET LOG INITIALIZED!");
+#define ASSET_LOG_FINALIZE asset::logger->info("ASSET LOG FINALIZED!");
+
+#define ASSET_LOG_INFO(...) asset::logger->info(__VA_ARGS__)
+#define ASSET_LOG_ERROR(...) asset::logger->error(__VA_ARGS__)
+
+ASSET_LOGGER_DECLARATION
+
+// "ENPK" read as a little-endian uint32_t
+#define ASSET_ARCHIVE_MAGIC 0x4B504E45
+#define ASSET_ARCHIVE_VERSION 1
+// Entries are aligned to the page size so an uncompressed entry can be handed out as a view into the mapping
+#define ASSET_ARCHIVE_ALIGNMENT 4096
+
+namespace asset {
+enum Compression : uint32_t {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_LZ4 = 1,
+    COMPRESSION_ZSTD = 2,
+};
+
+uint64_t HashPath(std::string_view path);
+
+/* Archive Layout:
+ * [ArchiveHeader][entry data, each aligned to header.alignment][ArchiveEntry table][path string table]
+ * The entry table is sorted by (path_hash, path) so lookups are a binary search over the mapping. */
+struct ArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t alignment;
+    uint64_t entry_offset;
+    uint64_t string_offset;
+    uint64_t string_size;
+};
+struct ArchiveEntry {
+    uint64_t path_hash;
+    uint32_t path_offset;
+    uint32_t path_size;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t size;
+    Compression compression;
+    uint32_t reserved;
+};
+struct Archive {
+    std::string filepath{};
+    int file_descriptor = -1;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+
+    const ArchiveHeader* header = nullptr;
+    const ArchiveEntry* entries = nullptr;
+    const char* strings = nullptr;
+};
+struct PackInfo {
+    std::string directory;
+    std::string output_filepath;
+    Compression compression = COMPRESSION_NONE;
+    uint32_t alignment = ASSET_ARCHIVE_ALIGNMENT;
+};
+namespace archive {
+bool Initialize(Archive* archive, std::string filepath);
+void Finalize(Archive* archive);
+
+const ArchiveEntry* Find(Archive* archive, std::string_view path);
+std::string_view EntryPath(Archive* archive, const ArchiveEntry* entry);
+
+bool Pack(PackInfo info);
+} // namespace archive
+Archive* OpenArchive(std::string filepath);
+void CloseArchive(Archive* archive);
+
+/* An uncompressed archive entry is read as a view of the archive mapping, without a copy. Such a view, and
+ * the mapping of a FileLocation, is only valid until the archive is unmounted. */
+struct File {
+    const char* data = nullptr;
+    size_t size = 0;
+    // Backs data when the file could not be served as a view into an archive mapping
+    std::vector<char> storage{};
+};
+
+// Where a file's bytes live on disk, so callers can issue their own reads against it
+struct FileLocation {
+    int file_descriptor = -1;
+    // Directory mounts open a descriptor per file, archive mounts share the archive's descriptor
+    bool owns_file_descriptor = false;
+    uint64_t offset = 0;
+    uint64_t stored_size = 0;
+    uint64_t size = 0;
+    Compression compression = COMPRESSION_NONE;
+    // Set for archive entries, points at the stored bytes inside the archive mapping
+    const char* mapping = nullptr;
+};
+
+enum MountType {
+    MOUNT_TYPE_DIRECTORY = 0,
+    MOUNT_TYPE_ARCHIVE = 1,
+};
+struct Mount {
+    MountType type;
+    std::string mount_point;
+    std::string directory;
+    Archive* archive = nullptr;
+};
+namespace compression {
+bool Decompress(Compression compression, const char* source, size_t source_size, char* destination,
+                size_t destination_size);
+} // namespace compression
+
+// Mounts are searched newest first, so a later mount shadows files of an earlier one
+namespace vfs {
+void MountDirectory(std::string mount_point, std::string directory);
+// Fails for an archive with an entry or a path outside the file
+bool MountArchive(std::string mount_point, std::string filepath);
+// Unmaps archives, Files viewing their mappings must not be used afterwards
+void Unmount(std::string mount_point);
+
+bool Exists(std::string_view path);
+// Fails for files served from an archive, they have no path of their own on the host
+bool HostPath(std::string_view path, std::string* host_path);
+bool Read(std::string_view path, File* file);
+bool Locate(std::string_view path, FileLocation* location);
+void Release(FileLocation* location);
+
+void Finalize();
+} // namespace vfs
+} // namespace asset
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "offscreen.h"
+#include "threadpool.h"
+
+namespace render {
+enum CaptureFormat {
+    // One PNG per frame, named output followed by the frame number and .png
+    CAPTURE_FORMAT_PNG,
+    /* Raw I420 frames in order, for an encoder such as ffmpeg -f rawvideo -pix_fmt yuv420p. An output
+     * starting with | is run as a command that reads the frames from a pipe, any other output is a file. */
+    CAPTURE_FORMAT_YUV,
+};
+struct CaptureInfo {
+    CaptureFormat format = CAPTURE_FORMAT_PNG;
+    std::string output{};
+    // Runs the conversion and encoding of retired frames
+    core::ThreadPool* thread_pool = nullptr;
+    // Bytes of each readback buffer, a frame of a larger image is dropped
+    VkDeviceSize buffer_size = 0;
+    /* Frames that may be in flight or encoding at once, once all of them are a frame is dropped rather than
+     * waited for. 0 takes render::frames_in_flight + 2 at creation. */
+    uint32_t buffer_count = 0;
+};
+struct CaptureStatistics {
+    uint64_t captured_frames;
+    // Every readback was in use, or the image did not fit one
+    uint64_t dropped_frames;
+    uint64_t encoded_frames;
+    // Conversion or the write of the output failed
+    uint64_t failed_frames;
+};
+// A frame copied into a readback, written on the frame thread and by the command buffer recording it
+struct CaptureFrame {
+    Readback* readback;
+    uint64_t frame;
+    // Set once the copy is recorded, a frame that was never recorded is released unread
+    bool recorded;
+};
+/* Records a session without waiting on the GPU. Every frame the target image is copied into a ring of host
+ * visible readbacks, once the frame has retired its pixels are converted and encoded on the thread pool. The
+ * frame thread never blocks on a readback and the submission thread is not involved, a frame without a free
+ * readback is dropped and counted. */
+struct Capturer {
+    CaptureInfo info;
+    ReadbackPool* readback_pool;
+    FILE* file = nullptr;
+    bool file_is_pipe = false;
+
+    // Frames recorded and not yet retired, touched only by the frame thread
+    std::deque<CaptureFrame> pending_frames{};
+    // Numbers the encoded frames, frames that were dropped take no number
+    uint64_t next_sequence = 0;
+    // Size of the first YUV frame, raw video cannot change size
+    Extent3D stream_extent{};
+
+    std::mutex mutex{};
+    std::condition_variable idle_condition_variable{};
+    uint32_t encoding_count = 0;
+    // Converted YUV frames wait here until every frame before them has been written
+    std::map<uint64_t, std::vector<uint8_t>> converted_frames{};
+    uint64_t next_write_sequence = 0;
+    CaptureStatistics statistics{};
+};
+Capturer* CreateCapturer(CaptureInfo info);
+// Only once the device is idle, the frames still pending are encoded before the output is closed
+void DestroyCapturer(Capturer* capturer);
+namespace capturer {
+/* Call once per frame after render::BeginFrame. Hands the frames that have retired to the thread pool, then
+ * returns the frame to capture into, or nullptr when the frame is dropped. */
+CaptureFrame* BeginFrame(Capturer* capturer);
+CaptureStatistics GetStatistics(Capturer* capturer);
+} // namespace capturer
+
+namespace command {
+/* Records the copy of the image the frame rendered, after its color writes. layout is the layout the frame
+ * leaves the image in, PRESENT_SRC_KHR for a swapchain image. Does nothing for a null frame. */
+void Capture(CommandBuffer* command_buffer, Capturer* capturer, CaptureFrame* frame, VkImage vk_image,
+             Extent3D extent, VkFormat format, VkImageLayout layout, Fence* fence);
+} // namespace command
+} // namespace render
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "render.h"
+#include "resource.h"
+
+namespace render {
+enum BindingType {
+    BINDING_TYPE_STORAGE_BUFFER,
+    BINDING_TYPE_UNIFORM_BUFFER,
+    // Accessed in VK_IMAGE_LAYOUT_GENERAL, the image needs VK_IMAGE_USAGE_STORAGE_BIT
+    BINDING_TYPE_STORAGE_IMAGE,
+};
+struct BindingSetInfo {
+    // Binding i of the set is of type bindings[i]
+    std::vector<BindingType> bindings{};
+    VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT;
+};
+/* A descriptor set of buffers and storage images, and the layout pipelines are created against through
+ * descriptor_set_layouts. Writes change what commands recorded afterwards and frames still in flight read, so
+ * a set is written before the frames that use it, or double buffered per frame in flight. */
+struct BindingSet {
+    std::vector<BindingType> bindings;
+    VkDescriptorSetLayout vk_descriptor_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool vk_descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet vk_descriptor_set = VK_NULL_HANDLE;
+};
+BindingSet* CreateBindingSet(BindingSetInfo info);
+// Only once no frame in flight uses the set, pipelines created against its layout must be destroyed first
+void DestroyBindingSet(BindingSet* set);
+namespace binding_set {
+// The whole buffer, which must not be defragmentable since the set keeps its VkBuffer
+void Write(BindingSet* set, uint32_t binding, Buffer* buffer);
+// Neither may the image be, the set keeps its VkImageView
+void Write(BindingSet* set, uint32_t binding, Image* image);
+} // namespace binding_set
+
+namespace command {
+// Binds at the bind point of pipeline, whose layout has the layout of set at index
+void BindBindingSet(CommandBuffer* command_buffer, Pipeline* pipeline, uint32_t index, BindingSet* set);
+// vkCmdDispatch with a bound compute pipeline, counted in render::stats
+void Dispatch(CommandBuffer* command_buffer, uint32_t group_count_x, uint32_t group_count_y = 1,
+              uint32_t group_count_z = 1);
+// Reads a VkDispatchIndirectCommand at offset, the buffer needs VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+void DispatchIndirect(CommandBuffer* command_buffer, Buffer* buffer, VkDeviceSize offset = 0);
+// Makes the shader writes of earlier dispatches visible to later stages
+void ComputeBarrier(CommandBuffer* command_buffer, VkPipelineStageFlags destination_stages,
+                    VkAccessFlags destination_access);
+} // namespace command
+} // namespace render
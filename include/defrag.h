@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "vk_mem_alloc.h"
+#include "vulkan/vulkan.h"
+
+#include "resource.h"
+
+namespace render {
+struct DefragmenterInfo {
+    // Limits of one pass, at most one pass is in flight at a time
+    VkDeviceSize max_bytes_per_pass = 16ull * 1024 * 1024;
+    uint32_t max_allocations_per_pass = 64;
+    // Once preparing the moves of a pass takes this long, the rest of its moves are skipped
+    double max_milliseconds_per_pass = 0.5;
+    // Frames between the end of a defragmentation and the start of the next
+    uint32_t idle_frames = 120;
+    VmaDefragmentationFlags flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FAST_BIT;
+};
+struct DefragmenterStatistics {
+    VkDeviceSize bytes_moved;
+    VkDeviceSize bytes_freed;
+    uint32_t allocations_moved;
+    uint32_t memory_blocks_freed;
+    uint32_t pass_count;
+    uint32_t defragmentation_count;
+};
+/* A buffer or an image moving to memory VMA picked for it, with a new VkBuffer, or VkImage and VkImageView,
+ * bound to that memory. The copy is recorded from these handles alone, never from the resource. */
+struct DefragmentationMove {
+    // One of buffer and image is set
+    Buffer* buffer;
+    Image* image;
+    VmaDefragmentationMove* vma_move;
+
+    VkBuffer vk_source_buffer;
+    VkBuffer vk_destination_buffer;
+    VkDeviceSize size;
+
+    VkImage vk_source_image;
+    VkImageView vk_source_image_view;
+    VkImage vk_destination_image;
+    VkImageView vk_destination_image_view;
+    Extent3D extent;
+    VkImageAspectFlags aspect;
+    VkImageLayout layout;
+
+    // Set when the resource is finalized before the pass ends, which then frees both sides of the move
+    bool destroyed;
+};
+// The moves one frame records, captured on the calling thread so recording may run on another
+struct DefragmentationPass {
+    uint64_t frame = 0;
+    std::vector<DefragmentationMove> moves{};
+};
+/* Compacts the memory of defragmentable buffers and images with VMA, a few allocations every few frames, so
+ * the memory lost to fragmentation is returned during long sessions without a restart. A pass is begun on
+ * the frame thread, recorded into that frame's command buffer and ended once the frame has retired. The
+ * Buffer and Image objects keep their pool slots and are pointed at their new memory in place, so pointers
+ * and handles to them stay valid. */
+struct Defragmenter {
+    DefragmenterInfo info;
+
+    std::mutex mutex{};
+    VmaDefragmentationContext vma_context = VK_NULL_HANDLE;
+    VmaDefragmentationPassMoveInfo vma_pass{};
+    bool pass_active = false;
+    uint64_t next_frame = 0;
+    DefragmentationPass pass{};
+
+    DefragmenterStatistics statistics{};
+};
+Defragmenter* CreateDefragmenter(DefragmenterInfo info);
+// Only once the device is idle, a pass still in flight is ended
+void DestroyDefragmenter(Defragmenter* defragmenter);
+namespace defragmenter {
+/* Call once per frame after render::BeginFrame, before anything of the frame is recorded. Ends the pass of
+ * a frame that has retired, then begins the next one and returns it, or nullptr when nothing moves this
+ * frame. Beginning a pass waits for the record threads to finish the earlier frames, then points every
+ * resource of the pass at its destination, so the pass must be recorded this frame. */
+DefragmentationPass* BeginFrame(Defragmenter* defragmenter);
+DefragmenterStatistics GetStatistics(Defragmenter* defragmenter);
+} // namespace defragmenter
+
+namespace command {
+/* Records outside a renderpass, at the start of the command buffer the frame submits first, so everything
+ * else of the frame follows the copies of the pass in submission order. Copies every buffer and every image
+ * with defined contents to its destination. */
+void Defragment(CommandBuffer* command_buffer, Defragmenter* defragmenter, DefragmentationPass* pass);
+} // namespace command
+
+namespace defragmentation {
+/* Called by buffer::Finalize and image::Finalize for a defragmentable resource, from any thread. A resource
+ * taking part in a pass keeps its old and new memory until the pass ends, which then frees both. */
+void FinalizeBuffer(Buffer* buffer);
+void FinalizeImage(Image* image);
+} // namespace defragmentation
+} // namespace render
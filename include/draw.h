@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "arena.h"
+#include "render.h"
+#include "resource.h"
+#include "threadpool.h"
+
+namespace render {
+/* Packets sort by their key as an unsigned integer, so the fields are packed from the most significant
+ * bits down in the order state is most expensive to change: pass, pipeline, material, depth. */
+namespace draw_key {
+const uint32_t PASS_BITS = 8;
+const uint32_t PIPELINE_BITS = 16;
+const uint32_t MATERIAL_BITS = 16;
+const uint32_t DEPTH_BITS = 24;
+
+const uint64_t DEPTH_MASK = (1ull << DEPTH_BITS) - 1;
+
+/* Pipeline and material are ids chosen by the caller, only their grouping matters. Depth is clamped to
+ * 0 to 1 and drawn front to back, pass 1 - depth for back to front. */
+inline uint64_t Pack(uint32_t pass, uint32_t pipeline, uint32_t material, float depth) {
+    const uint32_t depth_max = (1u << DEPTH_BITS) - 1;
+    depth = depth > 0.0f ? (depth < 1.0f ? depth : 1.0f) : 0.0f;
+    uint64_t key = pass & ((1u << PASS_BITS) - 1);
+    key = (key << PIPELINE_BITS) | (pipeline & ((1u << PIPELINE_BITS) - 1));
+    key = (key << MATERIAL_BITS) | (material & ((1u << MATERIAL_BITS) - 1));
+    key = (key << DEPTH_BITS) | (uint32_t)(depth * depth_max + 0.5f);
+    return key;
+}
+} // namespace draw_key
+
+/* One draw and the state it needs. Descriptor sets, vertex buffer and index buffer may be left null to
+ * bind nothing, a null index buffer draws non-indexed. */
+struct DrawPacket {
+    uint64_t key = 0;
+    Pipeline* pipeline = nullptr;
+    // Bound as set 0 with the layout of the pipeline
+    VkDescriptorSet vk_descriptor_set = VK_NULL_HANDLE;
+    // Bound to binding 0
+    Buffer* vertex_buffer = nullptr;
+    Buffer* index_buffer = nullptr;
+
+    // Indices when indexed, vertices otherwise
+    uint32_t count = 0;
+    // First index when indexed, first vertex otherwise
+    uint32_t first = 0;
+    int32_t vertex_offset = 0;
+    // Ignored by a queue that batches, every packet is then one instance
+    uint32_t instance_count = 1;
+    uint32_t first_instance = 0;
+};
+
+struct DrawQueueInfo {
+    // Sorts at least this many packets split across the thread pool, fewer are sorted on the calling thread
+    uint32_t parallel_sort_threshold = 32768;
+    core::ThreadPool* thread_pool = nullptr;
+
+    /* Bytes of instance data every packet carries, 0 disables batching. A batching queue draws packets
+     * with the same pipeline, descriptor set and mesh within a pass and material as one instanced draw,
+     * with their instance data in a host written buffer bound to instance_binding, which the pipeline
+     * declares with VK_VERTEX_INPUT_RATE_INSTANCE. Packets then sort by mesh in place of depth. */
+    uint32_t instance_stride = 0;
+    uint32_t instance_binding = 1;
+};
+// What the last RecordDrawQueue issued and skipped
+struct DrawQueueStats {
+    uint32_t draw_count = 0;
+    // Packets drawn as an instance of an earlier packet instead of with a draw of their own
+    uint32_t batched_packets = 0;
+    uint32_t pipeline_binds = 0;
+    uint32_t descriptor_set_binds = 0;
+    uint32_t vertex_buffer_binds = 0;
+    uint32_t index_buffer_binds = 0;
+    uint32_t elided_binds = 0;
+};
+struct DrawSortEntry {
+    uint64_t key;
+    uint32_t packet;
+};
+// The geometry a packet draws, packets of a batch must have equal meshes
+struct DrawMesh {
+    Buffer* vertex_buffer;
+    Buffer* index_buffer;
+    uint32_t count;
+    uint32_t first;
+    int32_t vertex_offset;
+
+    bool operator==(const DrawMesh& other) const {
+        return vertex_buffer == other.vertex_buffer && index_buffer == other.index_buffer && count == other.count &&
+               first == other.first && vertex_offset == other.vertex_offset;
+    }
+};
+struct DrawMeshHash {
+    size_t operator()(const DrawMesh& mesh) const {
+        size_t hash = std::hash<const void*>()(mesh.vertex_buffer);
+        for (size_t value : {(size_t)mesh.index_buffer, (size_t)mesh.count, (size_t)mesh.first,
+                             (size_t)(uint32_t)mesh.vertex_offset}) {
+            hash = hash * 31 + value;
+        }
+        return hash;
+    }
+};
+using DrawMeshIds = std::unordered_map<DrawMesh, uint32_t, DrawMeshHash, std::equal_to<DrawMesh>,
+                                       core::ArenaAllocator<std::pair<const DrawMesh, uint32_t>>>;
+/* Packets submitted in any order, radix sorted by key and recorded with the binds the previous packet
+ * already made skipped. Not synchronized, keep one queue per frame slot when recording runs on the
+ * record thread while the next frame submits. */
+struct DrawQueue {
+    DrawQueueInfo info;
+    std::vector<DrawPacket> packets{};
+    // Sorted order, the second buffer is scratch for the radix passes
+    std::vector<DrawSortEntry> order{};
+    std::vector<DrawSortEntry> scratch{};
+    bool sorted = true;
+    DrawQueueStats stats{};
+
+    // Instance data of every packet in submission order, and the mesh ids that stand in for depth in the keys
+    std::vector<uint8_t> instance_data{};
+    // Holds the nodes of mesh_ids, which a map frees one by one on clear, reset with the queue instead
+    core::Arena mesh_id_arena{};
+    DrawMeshIds mesh_ids{&mesh_id_arena};
+    // Written in sorted order while recording, so it belongs to the frame slot of the queue
+    Buffer* instance_buffer = nullptr;
+};
+DrawQueue* CreateDrawQueue(DrawQueueInfo info);
+void DestroyDrawQueue(DrawQueue* queue);
+namespace draw_queue {
+// A batching queue copies instance_stride bytes of instance_data, which must then not be null
+void Submit(DrawQueue* queue, const DrawPacket& packet, const void* instance_data = nullptr);
+// Keeps the capacity, so a queue refilled every frame stops allocating once it has grown
+void Clear(DrawQueue* queue);
+// Stable, packets with equal keys keep their submission order. RecordDrawQueue sorts if this was not called
+void Sort(DrawQueue* queue);
+} // namespace draw_queue
+
+namespace command {
+/* Records inside a renderpass. Viewport and scissor are set again after every pipeline bind, since they
+ * are dynamic state of every pipeline. */
+DrawQueueStats RecordDrawQueue(CommandBuffer* command_buffer, DrawQueue* queue, const VkViewport& viewport,
+                               const VkRect2D& scissor);
+} // namespace command
+} // namespace render
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "math3d.h"
+#include "render.h"
+#include "resource.h"
+
+namespace render {
+using Frustum = core::Frustum;
+namespace frustum {
+// From a column major view projection matrix with Vulkan clip space, depth from 0 to 1
+Frustum FromViewProjection(const float view_projection[16]);
+} // namespace frustum
+
+/* An object in the std430 layout of cull.comp and indirect.vert. The bounding sphere is in object space,
+ * moved by the transform and scaled by its largest axis. */
+struct GpuObject {
+    float transform[16];
+    float bounding_sphere[4];
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t padding;
+};
+static_assert(sizeof(GpuObject) == 96, "GpuObject must match the std430 Object of cull.comp");
+
+struct IndirectSceneInfo {
+    uint32_t max_object_count = 65536;
+    /* Geometry shared by every object, owned by the caller. Vertices are vec4 positions pulled from a
+     * storage buffer by the vertex shader, which must not be defragmentable, indices are uint32. */
+    Buffer* vertex_buffer = nullptr;
+    Buffer* index_buffer = nullptr;
+};
+// What one frame uploads and culls, captured on the calling thread so recording may run on another
+struct IndirectFrame {
+    Buffer* staging_buffer = nullptr;
+    uint32_t upload_begin = 0;
+    uint32_t upload_end = 0;
+    uint32_t object_count = 0;
+};
+/* Objects culled against the frustum and drawn entirely on the GPU, one indirect draw records every
+ * object. The host copy of the objects is authoritative and only the range changed since the last frame
+ * is uploaded, so recording costs the same for any number of objects that do not change. */
+struct IndirectScene {
+    IndirectSceneInfo info;
+
+    // Requires multiDrawIndirect and drawIndirectFirstInstance, culling and drawing are no-ops without them
+    bool supported = false;
+    // Without drawIndirectCount every object keeps a draw, culled objects draw no instances
+    bool draw_indirect_count = false;
+
+    std::vector<GpuObject> objects{};
+    uint32_t dirty_begin = 0;
+    uint32_t dirty_end = 0;
+    IndirectFrame frames[MAX_FRAMES_IN_FLIGHT]{};
+
+    Buffer* object_buffer = nullptr;
+    // A VkDrawIndexedIndirectCommand per surviving object, firstInstance is the object index
+    Buffer* draw_buffer = nullptr;
+    // Surviving objects, also written without drawIndirectCount so culling can be checked
+    Buffer* count_buffer = nullptr;
+
+    // Objects, draws, count and vertices, shared by the cull pipeline and the draw pipeline as set 0
+    VkDescriptorSetLayout vk_descriptor_set_layout = VK_NULL_HANDLE;
+    VkDescriptorPool vk_descriptor_pool = VK_NULL_HANDLE;
+    VkDescriptorSet vk_descriptor_set = VK_NULL_HANDLE;
+    // cull.comp, hot reloaded with the other pipelines once registered with a reloader
+    Pipeline* cull_pipeline = nullptr;
+};
+IndirectScene* CreateIndirectScene(IndirectSceneInfo info);
+void DestroyIndirectScene(IndirectScene* scene);
+namespace indirect_scene {
+// Returns the index of the object, or UINT32_MAX once max_object_count objects have been added
+uint32_t AddObject(IndirectScene* scene, const GpuObject& object);
+void SetObject(IndirectScene* scene, uint32_t index, const GpuObject& object);
+void Clear(IndirectScene* scene);
+
+/* Call once per frame after render::BeginFrame, on the thread that changes the objects. Copies the
+ * changed objects into the staging buffer of the frame slot. */
+IndirectFrame* BeginFrame(IndirectScene* scene);
+
+// The test cull.comp applies, margin grows every plane so results can be checked within a tolerance
+inline bool Visible(const Frustum& frustum, const GpuObject& object, float margin = 0.0f) {
+    const float* m = object.transform;
+    const float* sphere = object.bounding_sphere;
+    float center[3];
+    for (int i = 0; i < 3; i++) {
+        center[i] = m[i] * sphere[0] + m[4 + i] * sphere[1] + m[8 + i] * sphere[2] + m[12 + i];
+    }
+    float scale = 0.0f;
+    for (int column = 0; column < 3; column++) {
+        const float* axis = &m[column * 4];
+        scale = std::max(scale, axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    }
+    float radius = sphere[3] * std::sqrt(scale);
+    for (const float* plane : frustum.planes) {
+        if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius - margin) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace indirect_scene
+
+namespace command {
+/* Records outside a renderpass. Uploads the changed objects, culls every object and writes the draws of
+ * the survivors, which the following DrawIndirectScene consumes. */
+void CullIndirectScene(CommandBuffer* command_buffer, IndirectScene* scene, IndirectFrame* frame,
+                       const Frustum& frustum);
+/* Records inside a renderpass. The pipeline must take scene->vk_descriptor_set_layout as set 0 and the
+ * view projection as a 64 byte vertex push constant, as indirect.vert does. */
+void DrawIndirectScene(CommandBuffer* command_buffer, IndirectScene* scene, IndirectFrame* frame, Pipeline* pipeline,
+                       const float view_projection[16]);
+} // namespace command
+} // namespace render
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "asset.h"
+#include "threadpool.h"
+
+namespace asset {
+enum IoPriority {
+    IO_PRIORITY_LOW = 0,
+    IO_PRIORITY_NORMAL = 1,
+    IO_PRIORITY_HIGH = 2,
+    IO_PRIORITY_CRITICAL = 3,
+    IO_PRIORITY_COUNT = 4,
+};
+enum IoStatus {
+    IO_STATUS_PENDING = 0,
+    IO_STATUS_COMPLETE = 1,
+    IO_STATUS_FAILED = 2,
+    IO_STATUS_CANCELLED = 3,
+};
+typedef uint64_t IoHandle;
+
+struct IoResult {
+    IoHandle handle;
+    IoStatus status;
+    void* destination;
+    uint64_t size;
+};
+struct IoRequest {
+    // VFS path, resolved through asset::vfs::Locate when the request is queued
+    std::string path;
+    uint64_t offset = 0;
+    // 0 reads from offset to the end of the file
+    uint64_t size = 0;
+    // Caller owned, must hold size bytes until the completion runs, typically a StagingRing allocation
+    void* destination = nullptr;
+    IoPriority priority = IO_PRIORITY_NORMAL;
+    /* Run from io::Poll on the polling thread, never from the I/O thread. A request without one must be
+     * awaited through io::Await, which is where its status is released, so a request nothing waits on needs
+     * a completion, even an empty one. */
+    std::function<void(IoResult)> completion{};
+};
+
+enum IoBackend {
+    IO_BACKEND_THREAD_POOL = 0,
+    IO_BACKEND_IO_URING = 1,
+};
+struct IoQueueInfo {
+    // Requests kept in flight at once
+    uint32_t queue_depth = 64;
+    // Worker threads of the thread pool backend, also used to decompress archive entries
+    uint32_t worker_count = 2;
+    bool prefer_io_uring = true;
+};
+struct IoOperation {
+    IoHandle handle;
+    IoRequest request;
+    FileLocation location;
+    uint64_t completed_size = 0;
+    bool cancelled = false;
+};
+struct IoQueue {
+    IoBackend backend;
+    uint32_t queue_depth;
+
+    bool active = true;
+    std::thread io_thread{};
+    core::ThreadPool* worker_pool = nullptr;
+    void* uring = nullptr;
+
+    std::mutex mutex{};
+    std::condition_variable condition_variable{};
+    IoHandle next_handle = 1;
+    std::deque<IoOperation*> pending_queues[IO_PRIORITY_COUNT]{};
+    std::unordered_map<IoHandle, IoOperation*> in_flight{};
+    std::vector<std::pair<IoOperation*, IoStatus>> completions{};
+    // Of the requests without a completion, until awaited
+    std::unordered_map<IoHandle, IoStatus> statuses{};
+    std::condition_variable completion_condition_variable{};
+
+    std::atomic<uint64_t> bytes_read = 0;
+};
+IoQueue* CreateIoQueue(IoQueueInfo info);
+void DestroyIoQueue(IoQueue* queue);
+namespace io {
+IoHandle ReadAsync(IoQueue* queue, IoRequest request);
+std::vector<IoHandle> ReadBatchAsync(IoQueue* queue, std::vector<IoRequest> requests);
+// Pending requests are dropped, in-flight ones still land in their destination but complete as cancelled
+bool Cancel(IoQueue* queue, IoHandle handle);
+
+// Runs completions that have arrived since the last call, never blocks
+uint32_t Poll(IoQueue* queue);
+// Only for a request without a completion, once
+IoStatus Await(IoQueue* queue, IoHandle handle);
+
+void IoThreadFunction(IoQueue* queue);
+} // namespace io
+
+/* A ring allocator over caller provided memory, typically a persistently mapped staging buffer.
+ * Allocations are released in the order they were made. */
+struct StagingRing {
+    char* memory = nullptr;
+    uint64_t capacity = 0;
+
+    std::mutex mutex{};
+    uint64_t head = 0;
+    uint64_t tail = 0;
+    // End position of each outstanding allocation, oldest first
+    std::deque<uint64_t> allocation_ends{};
+};
+StagingRing* CreateStagingRing(void* memory, uint64_t capacity);
+void DestroyStagingRing(StagingRing* ring);
+namespace staging_ring {
+// Returns nullptr when the ring is full, offset receives the position of the allocation within the memory
+void* Allocate(StagingRing* ring, uint64_t size, uint64_t alignment, uint64_t* offset);
+// Releases the oldest outstanding allocation
+void Release(StagingRing* ring);
+uint64_t Available(StagingRing* ring);
+} // namespace staging_ring
+} // namespace asset
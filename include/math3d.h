@@ -0,0 +1,362 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+/* Vectors, column major matrices and quaternions for the engine. Matrices follow Vulkan clip space, y down
+ * and depth from 0 to 1, and multiply column vectors. The hot operations take an SSE, AVX2 or NEON path
+ * picked at compile time, define CORE_MATH_SCALAR to build the plain C++ path everywhere instead. */
+#if !defined(CORE_MATH_SCALAR)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CORE_MATH_SSE
+#include <immintrin.h>
+#if defined(__AVX2__) && defined(__FMA__)
+#define CORE_MATH_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define CORE_MATH_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace core {
+struct Vec3 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+};
+struct alignas(16) Vec4 {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 0.0f;
+};
+struct alignas(16) Quat {
+    float x = 0.0f;
+    float y = 0.0f;
+    float z = 0.0f;
+    float w = 1.0f;
+};
+// Column major, m[column * 4 + row], so m is what a shader reads from a mat4 in a uniform or push constant
+struct alignas(16) Mat4 {
+    float m[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f};
+};
+struct Aabb {
+    Vec3 min;
+    Vec3 max;
+};
+// Planes as a normal and a distance, normals point inwards so a point p is inside when dot(n, p) + d >= 0
+struct Frustum {
+    float planes[6][4];
+};
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return {a.x + b.x, a.y + b.y, a.z + b.z}; }
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+inline Vec3 operator*(const Vec3& a, float s) { return {a.x * s, a.y * s, a.z * s}; }
+inline Vec3 operator*(const Vec3& a, const Vec3& b) { return {a.x * b.x, a.y * b.y, a.z * b.z}; }
+inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 Cross(const Vec3& a, const Vec3& b) {
+    return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+inline float Length(const Vec3& a) { return std::sqrt(Dot(a, a)); }
+inline Vec3 Normalize(const Vec3& a) {
+    float length = Length(a);
+    return length > 0.0f ? a * (1.0f / length) : a;
+}
+
+namespace quat {
+inline Quat FromAxisAngle(const Vec3& axis, float angle) {
+    Vec3 v = Normalize(axis) * std::sin(0.5f * angle);
+    return {v.x, v.y, v.z, std::cos(0.5f * angle)};
+}
+// a * b rotates by b first, then by a
+inline Quat Multiply(const Quat& a, const Quat& b) {
+    Quat result;
+#if defined(CORE_MATH_SSE)
+    // Every term of a component is a lane of a reordered b times one component of a, with the signs below
+    __m128 vb = _mm_load_ps(&b.x);
+    __m128 r = _mm_mul_ps(_mm_set1_ps(a.w), vb);
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(a.x), _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(0, 1, 2, 3))),
+                                 _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(a.y), _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                                 _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(a.z), _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 3, 0, 1))),
+                                 _mm_setr_ps(-1.0f, 1.0f, 1.0f, -1.0f)));
+    _mm_store_ps(&result.x, r);
+#elif defined(CORE_MATH_NEON)
+    float32x4_t vb = vld1q_f32(&b.x);
+    float32x4_t zwxy = vextq_f32(vb, vb, 2);
+    const float wzyx_signs[4] = {1.0f, -1.0f, 1.0f, -1.0f};
+    const float zwxy_signs[4] = {1.0f, 1.0f, -1.0f, -1.0f};
+    const float yxwz_signs[4] = {-1.0f, 1.0f, 1.0f, -1.0f};
+    float32x4_t r = vmulq_n_f32(vb, a.w);
+    r = vmlaq_f32(r, vmulq_n_f32(vrev64q_f32(zwxy), a.x), vld1q_f32(wzyx_signs));
+    r = vmlaq_f32(r, vmulq_n_f32(zwxy, a.y), vld1q_f32(zwxy_signs));
+    r = vmlaq_f32(r, vmulq_n_f32(vrev64q_f32(vb), a.z), vld1q_f32(yxwz_signs));
+    vst1q_f32(&result.x, r);
+#else
+    result.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+    result.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+    result.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+    result.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+#endif
+    return result;
+}
+inline Quat Normalize(const Quat& q) {
+    float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+    float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+    return {q.x * inverse, q.y * inverse, q.z * inverse, q.w * inverse};
+}
+inline Quat Conjugate(const Quat& q) { return {-q.x, -q.y, -q.z, q.w}; }
+// For a unit quaternion, v + 2w(u x v) + 2u x (u x v) with u the vector part
+inline Vec3 Rotate(const Quat& q, const Vec3& v) {
+    Vec3 u{q.x, q.y, q.z};
+    Vec3 t = Cross(u, v) * 2.0f;
+    return v + t * q.w + Cross(u, t);
+}
+// Takes the shorter arc and falls back to a normalized lerp when the rotations are nearly equal
+inline Quat Slerp(const Quat& a, const Quat& b, float t) {
+    float cosine = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    float sign = cosine < 0.0f ? -1.0f : 1.0f;
+    cosine *= sign;
+    float wa = 1.0f - t, wb = t;
+    if (cosine < 0.9995f) {
+        float angle = std::acos(cosine);
+        float inverse_sine = 1.0f / std::sin(angle);
+        wa = std::sin(wa * angle) * inverse_sine;
+        wb = std::sin(wb * angle) * inverse_sine;
+    }
+    wb *= sign;
+    return Normalize({wa * a.x + wb * b.x, wa * a.y + wb * b.y, wa * a.z + wb * b.z, wa * a.w + wb * b.w});
+}
+} // namespace quat
+
+namespace mat4 {
+inline Mat4 Multiply(const Mat4& a, const Mat4& b) {
+    Mat4 result;
+#if defined(CORE_MATH_AVX2)
+    // Two columns of the result at once, each lane half broadcasts the elements of its own column of b
+    __m256 a0 = _mm256_broadcast_ps((const __m128*)&a.m[0]);
+    __m256 a1 = _mm256_broadcast_ps((const __m128*)&a.m[4]);
+    __m256 a2 = _mm256_broadcast_ps((const __m128*)&a.m[8]);
+    __m256 a3 = _mm256_broadcast_ps((const __m128*)&a.m[12]);
+    for (int column = 0; column < 4; column += 2) {
+        __m256 vb = _mm256_loadu_ps(&b.m[column * 4]);
+        __m256 r = _mm256_mul_ps(a0, _mm256_shuffle_ps(vb, vb, _MM_SHUFFLE(0, 0, 0, 0)));
+        r = _mm256_fmadd_ps(a1, _mm256_shuffle_ps(vb, vb, _MM_SHUFFLE(1, 1, 1, 1)), r);
+        r = _mm256_fmadd_ps(a2, _mm256_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 2, 2, 2)), r);
+        r = _mm256_fmadd_ps(a3, _mm256_shuffle_ps(vb, vb, _MM_SHUFFLE(3, 3, 3, 3)), r);
+        _mm256_storeu_ps(&result.m[column * 4], r);
+    }
+#elif defined(CORE_MATH_SSE)
+    __m128 a0 = _mm_load_ps(&a.m[0]);
+    __m128 a1 = _mm_load_ps(&a.m[4]);
+    __m128 a2 = _mm_load_ps(&a.m[8]);
+    __m128 a3 = _mm_load_ps(&a.m[12]);
+    for (int column = 0; column < 4; column++) {
+        const float* vb = &b.m[column * 4];
+        __m128 r = _mm_mul_ps(a0, _mm_set1_ps(vb[0]));
+        r = _mm_add_ps(r, _mm_mul_ps(a1, _mm_set1_ps(vb[1])));
+        r = _mm_add_ps(r, _mm_mul_ps(a2, _mm_set1_ps(vb[2])));
+        r = _mm_add_ps(r, _mm_mul_ps(a3, _mm_set1_ps(vb[3])));
+        _mm_store_ps(&result.m[column * 4], r);
+    }
+#elif defined(CORE_MATH_NEON)
+    float32x4_t a0 = vld1q_f32(&a.m[0]);
+    float32x4_t a1 = vld1q_f32(&a.m[4]);
+    float32x4_t a2 = vld1q_f32(&a.m[8]);
+    float32x4_t a3 = vld1q_f32(&a.m[12]);
+    for (int column = 0; column < 4; column++) {
+        const float* vb = &b.m[column * 4];
+        float32x4_t r = vmulq_n_f32(a0, vb[0]);
+        r = vmlaq_n_f32(r, a1, vb[1]);
+        r = vmlaq_n_f32(r, a2, vb[2]);
+        r = vmlaq_n_f32(r, a3, vb[3]);
+        vst1q_f32(&result.m[column * 4], r);
+    }
+#else
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 4; row++) {
+            result.m[column * 4 + row] = a.m[row] * b.m[column * 4] + a.m[4 + row] * b.m[column * 4 + 1] +
+                                         a.m[8 + row] * b.m[column * 4 + 2] + a.m[12 + row] * b.m[column * 4 + 3];
+        }
+    }
+#endif
+    return result;
+}
+inline Vec4 Transform(const Mat4& a, const Vec4& v) {
+    Vec4 result;
+#if defined(CORE_MATH_SSE)
+    __m128 r = _mm_mul_ps(_mm_load_ps(&a.m[0]), _mm_set1_ps(v.x));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&a.m[4]), _mm_set1_ps(v.y)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&a.m[8]), _mm_set1_ps(v.z)));
+    r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&a.m[12]), _mm_set1_ps(v.w)));
+    _mm_store_ps(&result.x, r);
+#elif defined(CORE_MATH_NEON)
+    float32x4_t r = vmulq_n_f32(vld1q_f32(&a.m[0]), v.x);
+    r = vmlaq_n_f32(r, vld1q_f32(&a.m[4]), v.y);
+    r = vmlaq_n_f32(r, vld1q_f32(&a.m[8]), v.z);
+    r = vmlaq_n_f32(r, vld1q_f32(&a.m[12]), v.w);
+    vst1q_f32(&result.x, r);
+#else
+    const float* m = a.m;
+    result.x = m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12] * v.w;
+    result.y = m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13] * v.w;
+    result.z = m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14] * v.w;
+    result.w = m[3] * v.x + m[7] * v.y + m[11] * v.z + m[15] * v.w;
+#endif
+    return result;
+}
+
+inline Mat4 Translation(const Vec3& t) {
+    Mat4 result;
+    result.m[12] = t.x;
+    result.m[13] = t.y;
+    result.m[14] = t.z;
+    return result;
+}
+// Translation * rotation * scale, written out rather than multiplied
+inline Mat4 Compose(const Vec3& t, const Quat& r, const Vec3& s) {
+    float xx = r.x * r.x, yy = r.y * r.y, zz = r.z * r.z;
+    float xy = r.x * r.y, xz = r.x * r.z, yz = r.y * r.z;
+    float wx = r.w * r.x, wy = r.w * r.y, wz = r.w * r.z;
+    Mat4 result;
+    float* m = result.m;
+    m[0] = (1.0f - 2.0f * (yy + zz)) * s.x;
+    m[1] = 2.0f * (xy + wz) * s.x;
+    m[2] = 2.0f * (xz - wy) * s.x;
+    m[3] = 0.0f;
+    m[4] = 2.0f * (xy - wz) * s.y;
+    m[5] = (1.0f - 2.0f * (xx + zz)) * s.y;
+    m[6] = 2.0f * (yz + wx) * s.y;
+    m[7] = 0.0f;
+    m[8] = 2.0f * (xz + wy) * s.z;
+    m[9] = 2.0f * (yz - wx) * s.z;
+    m[10] = (1.0f - 2.0f * (xx + yy)) * s.z;
+    m[11] = 0.0f;
+    m[12] = t.x;
+    m[13] = t.y;
+    m[14] = t.z;
+    m[15] = 1.0f;
+    return result;
+}
+inline Mat4 FromQuat(const Quat& r) { return Compose({}, r, {1.0f, 1.0f, 1.0f}); }
+// Right handed, looking down -z, vertical field of view in radians
+inline Mat4 Perspective(float vertical_fov, float aspect, float near, float far) {
+    float focal = 1.0f / std::tan(0.5f * vertical_fov);
+    Mat4 result;
+    float* m = result.m;
+    m[0] = focal / aspect;
+    m[5] = -focal;
+    m[10] = far / (near - far);
+    m[11] = -1.0f;
+    m[14] = near * far / (near - far);
+    m[15] = 0.0f;
+    return result;
+}
+// The view matrix of a camera at eye looking at target, right handed
+inline Mat4 LookAt(const Vec3& eye, const Vec3& target, const Vec3& up) {
+    Vec3 f = Normalize(target - eye);
+    Vec3 s = Normalize(Cross(f, up));
+    Vec3 u = Cross(s, f);
+    Mat4 result;
+    float* m = result.m;
+    const float rows[3][4] = {
+        {s.x, s.y, s.z, -Dot(s, eye)},
+        {u.x, u.y, u.z, -Dot(u, eye)},
+        {-f.x, -f.y, -f.z, Dot(f, eye)},
+    };
+    for (int row = 0; row < 3; row++) {
+        for (int column = 0; column < 4; column++) {
+            m[column * 4 + row] = rows[row][column];
+        }
+    }
+    return result;
+}
+} // namespace mat4
+inline Mat4 operator*(const Mat4& a, const Mat4& b) { return mat4::Multiply(a, b); }
+inline Vec4 operator*(const Mat4& a, const Vec4& v) { return mat4::Transform(a, v); }
+inline Quat operator*(const Quat& a, const Quat& b) { return quat::Multiply(a, b); }
+
+namespace frustum {
+// The same planes as render::frustum::FromViewProjection, rearranged so one box is tested against every plane at once
+struct FrustumLanes {
+    // Two planes that every box passes pad the six to eight lanes
+    alignas(32) float x[8];
+    alignas(32) float y[8];
+    alignas(32) float z[8];
+    alignas(32) float d[8];
+};
+inline FrustumLanes ToLanes(const Frustum& frustum) {
+    FrustumLanes lanes{};
+    for (int i = 0; i < 8; i++) {
+        lanes.x[i] = i < 6 ? frustum.planes[i][0] : 0.0f;
+        lanes.y[i] = i < 6 ? frustum.planes[i][1] : 0.0f;
+        lanes.z[i] = i < 6 ? frustum.planes[i][2] : 0.0f;
+        lanes.d[i] = i < 6 ? frustum.planes[i][3] : 1.0f;
+    }
+    return lanes;
+}
+// A box is outside once its center is further behind a plane than its extent reaches towards it
+inline bool Intersects(const FrustumLanes& lanes, const Aabb& box) {
+    Vec3 c = (box.min + box.max) * 0.5f;
+    Vec3 e = (box.max - box.min) * 0.5f;
+#if defined(CORE_MATH_AVX2)
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 x = _mm256_load_ps(lanes.x), y = _mm256_load_ps(lanes.y), z = _mm256_load_ps(lanes.z);
+    __m256 distance = _mm256_fmadd_ps(x, _mm256_set1_ps(c.x), _mm256_load_ps(lanes.d));
+    distance = _mm256_fmadd_ps(y, _mm256_set1_ps(c.y), distance);
+    distance = _mm256_fmadd_ps(z, _mm256_set1_ps(c.z), distance);
+    __m256 radius = _mm256_mul_ps(_mm256_andnot_ps(sign, x), _mm256_set1_ps(e.x));
+    radius = _mm256_fmadd_ps(_mm256_andnot_ps(sign, y), _mm256_set1_ps(e.y), radius);
+    radius = _mm256_fmadd_ps(_mm256_andnot_ps(sign, z), _mm256_set1_ps(e.z), radius);
+    return _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ)) == 0;
+#elif defined(CORE_MATH_SSE)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    int outside = 0;
+    for (int i = 0; i < 8; i += 4) {
+        __m128 x = _mm_load_ps(&lanes.x[i]), y = _mm_load_ps(&lanes.y[i]), z = _mm_load_ps(&lanes.z[i]);
+        __m128 distance = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(c.x)), _mm_load_ps(&lanes.d[i]));
+        distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(c.y)));
+        distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(c.z)));
+        __m128 radius = _mm_mul_ps(_mm_andnot_ps(sign, x), _mm_set1_ps(e.x));
+        radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign, y), _mm_set1_ps(e.y)));
+        radius = _mm_add_ps(radius, _mm_mul_ps(_mm_andnot_ps(sign, z), _mm_set1_ps(e.z)));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+    }
+    return outside == 0;
+#elif defined(CORE_MATH_NEON)
+    uint32x4_t outside = vdupq_n_u32(0);
+    for (int i = 0; i < 8; i += 4) {
+        float32x4_t x = vld1q_f32(&lanes.x[i]), y = vld1q_f32(&lanes.y[i]), z = vld1q_f32(&lanes.z[i]);
+        float32x4_t distance = vmlaq_n_f32(vld1q_f32(&lanes.d[i]), x, c.x);
+        distance = vmlaq_n_f32(distance, y, c.y);
+        distance = vmlaq_n_f32(distance, z, c.z);
+        float32x4_t radius = vmulq_n_f32(vabsq_f32(x), e.x);
+        radius = vmlaq_n_f32(radius, vabsq_f32(y), e.y);
+        radius = vmlaq_n_f32(radius, vabsq_f32(z), e.z);
+        outside = vorrq_u32(outside, vcltq_f32(vaddq_f32(distance, radius), vdupq_n_f32(0.0f)));
+    }
+    uint32x2_t halves = vorr_u32(vget_low_u32(outside), vget_high_u32(outside));
+    return vget_lane_u32(vpmax_u32(halves, halves), 0) == 0;
+#else
+    for (int i = 0; i < 6; i++) {
+        float distance = lanes.x[i] * c.x + lanes.y[i] * c.y + lanes.z[i] * c.z + lanes.d[i];
+        float radius = std::fabs(lanes.x[i]) * e.x + std::fabs(lanes.y[i]) * e.y + std::fabs(lanes.z[i]) * e.z;
+        if (distance + radius < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
+inline bool Intersects(const Frustum& frustum, const Aabb& box) { return Intersects(ToLanes(frustum), box); }
+// Writes 1 to visible for every box that may be inside the frustum and 0 for every box that is not
+inline void CullAabbs(const Frustum& frustum, const Aabb* boxes, uint32_t count, uint8_t* visible) {
+    FrustumLanes lanes = ToLanes(frustum);
+    for (uint32_t i = 0; i < count; i++) {
+        visible[i] = Intersects(lanes, boxes[i]) ? 1 : 0;
+    }
+}
+} // namespace frustum
+} // namespace core
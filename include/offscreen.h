@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "render.h"
+#include "resource.h"
+
+namespace render {
+struct OffscreenTargetInfo {
+    Extent3D extent;
+    VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+    /* One image per frame in flight, so a frame never renders into an image still being read back,
+     * 0 takes render::frames_in_flight at creation */
+    uint32_t image_count = 0;
+};
+/* Stands in for a Swapchain when rendering without a window, a ring of color images that are
+ * acquired in order. The images end a frame in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL for readback. */
+struct OffscreenTarget {
+    Extent3D extent;
+    VkFormat format;
+    std::vector<Image*> images{};
+    std::vector<VkImageView> vk_image_views{};
+    uint32_t next_image_index = 0;
+
+    std::vector<std::function<void()>> recreation_functions{};
+};
+namespace offscreen_target {
+void Initialize(OffscreenTarget* target, OffscreenTargetInfo info);
+void Finalize(OffscreenTarget* target);
+
+// Unlike swapchain::Recreate this never waits on the device, the replaced images are retired
+void Recreate(OffscreenTarget* target, Extent3D extent);
+void AcquireImage(OffscreenTarget* target, uint32_t* image_index);
+
+void BindRecreationFunction(OffscreenTarget* target, std::function<void()> function);
+} // namespace offscreen_target
+OffscreenTarget* CreateOffscreenTarget(OffscreenTargetInfo info);
+void DestroyOffscreenTarget(OffscreenTarget* target);
+
+struct ReadbackPoolInfo {
+    VkDeviceSize buffer_size;
+    /* Readbacks beyond the frames in flight let the host process a frame while the next ones render,
+     * 0 takes render::frames_in_flight + 1 at creation */
+    uint32_t buffer_count = 0;
+};
+struct Readback {
+    Buffer* buffer;
+    Extent3D extent{};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    // Fence of the submission that records the copy, awaited by readback_pool::Read
+    Fence* fence = nullptr;
+};
+/* Persistently mapped host buffers that offscreen images are copied into. Buffers are created once
+ * and recycled, so steady state readback allocates nothing. */
+struct ReadbackPool {
+    std::vector<Readback*> readbacks{};
+
+    std::mutex mutex{};
+    std::condition_variable condition_variable{};
+    std::deque<Readback*> free_readbacks{};
+};
+ReadbackPool* CreateReadbackPool(ReadbackPoolInfo info);
+void DestroyReadbackPool(ReadbackPool* pool);
+namespace readback_pool {
+// Blocks until a readback has been released
+Readback* Acquire(ReadbackPool* pool);
+// nullptr while every readback is in use, for callers that drop work rather than wait
+Readback* TryAcquire(ReadbackPool* pool);
+void Release(ReadbackPool* pool, Readback* readback);
+
+// Records the copy of a TRANSFER_SRC_OPTIMAL image, fence must be the fence of the submission it is recorded into
+void RecordCopy(CommandBuffer* command_buffer, Readback* readback, Image* image, Fence* fence);
+/* Records the copy of an image in layout after its color writes, and returns it to layout afterwards.
+ * Swapchain images are copied in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR. */
+void RecordCopy(CommandBuffer* command_buffer, Readback* readback, VkImage vk_image, Extent3D extent, VkFormat format,
+                VkImageLayout layout, Fence* fence);
+// Waits for the copy to complete and returns the tightly packed pixels
+const void* Read(Readback* readback);
+} // namespace readback_pool
+} // namespace render
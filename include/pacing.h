@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "render.h"
+
+namespace render {
+struct FramePacerInfo {
+    // Frames per second the CPU is held to, 0 leaves it to the fences and the present mode
+    double target_frame_rate = 0.0;
+    // sleep_for overshoots by the scheduler quantum, so the last stretch of a wait is spun instead
+    int64_t spin_threshold_ns = 1000000;
+    // Frames the rolling averages are taken over
+    uint32_t history_frame_count = 120;
+};
+struct FrameTiming {
+    double last_ms;
+    double average_ms;
+    double max_ms;
+};
+struct FrameTimingHistory {
+    std::vector<double> samples{};
+    uint32_t next_sample = 0;
+    uint32_t sample_count = 0;
+    double sum = 0.0;
+    double last = 0.0;
+};
+/* Limits the CPU frame rate by waiting at the start of a frame, before input is sampled, so the input a
+ * frame renders is as recent as possible instead of aging while the frame waits on a fence or a full
+ * present queue. Also measures input to present latency, from the end of the wait to the return of
+ * vkQueuePresentKHR. Scanout adds the time the image then spends queued, at most a frame under FIFO. */
+struct FramePacer {
+    FramePacerInfo info;
+    int64_t target_frame_ns = 0;
+    int64_t next_frame_ns = 0;
+
+    // Wait is measured on the main thread, latency is recorded on the submission thread
+    std::mutex mutex{};
+    FrameTimingHistory wait{};
+    FrameTimingHistory latency{};
+};
+FramePacer* CreateFramePacer(FramePacerInfo info);
+void DestroyFramePacer(FramePacer* pacer);
+namespace frame_pacer {
+// Call once per frame right before input is sampled, returns the sampling time for RecordPresent
+int64_t Wait(FramePacer* pacer);
+void SetTargetFrameRate(FramePacer* pacer, double target_frame_rate);
+
+// Call from PresentInfo::presented with the time Wait returned for the presented frame
+void RecordPresent(FramePacer* pacer, int64_t input_time_ns);
+FrameTiming GetWaitTiming(FramePacer* pacer);
+FrameTiming GetLatencyTiming(FramePacer* pacer);
+} // namespace frame_pacer
+} // namespace render
@@ -4,17 +4,25 @@
 
 #include <string>
 
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <mutex>
+#include <optional>
 #include <thread>
+#include <vector>
 
 #include "vulkan/vulkan.h"
 
+#ifndef RENDER_GLSLC_PATH
+#define RENDER_GLSLC_PATH "glslc"
+#endif
+
 namespace render {
 enum ShaderStage {
     SHADER_STAGE_VERTEX = 0x00000001,
     SHADER_STAGE_FRAGMENT = 0x00000010,
+    SHADER_STAGE_COMPUTE = 0x00000020,
 };
 enum ShaderFormat {
     SHADER_FORMAT_GLSL,
@@ -37,6 +45,17 @@ VkShaderModule CompileSPIRV(size_t buffer_size, char* buffer);
 
 void Initialize(Shader* pointer, ShaderInfo shader_info);
 void Finalize(Shader* pointer);
+/* Reads a SPIR-V file ahead of Initialize, which then takes it instead of reading it again, so startup can
+ * read shaders on worker threads while the device is created. Callable from any thread, it must return
+ * before the shader is initialized. */
+void Prefetch(const std::string& filepath);
+
+// Where Initialize compiles a GLSL shader to, next to its source as the build does
+std::string SpirvFilepath(const std::string& host_filepath);
+/* Runs glslc over the GLSL source into a file of its own, then renames it over spirv_filepath. Compiles of
+ * one source never write the same file at once, and a reader sees the old or the new SPIR-V whole. Throws
+ * std::runtime_error when the source does not compile. */
+void CompileGLSLFile(ShaderStage stage, const std::string& host_filepath, const std::string& spirv_filepath);
 } // namespace shader
 Shader* CreateShader(ShaderInfo info);
 void DestroyShader(Shader* shader);
@@ -89,8 +108,9 @@ struct PushConstantRange {
 
 struct Renderpass;
 struct PipelineInfo {
-    // std::vector<PushConstantRange> push_constant_ranges;
-    // std::vector<DescriptorSetLayout> descriptor_set_layouts;
+    std::vector<PushConstantRange> push_constant_ranges{};
+    // Owned by the caller, they must outlive the pipeline
+    std::vector<VkDescriptorSetLayout> descriptor_set_layouts{};
 
     std::vector<VertexBinding> vertex_bindings;
     std::vector<VertexAttribute> vertex_attributes;
@@ -104,15 +124,34 @@ struct PipelineInfo {
     bool depth_test_enabled = false;
     bool depth_write_enabled = false;
 };
+// A pipeline of a single compute shader
+struct ComputePipelineInfo {
+    std::vector<PushConstantRange> push_constant_ranges{};
+    // Owned by the caller, they must outlive the pipeline
+    std::vector<VkDescriptorSetLayout> descriptor_set_layouts{};
+
+    ShaderInfo shader;
+};
 struct Pipeline {
+    // The info of a graphics or of a compute pipeline, whichever it was created from
+    std::optional<PipelineInfo> recreation_info{};
+    std::optional<ComputePipelineInfo> compute_recreation_info{};
+    VkPipelineBindPoint vk_bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
     VkPipelineLayout vk_pipeline_layout;
-    VkPipeline vk_pipeline;
+    // Swapped by hot reload at a frame boundary while command buffers may still be recording
+    std::atomic<VkPipeline> vk_pipeline{VK_NULL_HANDLE};
 };
 namespace pipeline {
 void Initialize(Pipeline* pointer, PipelineInfo info);
+void Initialize(Pipeline* pointer, ComputePipelineInfo info);
 void Finalize(Pipeline* pointer);
+
+// Builds a VkPipeline against an existing layout, throws std::runtime_error when a shader fails to build
+VkPipeline Compile(PipelineInfo info, VkPipelineLayout vk_pipeline_layout);
+VkPipeline Compile(ComputePipelineInfo info, VkPipelineLayout vk_pipeline_layout);
 } // namespace pipeline
 Pipeline* CreatePipeline(PipelineInfo info);
+Pipeline* CreateComputePipeline(ComputePipelineInfo info);
 void DestroyPipeline(Pipeline* pointer);
 
 } // namespace render
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <utility>
+
+namespace core {
+/* An index into a pool and the generation of the slot when the handle was made. A slot gets a new
+ * generation every time it is created in and destroyed, so a handle to a destroyed object never resolves,
+ * even once its slot has been reused. 0 is never a valid handle. */
+template <typename T> struct Handle {
+    uint32_t value = 0;
+
+    explicit operator bool() const { return value != 0; }
+    bool operator==(const Handle& other) const { return value == other.value; }
+    bool operator!=(const Handle& other) const { return value != other.value; }
+};
+namespace handle {
+const uint32_t INDEX_BITS = 16;
+const uint32_t GENERATION_BITS = 32 - INDEX_BITS;
+const uint32_t INDEX_MASK = (1u << INDEX_BITS) - 1;
+
+inline uint32_t Index(uint32_t value) {
+    return value & INDEX_MASK;
+}
+// Odd while the slot holds an object, even while it is free
+inline uint32_t Generation(uint32_t value) {
+    return value >> INDEX_BITS;
+}
+} // namespace handle
+
+/* Objects of one type in fixed size chunks of slots, created and destroyed in O(1) through a free list.
+ * Chunks never move, so pointers to live objects stay valid and handles resolve without a lock. Create
+ * and destroy lock the pool, a handle may be resolved from any thread. */
+template <typename T> struct Pool {
+    static const uint32_t CHUNK_SIZE = 256;
+    static const uint32_t MAX_CHUNK_COUNT = (1u << handle::INDEX_BITS) / CHUNK_SIZE;
+    static const uint32_t NO_SLOT = UINT32_MAX;
+
+    // The object comes first, so a pointer to it is a pointer to its slot
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        // The handle of the object in this slot, with an even generation while it is free
+        std::atomic<uint32_t> handle;
+        uint32_t next_free;
+    };
+
+    std::mutex mutex{};
+    std::atomic<Slot*> chunks[MAX_CHUNK_COUNT]{};
+    uint32_t slot_count = 0;
+    uint32_t free_slot = NO_SLOT;
+    uint32_t live_count = 0;
+};
+namespace pool {
+template <typename T> typename Pool<T>::Slot* GetSlot(Pool<T>* pool, uint32_t index) {
+    return &pool->chunks[index / Pool<T>::CHUNK_SIZE].load(std::memory_order_acquire)[index % Pool<T>::CHUNK_SIZE];
+}
+
+/* Constructs T from arguments in a free slot. Throws std::runtime_error once every index is in use, so no
+ * caller goes on with a null object. */
+template <typename T, typename... Arguments> T* Create(Pool<T>* pool, Arguments&&... arguments) {
+    using Slot = typename Pool<T>::Slot;
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    uint32_t index = pool->free_slot;
+    Slot* slot = nullptr;
+    if (index != Pool<T>::NO_SLOT) {
+        slot = GetSlot(pool, index);
+        pool->free_slot = slot->next_free;
+    } else {
+        index = pool->slot_count;
+        if (index == Pool<T>::MAX_CHUNK_COUNT * Pool<T>::CHUNK_SIZE) {
+            throw std::runtime_error("FAILED TO CREATE POOLED OBJECT, EVERY SLOT IS IN USE");
+        }
+        if (index % Pool<T>::CHUNK_SIZE == 0) {
+            Slot* chunk = new Slot[Pool<T>::CHUNK_SIZE];
+            for (uint32_t i = 0; i < Pool<T>::CHUNK_SIZE; i++) {
+                chunk[i].handle.store(index + i, std::memory_order_relaxed);
+            }
+            pool->chunks[index / Pool<T>::CHUNK_SIZE].store(chunk, std::memory_order_release);
+        }
+        pool->slot_count++;
+        slot = GetSlot(pool, index);
+    }
+    T* object = new (slot->storage) T{std::forward<Arguments>(arguments)...};
+    uint32_t generation = handle::Generation(slot->handle.load(std::memory_order_relaxed)) + 1;
+    slot->handle.store((generation << handle::INDEX_BITS) | index, std::memory_order_release);
+    pool->live_count++;
+    return object;
+}
+template <typename T> Handle<T> HandleOf(const T* object) {
+    auto slot = reinterpret_cast<const typename Pool<T>::Slot*>(object);
+    return {slot->handle.load(std::memory_order_acquire)};
+}
+// Whether object is live, for asserting that a raw pointer was not kept past the destruction of its object
+template <typename T> bool Alive(const T* object) {
+    return (handle::Generation(HandleOf(object).value) & 1) == 1;
+}
+// nullptr for a handle whose object was destroyed, or that never came from this pool
+template <typename T> T* Get(Pool<T>* pool, Handle<T> handle) {
+    uint32_t index = handle::Index(handle.value);
+    if ((handle::Generation(handle.value) & 1) == 0 || index / Pool<T>::CHUNK_SIZE >= Pool<T>::MAX_CHUNK_COUNT ||
+        pool->chunks[index / Pool<T>::CHUNK_SIZE].load(std::memory_order_acquire) == nullptr) {
+        return nullptr;
+    }
+    auto slot = GetSlot(pool, index);
+    if (slot->handle.load(std::memory_order_acquire) != handle.value) {
+        return nullptr;
+    }
+    return reinterpret_cast<T*>(slot->storage);
+}
+template <typename T> void Destroy(Pool<T>* pool, T* object) {
+    auto slot = reinterpret_cast<typename Pool<T>::Slot*>(object);
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    uint32_t value = slot->handle.load(std::memory_order_relaxed);
+    assert((handle::Generation(value) & 1) == 1 && "object destroyed twice");
+    object->~T();
+#ifndef NDEBUG
+    // A stale pointer then reads garbage instead of the old object, which a handle would have caught
+    memset(slot->storage, 0xdd, sizeof(T));
+#endif
+    slot->handle.store(value + (1u << handle::INDEX_BITS), std::memory_order_release);
+    slot->next_free = pool->free_slot;
+    pool->free_slot = handle::Index(value);
+    pool->live_count--;
+}
+// Destroys every live object and frees the chunks, handles made before must not be resolved after
+template <typename T> void Finalize(Pool<T>* pool) {
+    for (uint32_t index = 0; index < pool->slot_count; index++) {
+        auto slot = GetSlot(pool, index);
+        if (handle::Generation(slot->handle.load(std::memory_order_relaxed)) & 1) {
+            reinterpret_cast<T*>(slot->storage)->~T();
+        }
+    }
+    for (auto& chunk : pool->chunks) {
+        delete[] chunk.exchange(nullptr);
+    }
+    pool->slot_count = 0;
+    pool->free_slot = Pool<T>::NO_SLOT;
+    pool->live_count = 0;
+}
+// Calls function on every live object in slot order, which keeps neighbouring objects in the same chunk
+template <typename T, typename Function> void ForEach(Pool<T>* pool, Function function) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    for (uint32_t index = 0; index < pool->slot_count; index++) {
+        auto slot = GetSlot(pool, index);
+        if (handle::Generation(slot->handle.load(std::memory_order_relaxed)) & 1) {
+            function(reinterpret_cast<T*>(slot->storage));
+        }
+    }
+}
+} // namespace pool
+} // namespace core
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "render.h"
+
+namespace render {
+struct GpuProfilerInfo {
+    // Scopes a single frame may record, further scopes are dropped
+    uint32_t max_scope_count = 64;
+    // Frames the rolling averages are taken over
+    uint32_t history_frame_count = 64;
+};
+struct GpuScope {
+    const char* name;
+    uint32_t depth;
+    uint32_t begin_query;
+    uint32_t end_query;
+};
+/* Timestamps of one frame in flight. Scopes are written by the thread recording the frame, and read back
+ * once the frame comes round again, by which point its fence has been awaited. */
+struct GpuProfile {
+    VkQueryPool vk_query_pool = VK_NULL_HANDLE;
+    uint64_t frame = 0;
+    bool recorded = false;
+
+    uint32_t query_count = 0;
+    std::vector<GpuScope> scopes{};
+    std::vector<uint32_t> open_scopes{};
+    uint32_t dropped_scope_count = 0;
+};
+struct GpuPassTiming {
+    std::string name;
+    uint32_t depth;
+    double last_ms;
+    double average_ms;
+    double max_ms;
+};
+struct GpuPassHistory {
+    std::string name;
+    uint32_t depth = 0;
+    std::vector<double> samples{};
+    uint32_t next_sample = 0;
+    uint32_t sample_count = 0;
+    double sum = 0.0;
+    double last = 0.0;
+};
+struct GpuProfiler {
+    GpuProfilerInfo info;
+
+    // False when the universal queue cannot write timestamps, every marker is then a no-op
+    bool supported = false;
+    double timestamp_period_ns = 1.0;
+    uint64_t timestamp_mask = ~0ull;
+
+    GpuProfile profiles[MAX_FRAMES_IN_FLIGHT]{};
+    std::vector<uint64_t> results{};
+
+    std::mutex mutex{};
+    // In order of first appearance, which for a stable frame is recording order
+    std::vector<GpuPassHistory> passes{};
+    uint64_t resolved_frame_count = 0;
+    uint64_t unavailable_frame_count = 0;
+};
+GpuProfiler* CreateGpuProfiler(GpuProfilerInfo info);
+void DestroyGpuProfiler(GpuProfiler* profiler);
+namespace gpu_profiler {
+/* Call once per frame after render::BeginFrame. Resolves the timestamps the returned profile held
+ * frames_in_flight frames ago without waiting, results that are not yet available are discarded. */
+GpuProfile* BeginFrame(GpuProfiler* profiler);
+std::vector<GpuPassTiming> GetTimings(GpuProfiler* profiler);
+} // namespace gpu_profiler
+
+namespace command {
+// Must be recorded before any scope and outside a renderpass, it resets the queries of the profile
+void BeginGpuProfile(CommandBuffer* command_buffer, GpuProfiler* profiler, GpuProfile* profile);
+void BeginGpuScope(CommandBuffer* command_buffer, GpuProfiler* profiler, GpuProfile* profile, const char* name);
+void EndGpuScope(CommandBuffer* command_buffer, GpuProfiler* profiler, GpuProfile* profile);
+
+// Begins a scope on construction and ends it on destruction, name must outlive the frame
+struct ScopedGpuScope {
+    CommandBuffer* command_buffer;
+    GpuProfiler* profiler;
+    GpuProfile* profile;
+
+    ScopedGpuScope(CommandBuffer* command_buffer, GpuProfiler* profiler, GpuProfile* profile, const char* name);
+    ~ScopedGpuScope();
+};
+} // namespace command
+} // namespace render
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "pipeline.h"
+#include "threadpool.h"
+#include "watcher.h"
+
+namespace render {
+struct PipelineReloaderInfo {
+    // Recompiles run here, the pool is awaited idle when the reloader is destroyed
+    core::ThreadPool* worker_pool = nullptr;
+    uint32_t poll_interval_ms = 250;
+};
+// A watched shader file and the pipelines built from it
+struct ReloadSource {
+    ShaderStage shader_stage;
+    // GLSL is compiled to spirv_filepath once per change, then its dependents are rebuilt from that SPIR-V
+    ShaderFormat shader_code_format;
+    std::string spirv_filepath;
+    std::set<Pipeline*> dependents{};
+};
+/* Recompiles pipelines whose shader sources change on disk and swaps them in at a frame boundary.
+ * Replaced VkPipelines are handed to render::Retire, so a reload never waits on the device. */
+struct PipelineReloader {
+    core::ThreadPool* worker_pool;
+    core::FileWatcher* watcher;
+
+    std::mutex mutex{};
+    // Watched host path to the source
+    std::unordered_map<std::string, ReloadSource> sources{};
+    // The watched host path of every shader of a pipeline in shader order, empty for one not watched
+    std::unordered_map<Pipeline*, std::vector<std::string>> pipeline_sources{};
+    std::set<Pipeline*> compiling{};
+    // Changed while a dependent was compiling, taken up once it lands
+    std::set<std::string> stale{};
+    std::vector<std::pair<Pipeline*, VkPipeline>> compiled{};
+};
+PipelineReloader* CreatePipelineReloader(PipelineReloaderInfo info);
+void DestroyPipelineReloader(PipelineReloader* reloader);
+namespace pipeline_reloader {
+// Only shaders served from a directory mount or the host filesystem can be watched
+void Register(PipelineReloader* reloader, Pipeline* pipeline);
+/* Watches sources in place of the shaders the pipeline was created from, sources[i] standing for shader i,
+ * like the GLSL a build step compiled the pipeline's SPIR-V from. A changed GLSL source is compiled over
+ * that SPIR-V before the pipeline is rebuilt. */
+void Register(PipelineReloader* reloader, Pipeline* pipeline, const std::vector<ShaderInfo>& sources);
+void Unregister(PipelineReloader* reloader, Pipeline* pipeline);
+
+// Call at a frame boundary, after render::BeginFrame
+void Update(PipelineReloader* reloader);
+} // namespace pipeline_reloader
+} // namespace render
@@ -1,21 +1,27 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <deque>
 #include <functional>
 #include <limits>
 #include <optional>
 
+#include "arena.h"
+#include "pool.h"
 #include "window.h"
 
 #include "vk_mem_alloc.h"
 #include "vulkan/vulkan.h"
 
+#include <spdlog/async.h>
 #include <spdlog/sinks/stdout_sinks.h>
 #include <spdlog/spdlog.h>
 
 #include "pipeline.h"
+#include "trace.h"
 
 #define RENDER_LOGGER_DECLARATION                                                                                      \
     namespace render {                                                                                                 \
@@ -26,25 +32,96 @@
     std::shared_ptr<spdlog::logger> logger;                                                                            \
     };
 
+#ifndef RENDER_ACTIVE_LOG_LEVEL
+// Calls below this level compile to nothing, set through the RENDER_LOG_LEVEL cache variable
+#define RENDER_ACTIVE_LOG_LEVEL SPDLOG_LEVEL_INFO
+#endif
+#ifndef RENDER_LOG_QUEUE_SIZE
+#define RENDER_LOG_QUEUE_SIZE 8192
+#endif
+
+/* The render logger is asynchronous, a call formats into a fixed size message and queues it for the spdlog
+ * thread, so no console I/O happens on the calling thread. A full queue overwrites its oldest message
+ * rather than blocking the caller. */
 #define RENDER_LOG_INITIALIZE                                                                                          \
-    render::logger = spdlog::stdout_logger_mt("render");                                                               \
+    if (spdlog::thread_pool() == nullptr) {                                                                            \
+        spdlog::init_thread_pool(RENDER_LOG_QUEUE_SIZE, 1, []() { CORE_TRACE_THREAD_NAME("log"); });                   \
+    }                                                                                                                  \
+    render::logger = spdlog::create_async_nb<spdlog::sinks::stdout_sink_mt>("render");                                 \
     render::logger->info("RENDER LOG INITIALIZED!");
-#define RENDER_LOG_FINALIZE render::logger->info("RENDER LOG FINALIZED!");
-
+#define RENDER_LOG_FINALIZE                                                                                            \
+    render::logger->info("RENDER LOG FINALIZED!");                                                                     \
+    render::logger->flush();
+
+#if RENDER_ACTIVE_LOG_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define RENDER_LOG_DEBUG(...) render::logger->debug(__VA_ARGS__)
+#else
+#define RENDER_LOG_DEBUG(...) (void)0
+#endif
+#if RENDER_ACTIVE_LOG_LEVEL <= SPDLOG_LEVEL_INFO
 #define RENDER_LOG_INFO(...) render::logger->info(__VA_ARGS__)
+#else
+#define RENDER_LOG_INFO(...) (void)0
+#endif
+#if RENDER_ACTIVE_LOG_LEVEL <= SPDLOG_LEVEL_WARN
+#define RENDER_LOG_WARN(...) render::logger->warn(__VA_ARGS__)
+#else
+#define RENDER_LOG_WARN(...) (void)0
+#endif
+#if RENDER_ACTIVE_LOG_LEVEL <= SPDLOG_LEVEL_ERROR
 #define RENDER_LOG_ERROR(...) render::logger->error(__VA_ARGS__)
+#else
+#define RENDER_LOG_ERROR(...) (void)0
+#endif
+
+// Logs at most once per interval from the call site, e.g. RENDER_LOG_RATE_LIMITED(ERROR, 1000, "...")
+#define RENDER_LOG_RATE_LIMITED(level, interval_ms, ...)                                                               \
+    do {                                                                                                               \
+        static render::LogRateLimit render_log_rate_limit{};                                                           \
+        uint32_t render_log_suppressed_count = 0;                                                                      \
+        if (render::LogAllowed(&render_log_rate_limit, interval_ms, &render_log_suppressed_count)) {                   \
+            RENDER_LOG_##level(__VA_ARGS__);                                                                           \
+            if (render_log_suppressed_count > 0) {                                                                     \
+                RENDER_LOG_##level("{} Similar Messages Suppressed", render_log_suppressed_count);                     \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
 
 RENDER_LOGGER_DECLARATION
+namespace render {
+struct LogRateLimit {
+    std::atomic<int64_t> next_allowed_ns{0};
+    std::atomic<uint32_t> suppressed_count{0};
+};
+// True when the call site may log again, suppressed_count receives the messages dropped in between
+inline bool LogAllowed(LogRateLimit* limit, int64_t interval_ms, uint32_t* suppressed_count) {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count();
+    int64_t next_allowed = limit->next_allowed_ns.load(std::memory_order_relaxed);
+    if (now < next_allowed ||
+        !limit->next_allowed_ns.compare_exchange_strong(next_allowed, now + interval_ms * 1000000)) {
+        limit->suppressed_count.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    *suppressed_count = limit->suppressed_count.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+} // namespace render
 
 #ifndef MAX_FRAMES_IN_FLIGHT
-#define MAX_FRAMES_IN_FLIGHT 2
+// Upper bound of render::frames_in_flight, per frame arrays are sized by it
+#define MAX_FRAMES_IN_FLIGHT 4
+#endif
+#ifndef DEFAULT_FRAMES_IN_FLIGHT
+#define DEFAULT_FRAMES_IN_FLIGHT 2
 #endif
 
 #ifndef RENDER_FIF_ARRAY
 #define RENDER_FIF_ARRAY(type, name) type name[MAX_FRAMES_IN_FLIGHT]
 #endif
 #ifndef RENDER_FIF_CURRENT
-#define RENDER_FIF_CURRENT(fif_array) fif_array[render::frame];
+#define RENDER_FIF_CURRENT(fif_array) fif_array[render::frame % render::frames_in_flight];
 #endif
 
 namespace render {
@@ -62,6 +139,12 @@ struct ContextInfo {
     bool enable_validation_layers;
     const char* applcation_name;
     const char* engine_name;
+    /* Physical device to use over the highest rated one, an index into the enumeration order or part of the
+     * device name. The ENGINE_DEVICE environment variable takes precedence. */
+    const char* device_preference = nullptr;
+    /* Pipeline cache file, read while the instance and device are created and written back by DestroyContext.
+     * Pipelines are compiled without a cache file when this is nullptr. */
+    const char* pipeline_cache_filepath = nullptr;
 
     void* p_api_context_info;
 };
@@ -76,12 +159,19 @@ struct Context {
 
     VkPhysicalDevice vk_physical_device;
     VkDevice vk_device;
+    // Optional features are enabled wherever the device supports them
+    VkPhysicalDeviceFeatures vk_enabled_features;
+    VkPhysicalDeviceVulkan12Features vk_enabled_vulkan12_features;
     DeviceQueue universal_queue;
     DeviceQueue compute_queue;
     DeviceQueue staging_queue;
     DeviceQueue present_queue;
 
     VmaAllocator vma_allocator;
+
+    // Every pipeline is created through it, VK_NULL_HANDLE if creation failed
+    VkPipelineCache vk_pipeline_cache;
+    std::string pipeline_cache_filepath;
 };
 extern render::Context context;
 Context CreateContext(ContextInfo info);
@@ -90,11 +180,31 @@ void DestroyContext(Context context);
 struct CommandBuffer {
     bool completion_flag = false;
     VkCommandBuffer vk_command_buffer = VK_NULL_HANDLE;
+#ifdef ENGINE_ENABLE_TRACING
+    // Links the recording of the command buffer to its submission and present in a trace
+    uint64_t trace_flow_id = 0;
+#endif
+};
+/* The command buffers one thread allocated for one frame slot, from a VkCommandPool of their own that is
+ * reset as a whole once the frame has completed. */
+struct FrameCommandAllocator {
+    std::thread::id thread_id{};
+    VkCommandPool vk_command_pool = VK_NULL_HANDLE;
+    std::vector<CommandBuffer*> command_buffers{};
+    // Command buffers handed out since the last reset, the rest are ready for reuse
+    uint32_t used_count = 0;
 };
 struct CommandPool {
     VkCommandPool vk_command_pool = VK_NULL_HANDLE;
-    std::deque<CommandBuffer*> free_command_buffer_queue{};
+    // Every command buffer of the pool, borrowed or allocated for a frame
+    core::Pool<CommandBuffer> command_buffers{};
+    std::mutex free_command_buffer_mutex{};
+    std::vector<CommandBuffer*> free_command_buffers{};
+
+    std::mutex frame_allocator_mutex{};
+    std::vector<FrameCommandAllocator> frame_allocators[MAX_FRAMES_IN_FLIGHT]{};
 
+    // Guarded by mutex, the record thread drains record_queue before it exits
     bool active = true;
     std::thread record_thread{};
     std::mutex mutex{};
@@ -102,20 +212,41 @@ struct CommandPool {
 
     std::mutex completion_mutex{};
     std::condition_variable completion_condition_variable{};
-    std::deque<std::function<void()>> record_queue{};
+    // Drained from record_queue_head and cleared once empty, so a steady frame loop reuses its capacity
+    std::vector<std::function<void()>> record_queue{};
+    size_t record_queue_head = 0;
 };
 CommandPool* CreateCommandPool();
 void DestroyCommandPool(CommandPool* pool);
 namespace command_pool {
+/* A command buffer that lives until returned, and is reset by hand before it is recorded again. Prefer
+ * AllocateFrameCommandBuffer for work submitted once per frame. */
 CommandBuffer* BorrowCommandBuffer(CommandPool* pool);
 void ReturnCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer);
 void ResetCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer);
 
+/* A reset command buffer for the current frame, recycled by the BeginFrame that reuses the frame slot.
+ * Safe from any thread, every thread allocates from VkCommandPools of its own, so buffers one thread
+ * allocated must not be recorded at the same time as each other. Submit it within the frame and never
+ * reset it by hand. */
+CommandBuffer* AllocateFrameCommandBuffer(CommandPool* pool);
+// Call after render::BeginFrame, resets the VkCommandPools of the frame slot, whose fence was awaited
+void BeginFrame(CommandPool* pool);
+
+/* Runs function on the record thread of pool. The command buffer crosses over as a handle and is resolved
+ * there first, a closure whose command buffer was destroyed in the meantime is skipped with an error. */
 void RecordAsync(CommandPool* pool, CommandBuffer* command_buffer, std::function<void()> function);
+/* Keeps the closure in the frame arena rather than on the heap, which a std::function does with anything
+ * larger than a few pointers. Only from the thread that calls render::BeginFrame. */
+template <typename Function> void RecordAsync(CommandPool* pool, CommandBuffer* command_buffer, Function function);
+// Queues function as it is, the RecordAsync overloads wrap it in the command buffer check
+void QueueRecord(CommandPool* pool, CommandBuffer* command_buffer, std::function<void()> function);
 void AwaitRecord(CommandPool* pool, CommandBuffer* command_buffer);
 
 void RecordThreadFunction(CommandPool* pool);
 } // namespace command_pool
+// Blocks until every closure queued through RecordAsync so far, on any pool, has finished recording
+void AwaitRecording();
 
 struct Semaphore {
     VkSemaphore vk_semaphore;
@@ -145,16 +276,34 @@ void Reset(Fence* fence);
 Fence* CreateFence(fence::FenceInitializationState init_state);
 void DestroyFence(Fence* fence);
 
+/* Requested presentation, the closest supported mode is used. FIFO waits for vblank and never tears,
+ * FIFO_RELAXED tears only when a frame misses its vblank, MAILBOX replaces queued images for the lowest
+ * tear free latency and IMMEDIATE presents at once and tears. */
+enum PresentMode {
+    PRESENT_MODE_FIFO,
+    PRESENT_MODE_FIFO_RELAXED,
+    PRESENT_MODE_MAILBOX,
+    PRESENT_MODE_IMMEDIATE,
+};
 struct Swapchain {
     core::Window window;
+    PresentMode present_mode = PRESENT_MODE_MAILBOX;
 
     std::mutex usage_mutex{};
+    // Of the last vkQueuePresentKHR naming the swapchain, written on the submission thread
+    std::atomic<VkResult> present_result{VK_SUCCESS};
+    // Set when a present or an acquire reports VK_ERROR_OUT_OF_DATE_KHR, taken by swapchain::TakeOutOfDate
+    std::atomic<bool> out_of_date{false};
     Extent3D extent;
     VkSurfaceKHR vk_surface;
     VkSurfaceFormatKHR vk_surface_format;
     VkSwapchainKHR vk_swapchain;
+    // The mode present_mode resolved to on the surface
+    VkPresentModeKHR vk_present_mode;
     std::vector<VkImage> vk_images;
     std::vector<VkImageView> vk_image_views;
+    // VK_IMAGE_USAGE_TRANSFER_SRC_BIT only where the surface supports it, without it the images cannot be captured
+    VkImageUsageFlags vk_image_usage = 0;
 
     std::vector<std::function<void()>> recreation_functions{};
 };
@@ -162,12 +311,19 @@ namespace swapchain {
 void Initialize(Swapchain* swapchain);
 void Finalize(Swapchain* swapchain);
 
+// Idles the device, so only on the frame thread while no other thread acquires from the swapchain
 void Recreate(Swapchain* swapchain);
-void AcquireImage(Swapchain* swapchain, uint32_t* image_index, Semaphore semaphore, Fence* fence);
+// Whether a present or an acquire found the swapchain out of date since the last call, which then recreates it
+bool TakeOutOfDate(Swapchain* swapchain);
+/* Never recreates the swapchain, so it may run on any thread. Returns false when no image was acquired, in
+ * which case neither semaphore nor fence will be signaled and the swapchain is not presented this frame. */
+bool AcquireImage(Swapchain* swapchain, uint32_t* image_index, Semaphore semaphore, Fence* fence);
 
 void BindRecreationFunction(Swapchain* swapchain, std::function<void()> function);
+// Recreates the swapchain when the mode differs from the current one
+void SetPresentMode(Swapchain* swapchain, PresentMode present_mode);
 } // namespace swapchain
-Swapchain* CreateSwapchain(core::Window window);
+Swapchain* CreateSwapchain(core::Window window, PresentMode present_mode = PRESENT_MODE_MAILBOX);
 void DestroySwapchain(Swapchain* swapchain);
 
 enum class LoadOp {
@@ -219,70 +375,160 @@ struct Renderpass {
     VkRenderPass vk_render_pass;
 };
 namespace renderpass {
-void Initialize(Renderpass* renderpass, RenderpassInfo info);
+void Initialize(Renderpass* renderpass, const RenderpassInfo& info);
 void Finalize(Renderpass* renderpass);
 
-void Recreate(Renderpass* renderpass, RenderpassInfo info);
+void Recreate(Renderpass* renderpass, const RenderpassInfo& info);
 } // namespace renderpass
 Renderpass* CreateRenderpass(RenderpassInfo info);
 void DestroyRenderpass(Renderpass* renderpass);
 
+struct OffscreenTarget;
 struct FramebufferInfo {
     Renderpass* renderpass = nullptr;
     std::vector<VkImageView> attachments{};
     Extent3D extent{};
+    // A framebuffer per image is created for either, with the image bound after the other attachments
     Swapchain* swapchain = nullptr;
+    OffscreenTarget* offscreen_target = nullptr;
 };
 struct Framebuffer {
     std::optional<FramebufferInfo> recreation_info{};
     std::vector<VkFramebuffer> vk_framebuffer{};
 };
 namespace framebuffer {
-void Initialize(Framebuffer* framebuffer, FramebufferInfo info);
+void Initialize(Framebuffer* framebuffer, const FramebufferInfo& info);
 void Finalize(Framebuffer* framebuffer);
 
-void Recreate(Framebuffer* framebuffer, FramebufferInfo info);
+void Recreate(Framebuffer* framebuffer, const FramebufferInfo& info);
 } // namespace framebuffer
 Framebuffer* CreateFramebuffer(FramebufferInfo info);
 void DestroyFramebuffer(Framebuffer* framebuffer);
 
+/* The create functions above construct into pools of their type, and throw std::runtime_error past the 65536
+ * live objects a pool holds. core::pool::HandleOf gives the handle of any object they returned. A handle
+ * resolves to nullptr once its object is destroyed, so it can be handed to another thread, or kept across
+ * frames, where a pointer might outlive the object. */
+using CommandPoolHandle = core::Handle<CommandPool>;
+using CommandBufferHandle = core::Handle<CommandBuffer>;
+using FenceHandle = core::Handle<Fence>;
+using SwapchainHandle = core::Handle<Swapchain>;
+using RenderpassHandle = core::Handle<Renderpass>;
+using FramebufferHandle = core::Handle<Framebuffer>;
+using PipelineHandle = core::Handle<Pipeline>;
+CommandPool* Resolve(CommandPoolHandle handle);
+// Command buffers are pooled per command pool
+CommandBuffer* Resolve(CommandPool* pool, CommandBufferHandle handle);
+Fence* Resolve(FenceHandle handle);
+Swapchain* Resolve(SwapchainHandle handle);
+Renderpass* Resolve(RenderpassHandle handle);
+Framebuffer* Resolve(FramebufferHandle handle);
+Pipeline* Resolve(PipelineHandle handle);
+
 namespace command {
 void BeginCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer);
 void EndCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer);
 
+// Binds at the bind point of the pipeline, graphics or compute
 void BindPipeline(CommandBuffer* command_buffer, Pipeline* pipeline);
+// vkCmdDraw, counted in render::stats
+void Draw(CommandBuffer* command_buffer, uint32_t vertex_count, uint32_t instance_count = 1, uint32_t first_vertex = 0,
+          uint32_t first_instance = 0);
+// vkCmdDrawIndexed, counted in render::stats
+void DrawIndexed(CommandBuffer* command_buffer, uint32_t index_count, uint32_t instance_count = 1,
+                 uint32_t first_index = 0, int32_t vertex_offset = 0, uint32_t first_instance = 0);
 } // namespace command
 
 extern std::mutex submission_queue_mutex;
-extern std::deque<std::function<void()>> submission_function_queue;
+extern std::vector<std::function<void()>> submission_function_queue;
+extern size_t submission_function_queue_head;
 
 extern std::mutex submission_mutex;
 extern std::condition_variable submission_condition;
 
+/* The submit and present calls copy their info into the frame arena, the vectors may live anywhere.
+ * Filling them from render::FrameArena keeps a frame free of heap allocations. Command buffers, command
+ * pools, fences and swapchains cross over to the submission thread as handles and are resolved there, one
+ * destroyed in the meantime is left out with an error instead of being used. */
 struct SubmitInfo {
-    std::vector<Semaphore> wait_semaphores;
+    core::ArenaVector<Semaphore> wait_semaphores;
     VkPipelineStageFlags wait_stage_flags;
-    std::vector<Semaphore> signal_semaphores;
+    core::ArenaVector<Semaphore> signal_semaphores;
     Fence* fence;
     CommandPool* command_pool;
     CommandBuffer* command_buffer;
+    // Runs on the submission thread once vkQueueSubmit has returned
+    std::function<void()> submitted{};
 };
+/* One vkQueuePresentKHR for every swapchain, with an image index each. Windows acquire, record and submit
+ * independently, the present waits on all their semaphores, and each swapchain gets its own result in
+ * Swapchain::present_result. A swapchain may appear only once. */
 struct PresentInfo {
-    std::vector<Semaphore> wait_semaphores;
-    std::vector<Swapchain*> swapchains;
-    std::vector<uint32_t> image_indices;
-    Fence* fence;
+    core::ArenaVector<Semaphore> wait_semaphores;
+    core::ArenaVector<Swapchain*> swapchains;
+    core::ArenaVector<uint32_t> image_indices;
+    // Submitted along with the present, like the acquisition fence of every swapchain
+    core::ArenaVector<Fence*> fences;
+    // Runs on the submission thread once vkQueuePresentKHR has returned
+    std::function<void()> presented{};
 };
 
 void SubmissionThread();
-void SubmitUniversalAsync(SubmitInfo submit_info);
-void SubmitCompute(SubmitInfo submit_info);
-void SubmitStaging(SubmitInfo submit_info);
+void SubmitUniversalAsync(const SubmitInfo& submit_info);
+/* Submits to the compute queue on the submission thread, like SubmitUniversalAsync. The compute queue is the
+ * universal queue until a dedicated compute family is created, semaphores order it against other queues. */
+void SubmitCompute(const SubmitInfo& submit_info);
+void SubmitStaging(const SubmitInfo& submit_info);
 
-void SubmitPresentAsync(PresentInfo present_info);
+void SubmitPresentAsync(const PresentInfo& present_info);
 
 void AwaitIdle();
 
+// Counts frames begun through BeginFrame
+extern uint64_t frame;
+// Frames recorded ahead of the GPU, from 1 to MAX_FRAMES_IN_FLIGHT. Fewer lowers latency, more keeps the GPU busy
+extern uint32_t frames_in_flight;
+// Clamps count to the supported range, only valid while no frame is in flight
+void SetFramesInFlight(uint32_t count);
+// Call once per frame, after awaiting the fence of the frame slot that is about to be reused
+void BeginFrame();
+/* Bump arena of the current frame slot, reset by the BeginFrame that reuses the slot. For data that lives
+ * no longer than the frame, allocated on the thread that calls BeginFrame. */
+core::Arena* FrameArena();
+/* Holds off the reset of the current frame arena until released, for work queued on another thread that
+ * may still touch the arena after the fence of its frame was awaited. Returns the slot to release. */
+uint32_t PinFrameArena();
+void ReleaseFrameArena(uint32_t slot);
+// Defers destruction until every frame in flight at the time of the call has completed on the GPU
+void Retire(std::function<void()> destruction);
+// Runs all pending destructions, only valid once the device is idle
+void FlushRetired();
+
 void InitializeSubmission();
 void FinalizeSubmission();
+
+namespace command_pool {
+template <typename Function> void RecordAsync(CommandPool* pool, CommandBuffer* command_buffer, Function function) {
+    struct Record {
+        Function function;
+        CommandPool* pool;
+        CommandBufferHandle command_buffer;
+        uint32_t frame_slot;
+    };
+    Record* record = core::arena::New<Record>(
+        FrameArena(), Record{std::move(function), pool, core::pool::HandleOf(command_buffer), PinFrameArena()});
+    // A single pointer fits in the std::function itself
+    QueueRecord(pool, command_buffer, std::function<void()>([record]() {
+                    uint32_t frame_slot = record->frame_slot;
+                    if (Resolve(record->pool, record->command_buffer) != nullptr) {
+                        record->function();
+                    } else {
+                        RENDER_LOG_RATE_LIMITED(ERROR, 1000,
+                                                "COMMAND RECORDING: Command Buffer Destroyed Before Recording!");
+                    }
+                    record->~Record();
+                    ReleaseFrameArena(frame_slot);
+                }));
+}
+} // namespace command_pool
 } // namespace render
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "vk_mem_alloc.h"
+#include "vulkan/vulkan.h"
+
+namespace render {
+struct ResidentAssetInfo {
+    // Bytes of GPU memory per mip/LOD level, level 0 is the coarsest and is never evicted
+    std::vector<VkDeviceSize> level_sizes{};
+    // Memory heap the asset allocates from, UINT32_MAX selects the largest device local heap
+    uint32_t heap_index = UINT32_MAX;
+
+    // Starts loading a level, the asset reports back through residency::CompleteStreamIn
+    std::function<bool(uint32_t level)> stream_in{};
+    // Frees the GPU memory of a level, only ever called for the highest resident level.
+    // Frames in flight may still sample the level, so destruction should be deferred until they retire.
+    std::function<void(uint32_t level)> evict{};
+};
+struct ResidentAsset {
+    ResidentAssetInfo info;
+
+    uint32_t resident_level_count = 0;
+    uint32_t requested_level_count = 0;
+    bool streaming = false;
+    // Unregistered while streaming, the asset is freed once CompleteStreamIn reports the level back
+    bool unregistered = false;
+
+    float priority = 0.0f;
+    uint64_t last_used_frame = 0;
+    VkDeviceSize resident_bytes = 0;
+};
+
+struct ResidencyInfo {
+    // Fraction of the VMA reported budget the manager streams up to
+    float budget_fraction = 0.9f;
+    // Once usage crosses budget_fraction, levels are evicted until usage drops below this fraction
+    float eviction_fraction = 0.8f;
+    // Caps the budget of every heap at a fixed envelope, 0 uses the VMA budget alone
+    VkDeviceSize budget_limit = 0;
+    // Bytes the manager may start streaming in a single frame
+    VkDeviceSize stream_bytes_per_frame = 64ull * 1024 * 1024;
+};
+struct ResidencyStatistics {
+    VkDeviceSize budget;
+    VkDeviceSize usage;
+    VkDeviceSize resident_bytes;
+    VkDeviceSize streaming_bytes;
+    uint32_t resident_asset_count;
+    uint32_t streamed_level_count;
+    uint32_t evicted_level_count;
+};
+struct ResidencyManager {
+    ResidencyInfo info;
+
+    std::mutex mutex{};
+    std::vector<ResidentAsset*> assets{};
+    // Unregistered assets with a stream-in outstanding
+    std::vector<ResidentAsset*> unregistered_assets{};
+    uint64_t frame = 0;
+    uint32_t device_local_heap = 0;
+
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS]{};
+    VkDeviceSize streaming_bytes[VK_MAX_MEMORY_HEAPS]{};
+    ResidencyStatistics statistics{};
+};
+ResidencyManager* CreateResidencyManager(ResidencyInfo info);
+void DestroyResidencyManager(ResidencyManager* manager);
+namespace residency {
+ResidentAsset* Register(ResidencyManager* manager, ResidentAssetInfo info);
+/* Evicts every level and frees the asset. With a stream-in outstanding, the loader must still report it
+ * through CompleteStreamIn, which then evicts and frees instead, so the asset is not touched afterwards. */
+void Unregister(ResidencyManager* manager, ResidentAsset* asset);
+
+// Marks an asset as used this frame, the levels it wants are streamed in by priority as the budget allows
+void Touch(ResidencyManager* manager, ResidentAsset* asset, float priority, uint32_t requested_level_count);
+void CompleteStreamIn(ResidencyManager* manager, ResidentAsset* asset, uint32_t level, bool success);
+
+// Once per frame, reads vmaGetHeapBudgets, evicts least recently used levels and starts new stream-ins
+void Update(ResidencyManager* manager);
+ResidencyStatistics GetStatistics(ResidencyManager* manager);
+} // namespace residency
+} // namespace render
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "vk_mem_alloc.h"
+#include "vulkan/vulkan.h"
+
+#include "pool.h"
+#include "window.h"
+
+namespace render {
+struct DefragmentationMove;
+
+/* The first member of Buffer and Image. Their allocations carry a pointer to it as user data, which is how
+ * a Defragmenter tells what an allocation it moves belongs to. */
+enum ResourceType : uint32_t {
+    RESOURCE_TYPE_BUFFER,
+    RESOURCE_TYPE_IMAGE,
+};
+
+struct BufferInfo {
+    VkDeviceSize size;
+    VkBufferUsageFlags usage;
+    VmaMemoryUsage memory_usage = VMA_MEMORY_USAGE_AUTO;
+    // VMA_ALLOCATION_CREATE_MAPPED_BIT keeps a host visible buffer persistently mapped
+    VmaAllocationCreateFlags allocation_flags = 0;
+    /* Lets a Defragmenter move the buffer to another VkBuffer between frames, see defrag.h. Mapped buffers
+     * never move. Only set it for a buffer whose VkBuffer is kept nowhere else, a descriptor set or anything
+     * else holding it would be left on the old one. */
+    bool defragmentable = false;
+};
+struct Buffer {
+    ResourceType resource_type = RESOURCE_TYPE_BUFFER;
+    VkBuffer vk_buffer = VK_NULL_HANDLE;
+    VmaAllocation vma_allocation = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void* mapping = nullptr;
+
+    VkBufferUsageFlags usage = 0;
+    bool defragmentable = false;
+    // The move of the defragmentation pass in progress the buffer is part of, if any
+    DefragmentationMove* defragmentation_move = nullptr;
+};
+namespace buffer {
+void Initialize(Buffer* buffer, BufferInfo info);
+void Finalize(Buffer* buffer);
+
+// Makes device writes visible to the mapping, required for memory that is not host coherent
+void Invalidate(Buffer* buffer);
+void Flush(Buffer* buffer);
+} // namespace buffer
+Buffer* CreateBuffer(BufferInfo info);
+void DestroyBuffer(Buffer* buffer);
+
+struct ImageInfo {
+    Extent3D extent;
+    VkFormat format;
+    VkImageUsageFlags usage;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    VmaMemoryUsage memory_usage = VMA_MEMORY_USAGE_AUTO;
+    /* Lets a Defragmenter move the image to another VkImage and VkImageView between frames. Only set it for
+     * an image kept in no framebuffer or descriptor set, whose Image::layout is tracked by whoever uses it. */
+    bool defragmentable = false;
+};
+struct Image {
+    ResourceType resource_type = RESOURCE_TYPE_IMAGE;
+    VkImage vk_image = VK_NULL_HANDLE;
+    VkImageView vk_image_view = VK_NULL_HANDLE;
+    VmaAllocation vma_allocation = VK_NULL_HANDLE;
+    Extent3D extent;
+    VkFormat format;
+    VkImageUsageFlags usage = 0;
+    VkImageAspectFlags aspect = 0;
+    /* The layout the image is left in between frames, kept by whoever transitions it. A move copies the
+     * contents of an image only when this is not VK_IMAGE_LAYOUT_UNDEFINED. */
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    bool defragmentable = false;
+    DefragmentationMove* defragmentation_move = nullptr;
+};
+namespace image {
+void Initialize(Image* image, ImageInfo info);
+void Finalize(Image* image);
+
+// How the VkImage and VkImageView of image are created, for rebuilding them over the memory of a move
+VkImageCreateInfo VkCreateInfo(const Image* image);
+VkImageView CreateVkImageView(const Image* image, VkImage vk_image);
+} // namespace image
+Image* CreateImage(ImageInfo info);
+void DestroyImage(Image* image);
+
+// Like the objects of render.h, CreateBuffer and CreateImage construct into pools
+using BufferHandle = core::Handle<Buffer>;
+using ImageHandle = core::Handle<Image>;
+Buffer* Resolve(BufferHandle handle);
+Image* Resolve(ImageHandle handle);
+
+struct CommandBuffer;
+namespace command {
+// vkCmdCopyBuffer, a copy out of a host mapped buffer is counted as an upload in render::stats
+void CopyBuffer(CommandBuffer* command_buffer, Buffer* source, Buffer* destination, VkDeviceSize size,
+                VkDeviceSize source_offset = 0, VkDeviceSize destination_offset = 0);
+void BindIndexBuffer(CommandBuffer* command_buffer, Buffer* buffer, VkIndexType index_type = VK_INDEX_TYPE_UINT32,
+                     VkDeviceSize offset = 0);
+void BindVertexBuffer(CommandBuffer* command_buffer, uint32_t binding, Buffer* buffer, VkDeviceSize offset = 0);
+} // namespace command
+} // namespace render
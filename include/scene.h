@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "math3d.h"
+#include "threadpool.h"
+
+namespace core {
+struct Transform {
+    Vec3 position{};
+    Quat rotation{};
+    Vec3 scale{1.0f, 1.0f, 1.0f};
+};
+
+const uint32_t NO_PARENT = UINT32_MAX;
+struct TransformHierarchyInfo {
+    // Nodes reserved up front
+    uint32_t node_capacity = 1024;
+    // Levels with more than nodes_per_job nodes are split across the thread pool, null updates on the caller
+    ThreadPool* thread_pool = nullptr;
+    uint32_t nodes_per_job = 4096;
+};
+/* Local transforms and world matrices in separate arrays indexed by node, plus the nodes of every depth.
+ * A level only reads the world matrices of the level above it, so Update walks the levels in order and
+ * splits each one across the thread pool without locks. */
+struct TransformHierarchy {
+    TransformHierarchyInfo info;
+
+    std::vector<uint32_t> parents{};
+    std::vector<Vec3> positions{};
+    std::vector<Quat> rotations{};
+    std::vector<Vec3> scales{};
+    std::vector<Mat4> world_matrices{};
+
+    // Nodes by depth in the order they were added, which keeps every level ascending in memory
+    std::vector<std::vector<uint32_t>> levels{};
+    std::vector<uint32_t> depths{};
+};
+TransformHierarchy* CreateTransformHierarchy(TransformHierarchyInfo info);
+void DestroyTransformHierarchy(TransformHierarchy* hierarchy);
+namespace transform_hierarchy {
+// A parent must be added before its children, returns the node
+uint32_t AddNode(TransformHierarchy* hierarchy, uint32_t parent = NO_PARENT, const Transform& local = {});
+void SetLocal(TransformHierarchy* hierarchy, uint32_t node, const Transform& local);
+void Clear(TransformHierarchy* hierarchy);
+
+// Recomputes every world matrix from the local transforms, parents before children
+void Update(TransformHierarchy* hierarchy);
+inline const Mat4& World(const TransformHierarchy* hierarchy, uint32_t node) {
+    return hierarchy->world_matrices[node];
+}
+} // namespace transform_hierarchy
+} // namespace core
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "render.h"
+
+namespace render {
+// Engine-wide counters, incremented wherever the work is issued, from any thread
+enum StatCounter {
+    STAT_DRAW_CALLS,
+    STAT_DRAWN_VERTICES,
+    // Direct and indirect compute dispatches
+    STAT_DISPATCHES,
+    STAT_PIPELINE_BINDS,
+    STAT_QUEUE_SUBMITS,
+    STAT_COMMAND_BUFFERS_RECORDED,
+    STAT_BUFFER_ALLOCATIONS,
+    STAT_IMAGE_ALLOCATIONS,
+    // Bytes copied out of host mapped buffers by command::CopyBuffer
+    STAT_UPLOADED_BYTES,
+    // Pipeline, descriptor set and buffer binds a DrawQueue skipped because the state was already bound
+    STAT_ELIDED_BINDS,
+    STAT_COUNT,
+};
+// In the bit order of VkQueryPipelineStatisticFlagBits, which is the order results are written in
+enum PipelineStatistic {
+    PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES,
+    PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES,
+    PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS,
+    PIPELINE_STATISTIC_CLIPPING_INVOCATIONS,
+    PIPELINE_STATISTIC_CLIPPING_PRIMITIVES,
+    PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS,
+    PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS,
+    PIPELINE_STATISTIC_COUNT,
+};
+namespace stats {
+extern std::atomic<uint64_t> counters[STAT_COUNT];
+inline void Count(StatCounter counter, uint64_t value = 1) {
+    counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+} // namespace stats
+
+struct FrameStats {
+    // Counters accumulated between the previous two stats::BeginFrame calls
+    uint64_t frame = 0;
+    uint64_t counters[STAT_COUNT]{};
+
+    // Pipeline statistics lag the counters by the frames in flight, they are resolved once the GPU is done
+    bool pipeline_statistics_available = false;
+    uint64_t pipeline_statistics_frame = 0;
+    uint64_t pipeline_statistics[PIPELINE_STATISTIC_COUNT]{};
+
+    // Totals over every VMA block, only filled in by stats::Snapshot
+    VmaStatistics vma_statistics{};
+};
+struct StatsInfo {
+    // Frames between STATS log lines, 0 never logs
+    uint32_t log_interval_frames = 0;
+};
+struct PipelineStatisticsQuery {
+    VkQueryPool vk_query_pool = VK_NULL_HANDLE;
+    uint64_t frame = 0;
+    bool recorded = false;
+};
+struct Stats {
+    StatsInfo info;
+
+    // Requires the pipelineStatisticsQuery device feature, the statistics commands are no-ops without it
+    bool pipeline_statistics_supported = false;
+    PipelineStatisticsQuery queries[MAX_FRAMES_IN_FLIGHT]{};
+
+    uint64_t counter_snapshot[STAT_COUNT]{};
+    std::mutex mutex{};
+    FrameStats frame_stats{};
+};
+Stats* CreateStats(StatsInfo info);
+void DestroyStats(Stats* stats);
+namespace stats {
+/* Call once per frame after render::BeginFrame. Closes the counters of the previous frame, resolves the
+ * pipeline statistics the returned query held frames_in_flight frames ago without waiting, and logs
+ * when the log interval has elapsed. */
+PipelineStatisticsQuery* BeginFrame(Stats* stats);
+// The latest frame with current VMA totals, vmaCalculateStatistics walks every block so this is not per frame
+FrameStats Snapshot(Stats* stats);
+void Log(const FrameStats& frame_stats);
+} // namespace stats
+
+namespace command {
+// Both must be recorded outside a renderpass, every draw in between is counted
+void BeginPipelineStatistics(CommandBuffer* command_buffer, Stats* stats, PipelineStatisticsQuery* query);
+void EndPipelineStatistics(CommandBuffer* command_buffer, Stats* stats, PipelineStatisticsQuery* query);
+} // namespace command
+} // namespace render
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core {
+enum JobPriority {
+    JOB_PRIORITY_LOW = 0,
+    JOB_PRIORITY_NORMAL = 1,
+    JOB_PRIORITY_HIGH = 2,
+    JOB_PRIORITY_CRITICAL = 3,
+    JOB_PRIORITY_COUNT = 4,
+};
+struct ThreadPool {
+    bool active = true;
+    std::vector<std::thread> threads{};
+    std::mutex mutex{};
+    std::condition_variable condition_variable{};
+    // One queue per priority, workers always drain the highest non-empty queue first
+    std::deque<std::function<void()>> job_queues[JOB_PRIORITY_COUNT]{};
+
+    uint32_t running_job_count = 0;
+    std::condition_variable idle_condition_variable{};
+};
+ThreadPool* CreateThreadPool(uint32_t thread_count);
+void DestroyThreadPool(ThreadPool* pool);
+namespace threadpool {
+void Enqueue(ThreadPool* pool, std::function<void()> function, JobPriority priority = JOB_PRIORITY_NORMAL);
+void AwaitIdle(ThreadPool* pool);
+/* Runs function(job) for every job below job_count at high priority and returns once all of them have.
+ * The calling thread runs job 0 itself, so a null pool runs every job in order on the calling thread. */
+void Dispatch(ThreadPool* pool, uint32_t job_count, const std::function<void(uint32_t)>& function);
+
+void ThreadFunction(ThreadPool* pool);
+} // namespace threadpool
+} // namespace core
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+/* CPU tracing, compiled in with ENGINE_ENABLE_TRACING. Without it every CORE_TRACE macro expands to nothing
+ * and core::trace is not declared, so call sites other than the macros must be guarded as well.
+ *
+ * Names must be string literals, or otherwise outlive the trace, only the pointer is recorded. */
+#ifdef ENGINE_ENABLE_TRACING
+
+#include <atomic>
+#include <string>
+
+#ifndef CORE_TRACE_BUFFER_CAPACITY
+// Events kept per thread, older events are overwritten
+#define CORE_TRACE_BUFFER_CAPACITY (1u << 16)
+#endif
+
+namespace core {
+enum TraceEventType : uint8_t {
+    TRACE_EVENT_ZONE_BEGIN,
+    TRACE_EVENT_ZONE_END,
+    TRACE_EVENT_FLOW_BEGIN,
+    TRACE_EVENT_FLOW_STEP,
+    TRACE_EVENT_FLOW_END,
+};
+struct TraceEvent {
+    const char* name;
+    uint64_t timestamp_ns;
+    uint64_t flow_id;
+    TraceEventType type;
+};
+/* Written by its thread alone. The write index is published after the event is stored, so a reader
+ * sees complete events without taking a lock. */
+struct TraceBuffer {
+    uint32_t thread_index;
+    std::atomic<const char*> thread_name{nullptr};
+    std::atomic<uint64_t> write_index{0};
+    TraceEvent events[CORE_TRACE_BUFFER_CAPACITY];
+};
+enum TraceFormat {
+    // Chrome trace event JSON, opened by chrome://tracing and ui.perfetto.dev
+    TRACE_FORMAT_CHROME_JSON,
+    // Perfetto protobuf trace of TrackEvents
+    TRACE_FORMAT_PERFETTO,
+};
+namespace trace {
+void Record(TraceEventType type, const char* name, uint64_t flow_id = 0);
+void SetThreadName(const char* name);
+// Unique across threads, never 0
+uint64_t NewFlowId();
+
+/* Events still being written may be torn, write once the traced threads are idle. The format is
+ * chosen from the extension, .json for Chrome JSON and anything else for Perfetto. */
+bool Write(const std::string& filepath);
+bool Write(const std::string& filepath, TraceFormat format);
+
+struct Zone {
+    const char* name;
+    Zone(const char* name) : name(name) { Record(TRACE_EVENT_ZONE_BEGIN, name); }
+    ~Zone() { Record(TRACE_EVENT_ZONE_END, name); }
+};
+} // namespace trace
+} // namespace core
+
+#define CORE_TRACE_CONCATENATE_INNER(a, b) a##b
+#define CORE_TRACE_CONCATENATE(a, b) CORE_TRACE_CONCATENATE_INNER(a, b)
+#define CORE_TRACE_ZONE(name) core::trace::Zone CORE_TRACE_CONCATENATE(trace_zone_, __LINE__)(name)
+// For zones that do not follow a scope, they must still nest on their thread
+#define CORE_TRACE_ZONE_BEGIN(name) core::trace::Record(core::TRACE_EVENT_ZONE_BEGIN, name)
+#define CORE_TRACE_ZONE_END(name) core::trace::Record(core::TRACE_EVENT_ZONE_END, name)
+#define CORE_TRACE_THREAD_NAME(name) core::trace::SetThreadName(name)
+#define CORE_TRACE_FLOW_BEGIN(name, id) core::trace::Record(core::TRACE_EVENT_FLOW_BEGIN, name, id)
+#define CORE_TRACE_FLOW_STEP(name, id) core::trace::Record(core::TRACE_EVENT_FLOW_STEP, name, id)
+#define CORE_TRACE_FLOW_END(name, id) core::trace::Record(core::TRACE_EVENT_FLOW_END, name, id)
+
+#else
+
+#define CORE_TRACE_ZONE(name)
+#define CORE_TRACE_ZONE_BEGIN(name)
+#define CORE_TRACE_ZONE_END(name)
+#define CORE_TRACE_THREAD_NAME(name)
+#define CORE_TRACE_FLOW_BEGIN(name, id)
+#define CORE_TRACE_FLOW_STEP(name, id)
+#define CORE_TRACE_FLOW_END(name, id)
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace core {
+struct FileWatcherInfo {
+    // How often the watcher thread wakes to check for shutdown, or rescans files where inotify is unavailable
+    uint32_t poll_interval_ms = 250;
+};
+/* Watches individual files for modification. On Linux the parent directories are watched through inotify,
+ * so editors that save by writing a temporary file and renaming it over the original are picked up as well.
+ * Elsewhere the watched files' modification times are polled. */
+struct FileWatcher {
+    uint32_t poll_interval_ms;
+
+    bool active = true;
+    std::thread thread{};
+    std::mutex mutex{};
+
+    int inotify_descriptor = -1;
+    // inotify watch descriptor to watched directory
+    std::unordered_map<int, std::string> directories{};
+
+    std::set<std::string> filepaths{};
+    std::unordered_map<std::string, std::filesystem::file_time_type> modification_times{};
+    // Changed since the last file_watcher::Poll, a burst of writes to one file is reported once
+    std::set<std::string> changes{};
+};
+FileWatcher* CreateFileWatcher(FileWatcherInfo info);
+void DestroyFileWatcher(FileWatcher* watcher);
+namespace file_watcher {
+// Returns the normalized path changes to the file are reported under
+std::string Watch(FileWatcher* watcher, std::string filepath);
+void Unwatch(FileWatcher* watcher, std::string filepath);
+
+// Returns the watched files that changed since the last call, never blocks
+std::vector<std::string> Poll(FileWatcher* watcher);
+
+void WatcherThreadFunction(FileWatcher* watcher);
+} // namespace file_watcher
+} // namespace core
@@ -1,4 +1,7 @@
 #pragma once
+#include <mutex>
+#include <vector>
+
 #include "SDL2/SDL.h"
 
 #include "SDL_vulkan.h"
@@ -17,7 +20,7 @@ struct Extent3D {
     uint32_t z;
 };
 namespace core {
-void Initialize();
+void Initialize(uint32_t sdl_subsystems = SDL_INIT_EVERYTHING);
 void Finalize();
 
 enum WindowFlags {
@@ -42,4 +45,42 @@ Extent2D GetFramebufferExtent(Window window);
 void GetRequiredVkInstanceExtensions(Window window, unsigned int* pCount, const char** pNames);
 void CreateVkSurface(Window window, void* vk_instance, void* vk_surface);
 } // namespace window
+
+struct WindowResize {
+    uint32_t window_id;
+    Extent2D extent;
+};
+// What happened since the previous snapshot, in the order it happened
+struct EventSnapshot {
+    std::vector<SDL_Event> events{};
+    // One per window resized since the previous snapshot, with its latest extent
+    std::vector<WindowResize> resizes{};
+    bool quit = false;
+};
+/* Events gathered by the thread that owns the windows, SDL delivers window events to it alone, and taken
+ * by the frame loop once per frame. Neither side waits on the other beyond a swap of vectors, so a stalled
+ * frame does not hold up input and a burst of events does not hold up a frame. Resizes are coalesced,
+ * the frame loop sees the latest extent of every window once. */
+struct EventQueue {
+    std::mutex mutex{};
+    std::vector<SDL_Event> events{};
+    std::vector<WindowResize> resizes{};
+    bool quit = false;
+
+    // Pushed by Wake, never queued
+    uint32_t wake_event_type = 0;
+    // Gathered without the lock, then appended in one go
+    std::vector<SDL_Event> pending_events{};
+};
+EventQueue* CreateEventQueue();
+void DestroyEventQueue(EventQueue* queue);
+namespace event_queue {
+// On the thread that initialized SDL, waits up to timeout_ms for events and queues every one available
+void Pump(EventQueue* queue, int timeout_ms);
+// Wakes a thread blocked in Pump, from any thread
+void Wake(EventQueue* queue);
+
+// Swaps everything queued since the last call into snapshot, whose vectors are cleared and reused
+void TakeSnapshot(EventQueue* queue, EventSnapshot* snapshot);
+} // namespace event_queue
 } // namespace core
\ No newline at end of file
@@ -1,241 +1,685 @@
+#include <atomic>
+#include <chrono>
+#include <string_view>
+#include <thread>
+
+#include "include/asset.h"
+#include "include/capture.h"
+#include "include/defrag.h"
+#include "include/offscreen.h"
+#include "include/pacing.h"
+#include "include/profiler.h"
+#include "include/reload.h"
 #include "include/render.h"
+#include "include/residency.h"
+#include "include/stats.h"
+#include "include/threadpool.h"
 #include "include/window.h"
 
-core::Window window{};
-render::Swapchain* swapchain{};
-
-render::Renderpass* renderpass;
-render::Framebuffer* framebuffer;
+#ifndef ENGINE_ASSET_DIRECTORY
+#define ENGINE_ASSET_DIRECTORY "."
+#endif
+// The GLSL the build compiled the SPIR-V shaders from, watched so an edit reloads the pipeline
+#ifndef ENGINE_SHADER_SOURCE_DIRECTORY
+#define ENGINE_SHADER_SOURCE_DIRECTORY "shaders"
+#endif
+
+// --headless renders --frames frames into an offscreen ring and reads each one back, no display required
+bool headless = false;
+uint32_t headless_frame_count = 300;
+// --trace writes the CPU trace on exit, Chrome JSON for a .json path and Perfetto otherwise
+std::string trace_filepath{};
+/* Latency against throughput. Interactive use wants --present-mode mailbox or fifo, --frames-in-flight 1
+ * and an --fps-limit at the display rate, batch rendering wants immediate, 3 or 4 and no limit. */
+render::PresentMode present_mode = render::PRESENT_MODE_MAILBOX;
+uint32_t requested_frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+double fps_limit = 0.0;
+/* --capture records every frame of the first output, as numbered PNGs starting with the given path, or with
+ * --capture-format yuv as raw I420 to a file or to a command given as "|command". The readbacks are sized
+ * for the output at startup, frames of a larger window are dropped. */
+std::string capture_output{};
+render::CaptureFormat capture_format = render::CAPTURE_FORMAT_PNG;
+// --pipeline-cache names the pipeline cache file, pipelines are compiled without one for an empty name
+std::string pipeline_cache_filepath = "pipeline.cache";
+// --windows opens several windows, one per display of a multi monitor setup, presented in a single call
+uint32_t output_count = 1;
+const uint32_t MAX_OUTPUT_COUNT = 8;
+
+// A render target and everything that draws into it, a window unless headless
+struct Output {
+    core::Window window{};
+    uint32_t window_id = 0;
+    render::Swapchain* swapchain{};
+
+    render::Renderpass* renderpass;
+    render::Framebuffer* framebuffer;
+
+    // A command pool of its own gives every output its own record thread
+    render::CommandPool* command_pool;
+
+    render::Semaphore image_acquisition_semaphore[MAX_FRAMES_IN_FLIGHT];
+    render::Semaphore render_completion_semaphore[MAX_FRAMES_IN_FLIGHT];
+    render::Fence* fence[MAX_FRAMES_IN_FLIGHT];
+    render::Fence* acquisition_fence[MAX_FRAMES_IN_FLIGHT];
+    // Whether the acquisition fence of the frame slot was handed to an acquire that succeeded
+    bool acquiring[MAX_FRAMES_IN_FLIGHT];
+};
+Output outputs[MAX_OUTPUT_COUNT]{};
+render::OffscreenTarget* offscreen_target{};
+render::ReadbackPool* readback_pool{};
 
+// Created against the renderpass of the first output, the swapchains of one device share a surface format
 render::Pipeline* pipeline;
 
-render::CommandPool* command_pool;
-
-render::Semaphore image_acquisition_semaphore[MAX_FRAMES_IN_FLIGHT];
-render::Semaphore render_completion_semaphore[MAX_FRAMES_IN_FLIGHT];
-render::Fence* fence[MAX_FRAMES_IN_FLIGHT];
-render::Fence* acquisition_fence[MAX_FRAMES_IN_FLIGHT];
-
-std::mutex recreation_mutex{};
-std::atomic<bool> recreation_occured = false;
-
-void Initialize() {
-    core::Initialize();
-
-    core::WindowInfo window_info{};
-    window_info.extent = {1000, 700};
-    window_info.offset = {0, 0};
-    window_info.flags = (core::WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
-    window = core::CreateWindow(window_info);
-
-    RENDER_LOG_INITIALIZE
-    render::ContextInfo context_info{};
-    context_info.window = window;
-    context_info.enable_validation_layers = true;
-    render::context = render::CreateContext(context_info);
-
-    render::InitializeSubmission();
+core::ThreadPool* worker_pool;
+/* Every output but the first acquires on a thread of this pool, the first on the render thread. Acquires block
+ * until the display gives an image back, so they never hold a worker of worker_pool. */
+core::ThreadPool* acquire_pool{};
+render::PipelineReloader* pipeline_reloader;
+
+render::ResidencyManager* residency_manager;
+render::Defragmenter* defragmenter;
+render::Capturer* capturer{};
+// Profiling and statistics cover the first output that acquired an image that frame
+render::GpuProfiler* gpu_profiler;
+render::Stats* stats;
+render::FramePacer* frame_pacer;
+
+// The main thread owns the windows and pumps their events, frames are rendered on a thread of their own
+core::EventQueue* event_queue;
+std::atomic<bool> rendering = true;
+
+/* Startup is traced and logged phase by phase, ending with the time from launch to the first submitted frame.
+ * A phase begins and ends on one thread, the first frame is its own phase on the render thread. */
+std::chrono::steady_clock::time_point launch_time{};
+std::chrono::steady_clock::time_point startup_phase_time{};
+const char* startup_phase = nullptr;
+
+double Milliseconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+// Ends the current phase and begins the next, nullptr only ends the current one
+void StartupPhase(const char* phase) {
+    auto now = std::chrono::steady_clock::now();
+    if (startup_phase != nullptr) {
+        CORE_TRACE_ZONE_END(startup_phase);
+        RENDER_LOG_INFO("STARTUP: {} {:.2f}ms", startup_phase, Milliseconds(now - startup_phase_time));
+    }
+    if (phase != nullptr) {
+        CORE_TRACE_ZONE_BEGIN(phase);
+    }
+    startup_phase = phase;
+    startup_phase_time = now;
+}
 
-    swapchain = render::CreateSwapchain(window);
+Extent3D TargetExtent(Output* output) { return headless ? offscreen_target->extent : output->swapchain->extent; }
+
+render::RenderpassInfo SwapchainRenderpassInfo(render::Swapchain* swapchain,
+                                               render::SwapchainAttachment* swapchain_attachment) {
+    return {swapchain->extent,
+            {},
+            {{
+                {},
+                {{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}},
+                nullptr,
+            }},
+            swapchain_attachment};
+}
+void InitializeWindowOutput(Output* output) {
+    output->swapchain = render::CreateSwapchain(output->window, present_mode);
     render::SwapchainAttachment swapchain_attachment = {
         VK_IMAGE_LAYOUT_UNDEFINED,
         VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
         render::LoadOp::CLEAR,
         render::StoreOp::STORE,
-        swapchain,
+        output->swapchain,
     };
-    renderpass = render::CreateRenderpass({swapchain->extent,
-                                           {},
-                                           {{
-                                               {},
-                                               {{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}},
-                                               nullptr,
-                                           }},
-                                           &swapchain_attachment});
+    output->renderpass = render::CreateRenderpass(SwapchainRenderpassInfo(output->swapchain, &swapchain_attachment));
 
     auto framebuffer_info = render::FramebufferInfo{};
-    framebuffer_info.renderpass = renderpass;
-    framebuffer_info.swapchain = swapchain;
-    framebuffer_info.extent = swapchain->extent;
-    framebuffer = render::CreateFramebuffer(framebuffer_info);
+    framebuffer_info.renderpass = output->renderpass;
+    framebuffer_info.swapchain = output->swapchain;
+    framebuffer_info.extent = output->swapchain->extent;
+    output->framebuffer = render::CreateFramebuffer(framebuffer_info);
+
+    render::swapchain::BindRecreationFunction(output->swapchain, [output]() {
+        RENDER_LOG_INFO("RECREATION BEGINS");
+        render::SwapchainAttachment swapchain_attachment = {
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            render::LoadOp::CLEAR,
+            render::StoreOp::STORE,
+            output->swapchain,
+        };
+        render::renderpass::Recreate(output->renderpass,
+                                     SwapchainRenderpassInfo(output->swapchain, &swapchain_attachment));
+
+        auto framebuffer_info = render::FramebufferInfo{};
+        framebuffer_info.renderpass = output->renderpass;
+        framebuffer_info.swapchain = output->swapchain;
+        framebuffer_info.extent = output->swapchain->extent;
+        render::framebuffer::Recreate(output->framebuffer, framebuffer_info);
+    });
+}
+
+void Initialize() {
+    CORE_TRACE_ZONE("Initialize");
+    ASSET_LOG_INITIALIZE
+    RENDER_LOG_INITIALIZE
 
+    StartupPhase("Assets");
+    asset::vfs::MountDirectory("", ENGINE_ASSET_DIRECTORY);
+    if (asset::vfs::Exists(ENGINE_ASSET_DIRECTORY "/assets.pak")) {
+        asset::vfs::MountArchive("", ENGINE_ASSET_DIRECTORY "/assets.pak");
+    }
     render::PipelineInfo pipeline_info{};
-    pipeline_info.renderpass = renderpass;
     pipeline_info.shaders = {
-        {render::SHADER_STAGE_VERTEX, render::SHADER_FORMAT_SPIRV,
-         "/Users/natalie/Desktop/engine_rewrite/build/vert.spirv"},
-        {render::SHADER_STAGE_FRAGMENT, render::SHADER_FORMAT_SPIRV,
-         "/Users/natalie/Desktop/engine_rewrite/build/frag.spirv"},
+        {render::SHADER_STAGE_VERTEX, render::SHADER_FORMAT_SPIRV, "triangle.vert.spirv"},
+        {render::SHADER_STAGE_FRAGMENT, render::SHADER_FORMAT_SPIRV, "triangle.frag.spirv"},
     };
-    pipeline_info.front_face = render::FRONT_FACE_CW;
-    pipeline_info.cull_mode = render::NGFX_CULL_MODE_NONE;
-    pipeline_info.depth_test_enabled = false;
-    pipeline_info.depth_write_enabled = false;
-    pipeline = render::CreatePipeline(pipeline_info);
-
-    command_pool = render::CreateCommandPool();
+    // The workers read the shaders while the platform and the device are brought up
+    worker_pool = core::CreateThreadPool(0);
+    for (const render::ShaderInfo& shader_info : pipeline_info.shaders) {
+        core::threadpool::Enqueue(worker_pool,
+                                  [filepath = shader_info.filepath]() { render::shader::Prefetch(filepath); });
+    }
 
-    for (uint8_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        image_acquisition_semaphore[i] = render::CreateSemaphore();
-        render_completion_semaphore[i] = render::CreateSemaphore();
+    StartupPhase("Platform");
+    if (headless) {
+        core::Initialize(SDL_INIT_EVENTS);
+    } else {
+        core::Initialize();
+
+        for (uint32_t i = 0; i < output_count; i++) {
+            core::WindowInfo window_info{};
+            window_info.extent = {1000, 700};
+            window_info.offset = {(int32_t)(i * 1000), 0};
+            window_info.flags = (core::WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
+            outputs[i].window = core::CreateWindow(window_info);
+            outputs[i].window_id = SDL_GetWindowID(outputs[i].window.sdl_window);
+        }
+    }
+    event_queue = core::CreateEventQueue();
 
-        fence[i] = render::CreateFence(render::fence::INITIALIZE_SIGNALED);
-        acquisition_fence[i] = render::CreateFence(render::fence::INITIALIZE_SIGNALED);
+    StartupPhase("Context");
+    render::ContextInfo context_info{};
+    if (!headless) {
+        context_info.window = outputs[0].window;
+    }
+    context_info.enable_validation_layers = true;
+    if (!pipeline_cache_filepath.empty()) {
+        context_info.pipeline_cache_filepath = pipeline_cache_filepath.c_str();
     }
+    render::context = render::CreateContext(context_info);
+    render::SetFramesInFlight(requested_frames_in_flight);
 
-    render::swapchain::BindRecreationFunction(swapchain, []() {
-        RENDER_LOG_INFO("RECREATION BEGINS");
-        render::SwapchainAttachment swapchain_attachment = {
+    render::InitializeSubmission();
+
+    StartupPhase("Outputs");
+    if (headless) {
+        offscreen_target = render::CreateOffscreenTarget({{1000, 700, 1}});
+        readback_pool = render::CreateReadbackPool({VkDeviceSize{1000} * 700 * 4});
+
+        render::Attachment offscreen_attachment = {
             VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            offscreen_target->format,
             render::LoadOp::CLEAR,
             render::StoreOp::STORE,
-            swapchain,
         };
-        render::renderpass::Recreate(renderpass, {swapchain->extent,
-                                                  {},
-                                                  {{
-                                                      {},
-                                                      {{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}},
-                                                      nullptr,
-                                                  }},
-                                                  &swapchain_attachment});
-
+        outputs[0].renderpass = render::CreateRenderpass({offscreen_target->extent,
+                                                          {offscreen_attachment},
+                                                          {{
+                                                              {},
+                                                              {{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}},
+                                                              nullptr,
+                                                          }},
+                                                          nullptr});
         auto framebuffer_info = render::FramebufferInfo{};
-        framebuffer_info.renderpass = renderpass;
-        framebuffer_info.swapchain = swapchain;
-        framebuffer_info.extent = swapchain->extent;
-        render::framebuffer::Recreate(framebuffer, framebuffer_info);
-    });
+        framebuffer_info.offscreen_target = offscreen_target;
+        framebuffer_info.renderpass = outputs[0].renderpass;
+        framebuffer_info.extent = offscreen_target->extent;
+        outputs[0].framebuffer = render::CreateFramebuffer(framebuffer_info);
+    } else {
+        for (uint32_t i = 0; i < output_count; i++) {
+            InitializeWindowOutput(&outputs[i]);
+        }
+    }
+
+    StartupPhase("Pipelines");
+    core::threadpool::AwaitIdle(worker_pool);
+    pipeline_info.renderpass = outputs[0].renderpass;
+    pipeline_info.front_face = render::FRONT_FACE_CW;
+    pipeline_info.cull_mode = render::NGFX_CULL_MODE_NONE;
+    pipeline_info.depth_test_enabled = false;
+    pipeline_info.depth_write_enabled = false;
+    pipeline = render::CreatePipeline(pipeline_info);
+
+    if (output_count > 1) {
+        acquire_pool = core::CreateThreadPool(output_count - 1);
+    }
+    pipeline_reloader = render::CreatePipelineReloader({worker_pool});
+    std::vector<render::ShaderInfo> shader_sources = {
+        {render::SHADER_STAGE_VERTEX, render::SHADER_FORMAT_GLSL, ENGINE_SHADER_SOURCE_DIRECTORY "/triangle.vert"},
+        {render::SHADER_STAGE_FRAGMENT, render::SHADER_FORMAT_GLSL, ENGINE_SHADER_SOURCE_DIRECTORY "/triangle.frag"},
+    };
+    render::pipeline_reloader::Register(pipeline_reloader, pipeline, shader_sources);
+
+    StartupPhase("Frame Resources");
+    residency_manager = render::CreateResidencyManager({});
+    defragmenter = render::CreateDefragmenter({});
+    if (!capture_output.empty()) {
+        Extent3D extent = TargetExtent(&outputs[0]);
+        render::CaptureInfo capture_info{};
+        capture_info.format = capture_format;
+        capture_info.output = capture_output;
+        capture_info.thread_pool = worker_pool;
+        capture_info.buffer_size = VkDeviceSize{extent.x} * extent.y * 4;
+        capturer = render::CreateCapturer(capture_info);
+    }
+    gpu_profiler = render::CreateGpuProfiler({});
+    stats = render::CreateStats({600});
+    frame_pacer = render::CreateFramePacer({fps_limit});
+
+    for (uint32_t output = 0; output < output_count; output++) {
+        outputs[output].command_pool = render::CreateCommandPool();
+        for (uint8_t i = 0; i < render::frames_in_flight; i++) {
+            outputs[output].image_acquisition_semaphore[i] = render::CreateSemaphore();
+            outputs[output].render_completion_semaphore[i] = render::CreateSemaphore();
+
+            outputs[output].fence[i] = render::CreateFence(render::fence::INITIALIZE_SIGNALED);
+            outputs[output].acquisition_fence[i] = render::CreateFence(render::fence::INITIALIZE_SIGNALED);
+        }
+    }
+    StartupPhase(nullptr);
 }
 void Finalize() {
     render::FinalizeSubmission();
 
-    for (uint8_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        render::DestroyFence(fence[i]);
-        render::DestroyFence(acquisition_fence[i]);
+    for (uint32_t output = 0; output < output_count; output++) {
+        for (uint8_t i = 0; i < render::frames_in_flight; i++) {
+            render::DestroyFence(outputs[output].fence[i]);
+            render::DestroyFence(outputs[output].acquisition_fence[i]);
 
-        render::DestroySemaphore(render_completion_semaphore[i]);
-        render::DestroySemaphore(image_acquisition_semaphore[i]);
+            render::DestroySemaphore(outputs[output].render_completion_semaphore[i]);
+            render::DestroySemaphore(outputs[output].image_acquisition_semaphore[i]);
+        }
     }
 
-    render::DestroyCommandPool(command_pool);
+    render::DestroyFramePacer(frame_pacer);
+    render::DestroyStats(stats);
+    render::DestroyGpuProfiler(gpu_profiler);
+    if (capturer != nullptr) {
+        render::DestroyCapturer(capturer);
+    }
+    render::DestroyDefragmenter(defragmenter);
+    render::DestroyResidencyManager(residency_manager);
 
-    render::DestroyPipeline(pipeline);
+    for (uint32_t output = 0; output < output_count; output++) {
+        render::DestroyCommandPool(outputs[output].command_pool);
+    }
 
-    render::DestroyFramebuffer(framebuffer);
-    render::DestroyRenderpass(renderpass);
+    render::pipeline_reloader::Unregister(pipeline_reloader, pipeline);
+    render::DestroyPipelineReloader(pipeline_reloader);
+    if (acquire_pool != nullptr) {
+        core::DestroyThreadPool(acquire_pool);
+    }
+    core::DestroyThreadPool(worker_pool);
+    render::FlushRetired();
 
-    render::DestroySwapchain(swapchain);
+    render::DestroyPipeline(pipeline);
+
+    for (uint32_t output = 0; output < output_count; output++) {
+        render::DestroyFramebuffer(outputs[output].framebuffer);
+        render::DestroyRenderpass(outputs[output].renderpass);
+        if (!headless) {
+            render::DestroySwapchain(outputs[output].swapchain);
+        }
+    }
+    if (headless) {
+        render::DestroyReadbackPool(readback_pool);
+        render::DestroyOffscreenTarget(offscreen_target);
+    }
     render::DestroyContext(render::context);
     RENDER_LOG_FINALIZE
 
-    core::DestroyWindow(window);
+    asset::vfs::Finalize();
+    ASSET_LOG_FINALIZE
 
+    if (!headless) {
+        for (uint32_t output = 0; output < output_count; output++) {
+            core::DestroyWindow(outputs[output].window);
+        }
+    }
+    core::DestroyEventQueue(event_queue);
     core::Finalize();
 }
 
-int main(int argc, char** argv) {
-    Initialize();
-
+void RenderLoop() {
+    CORE_TRACE_THREAD_NAME("render");
+    StartupPhase("First Frame");
     uint8_t current_frame = 0;
-    render::CommandBuffer* command_buffer[MAX_FRAMES_IN_FLIGHT];
-    for (uint8_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        command_buffer[i] = render::command_pool::BorrowCommandBuffer(command_pool);
-    }
+
+    render::Readback* readbacks[MAX_FRAMES_IN_FLIGHT]{};
+    uint64_t readback_size = 0;
+    uint32_t frame_count = 0;
+    auto start_time = std::chrono::steady_clock::now();
+    core::EventSnapshot event_snapshot{};
 
     bool running = true;
     while (running) {
-        render::fence::Await(fence[current_frame]);
-        render::fence::Reset(fence[current_frame]);
-
-        SDL_Event e{};
-        while (SDL_PollEvent(&e)) {
-            if (e.type == SDL_WINDOWEVENT) {
-                if (e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
-                    render::swapchain::Recreate(swapchain);
-                }
-            }
-            if (e.type == SDL_QUIT) {
+        CORE_TRACE_ZONE("Frame");
+        for (uint32_t i = 0; i < output_count; i++) {
+            render::fence::Await(outputs[i].fence[current_frame]);
+        }
+        // The readback recorded under this fence has landed, it must be read before the fence is reset
+        if (readbacks[current_frame] != nullptr) {
+            render::readback_pool::Read(readbacks[current_frame]);
+            readback_size += readbacks[current_frame]->buffer->size;
+            render::readback_pool::Release(readback_pool, readbacks[current_frame]);
+            readbacks[current_frame] = nullptr;
+        }
+        render::BeginFrame();
+        for (uint32_t i = 0; i < output_count; i++) {
+            render::command_pool::BeginFrame(outputs[i].command_pool);
+        }
+
+        if (headless && frame_count == headless_frame_count) {
+            running = false;
+        }
+        int64_t input_time_ns = render::frame_pacer::Wait(frame_pacer);
+        core::event_queue::TakeSnapshot(event_queue, &event_snapshot);
+        for (const SDL_Event& e : event_snapshot.events) {
+            // SDL_QUIT only follows the last window, closing any of them ends the run
+            if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_CLOSE) {
                 running = false;
             }
         }
+        if (event_snapshot.quit) {
+            running = false;
+        }
         if (running == false)
             break;
 
-        render::fence::Await(acquisition_fence[current_frame]);
-        render::fence::Reset(acquisition_fence[current_frame]);
-        uint32_t image_index;
-        render::swapchain::AcquireImage(swapchain, &image_index, image_acquisition_semaphore[current_frame],
-                                        acquisition_fence[current_frame]);
-        render::command_pool::RecordAsync(
-            command_pool, command_buffer[current_frame], [command_buffer, current_frame, image_index]() {
-                RENDER_LOG_INFO("RECORD BEGINS");
-
-                render::command_pool::ResetCommandBuffer(command_pool, command_buffer[current_frame]);
-
-                render::command::BeginCommandBuffer(command_pool, command_buffer[current_frame]);
-                VkRenderPassBeginInfo begin_info{};
-                begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                begin_info.pNext = nullptr;
-
-                begin_info.renderPass = renderpass->vk_render_pass;
-                begin_info.framebuffer = framebuffer->vk_framebuffer[image_index];
-                begin_info.renderArea = {
-                    0,
-                    0,
-                    swapchain->extent.x,
-                    swapchain->extent.y,
-                };
-
-                VkClearValue clear_value = {{{0.0f, 0.0f, 0.0f, 0.0f}}};
-                begin_info.clearValueCount = 1;
-                begin_info.pClearValues = &clear_value;
-
-                vkCmdBeginRenderPass(command_buffer[current_frame]->vk_command_buffer, &begin_info,
-                                     VK_SUBPASS_CONTENTS_INLINE);
-
-                render::command::BindPipeline(command_buffer[current_frame], pipeline);
-                VkViewport viewport{};
-                viewport.width = (float)swapchain->extent.x;
-                viewport.height = (float)swapchain->extent.y;
-                viewport.x = 0;
-                viewport.y = 0;
-                viewport.minDepth = 0.0f;
-                viewport.maxDepth = 1.0f;
-                vkCmdSetViewport(command_buffer[current_frame]->vk_command_buffer, 0, 1, &viewport);
-
-                VkRect2D scissor{};
-                scissor.offset = {0, 0};
-                scissor.extent = {swapchain->extent.x, swapchain->extent.y};
-                vkCmdSetScissor(command_buffer[current_frame]->vk_command_buffer, 0, 1, &scissor);
-                vkCmdDraw(command_buffer[current_frame]->vk_command_buffer, 3, 1, 0, 0);
-
-                vkCmdEndRenderPass(command_buffer[current_frame]->vk_command_buffer);
-                render::command::EndCommandBuffer(command_pool, command_buffer[current_frame]);
-                RENDER_LOG_INFO("RECORD ENDS");
-            });
-
-        auto submit_info = render::SubmitInfo{};
-        submit_info.wait_semaphores = {image_acquisition_semaphore[current_frame]};
-        submit_info.wait_stage_flags = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submit_info.signal_semaphores = {render_completion_semaphore[current_frame]};
-        submit_info.fence = fence[current_frame];
-        submit_info.command_pool = command_pool;
-        submit_info.command_buffer = command_buffer[current_frame];
-        render::SubmitUniversalAsync(submit_info);
-
-        render::SubmitPresentAsync({{render_completion_semaphore[current_frame]},
-                                    {swapchain},
-                                    {image_index},
-                                    acquisition_fence[current_frame]});
-
-        current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+        render::residency::Update(residency_manager);
+        render::pipeline_reloader::Update(pipeline_reloader);
+
+        /* Swapchains are recreated here and only here, at most once each, while no acquire is running. A
+         * recreation idles the device, which would deadlock against a present queued behind an acquire. */
+        if (!headless) {
+            for (uint32_t i = 0; i < output_count; i++) {
+                bool resized = false;
+                for (const core::WindowResize& resize : event_snapshot.resizes) {
+                    resized |= outputs[i].window_id == resize.window_id;
+                }
+                if (render::swapchain::TakeOutOfDate(outputs[i].swapchain) || resized) {
+                    render::swapchain::Recreate(outputs[i].swapchain);
+                }
+            }
+        }
+        /* Every output waits on its acquisition fence and acquires at once, on the render thread and the threads
+         * of acquire_pool, so the waits of several displays overlap instead of adding up. An output without an
+         * image is left out of the frame, its fences stay as they are until it acquires again. */
+        uint32_t image_indices[MAX_OUTPUT_COUNT]{};
+        bool acquired[MAX_OUTPUT_COUNT]{};
+        core::threadpool::Dispatch(acquire_pool, output_count, [&image_indices, &acquired, current_frame](uint32_t i) {
+            Output* output = &outputs[i];
+            if (headless) {
+                render::offscreen_target::AcquireImage(offscreen_target, &image_indices[i]);
+                acquired[i] = true;
+                return;
+            }
+            if (output->acquiring[current_frame]) {
+                render::fence::Await(output->acquisition_fence[current_frame]);
+            }
+            render::fence::Reset(output->acquisition_fence[current_frame]);
+            acquired[i] = render::swapchain::AcquireImage(output->swapchain, &image_indices[i],
+                                                          output->image_acquisition_semaphore[current_frame],
+                                                          output->acquisition_fence[current_frame]);
+            output->acquiring[current_frame] = acquired[i];
+        });
+        // The first output with an image carries the frame wide work
+        uint32_t first_output = output_count;
+        for (uint32_t i = 0; i < output_count; i++) {
+            if (acquired[i]) {
+                render::fence::Reset(outputs[i].fence[current_frame]);
+                first_output = std::min(first_output, i);
+            }
+        }
+        // Nothing is submitted, the slot still advances with render::BeginFrame
+        if (first_output == output_count) {
+            current_frame = (current_frame + 1) % render::frames_in_flight;
+            continue;
+        }
+
+        render::DefragmentationPass* defragmentation_pass = render::defragmenter::BeginFrame(defragmenter);
+        render::GpuProfile* gpu_profile = render::gpu_profiler::BeginFrame(gpu_profiler);
+        render::PipelineStatisticsQuery* statistics_query = render::stats::BeginFrame(stats);
+        render::CaptureFrame* capture_frame = capturer != nullptr ? render::capturer::BeginFrame(capturer) : nullptr;
+
+        // Filled from the frame arena, so the frame loop does not touch the heap
+        core::Arena* frame_arena = render::FrameArena();
+        auto present_info = render::PresentInfo{};
+        present_info.wait_semaphores = core::ArenaVector<render::Semaphore>(frame_arena);
+        present_info.swapchains = core::ArenaVector<render::Swapchain*>(frame_arena);
+        present_info.image_indices = core::ArenaVector<uint32_t>(frame_arena);
+        present_info.fences = core::ArenaVector<render::Fence*>(frame_arena);
+        present_info.presented = [input_time_ns]() {
+            render::frame_pacer::RecordPresent(frame_pacer, input_time_ns);
+        };
+
+        // Every output records on its own thread and submits in output order, then one call presents them all
+        for (uint32_t i = 0; i < output_count; i++) {
+            if (!acquired[i]) {
+                continue;
+            }
+            Output* output = &outputs[i];
+            uint32_t image_index = image_indices[i];
+            render::Readback* readback = nullptr;
+            if (headless) {
+                readback = render::readback_pool::Acquire(readback_pool);
+                readbacks[current_frame] = readback;
+            }
+            Extent3D extent = TargetExtent(output);
+            bool first = i == first_output;
+            render::CommandBuffer* command_buffer =
+                render::command_pool::AllocateFrameCommandBuffer(output->command_pool);
+            render::command_pool::RecordAsync(
+                output->command_pool, command_buffer,
+                [output, first, command_buffer, current_frame, image_index, extent, readback, gpu_profile,
+                 statistics_query, defragmentation_pass, capture_frame]() {
+                    render::command::BeginCommandBuffer(output->command_pool, command_buffer);
+                    if (first) {
+                        render::command::Defragment(command_buffer, defragmenter, defragmentation_pass);
+                        render::command::BeginGpuProfile(command_buffer, gpu_profiler, gpu_profile);
+                        render::command::BeginGpuScope(command_buffer, gpu_profiler, gpu_profile, "frame");
+                    }
+                    VkRenderPassBeginInfo begin_info{};
+                    begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    begin_info.pNext = nullptr;
+
+                    begin_info.renderPass = output->renderpass->vk_render_pass;
+                    begin_info.framebuffer = output->framebuffer->vk_framebuffer[image_index];
+                    begin_info.renderArea = {
+                        0,
+                        0,
+                        extent.x,
+                        extent.y,
+                    };
+
+                    VkClearValue clear_value = {{{0.0f, 0.0f, 0.0f, 0.0f}}};
+                    begin_info.clearValueCount = 1;
+                    begin_info.pClearValues = &clear_value;
+
+                    if (first) {
+                        render::command::BeginGpuScope(command_buffer, gpu_profiler, gpu_profile, "triangle");
+                        render::command::BeginPipelineStatistics(command_buffer, stats, statistics_query);
+                    }
+                    vkCmdBeginRenderPass(command_buffer->vk_command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+
+                    render::command::BindPipeline(command_buffer, pipeline);
+                    VkViewport viewport{};
+                    viewport.width = (float)extent.x;
+                    viewport.height = (float)extent.y;
+                    viewport.x = 0;
+                    viewport.y = 0;
+                    viewport.minDepth = 0.0f;
+                    viewport.maxDepth = 1.0f;
+                    vkCmdSetViewport(command_buffer->vk_command_buffer, 0, 1, &viewport);
+
+                    VkRect2D scissor{};
+                    scissor.offset = {0, 0};
+                    scissor.extent = {extent.x, extent.y};
+                    vkCmdSetScissor(command_buffer->vk_command_buffer, 0, 1, &scissor);
+                    render::command::Draw(command_buffer, 3);
+
+                    vkCmdEndRenderPass(command_buffer->vk_command_buffer);
+                    if (first) {
+                        render::command::EndPipelineStatistics(command_buffer, stats, statistics_query);
+                        render::command::EndGpuScope(command_buffer, gpu_profiler, gpu_profile);
+                    }
+                    if (readback != nullptr) {
+                        render::command::ScopedGpuScope scope(command_buffer, gpu_profiler, gpu_profile, "readback");
+                        render::readback_pool::RecordCopy(command_buffer, readback,
+                                                          offscreen_target->images[image_index],
+                                                          output->fence[current_frame]);
+                    }
+                    if (first && capture_frame != nullptr) {
+                        render::command::ScopedGpuScope scope(command_buffer, gpu_profiler, gpu_profile, "capture");
+                        if (headless) {
+                            render::command::Capture(command_buffer, capturer, capture_frame,
+                                                     offscreen_target->images[image_index]->vk_image, extent,
+                                                     offscreen_target->format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                                     output->fence[current_frame]);
+                        } else if (!(output->swapchain->vk_image_usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+                            RENDER_LOG_RATE_LIMITED(ERROR, 1000,
+                                                    "CAPTURE: Window {} Cannot Be Captured, Its Surface Does Not "
+                                                    "Support Copies!",
+                                                    output->window_id);
+                        } else {
+                            render::command::Capture(command_buffer, capturer, capture_frame,
+                                                     output->swapchain->vk_images[image_index], extent,
+                                                     output->swapchain->vk_surface_format.format,
+                                                     VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, output->fence[current_frame]);
+                        }
+                    }
+                    if (first) {
+                        render::command::EndGpuScope(command_buffer, gpu_profiler, gpu_profile);
+                    }
+                    render::command::EndCommandBuffer(output->command_pool, command_buffer);
+                });
+
+            auto submit_info = render::SubmitInfo{};
+            if (!headless) {
+                submit_info.wait_semaphores = {{output->image_acquisition_semaphore[current_frame]}, frame_arena};
+                submit_info.signal_semaphores = {{output->render_completion_semaphore[current_frame]}, frame_arena};
+            }
+            submit_info.wait_stage_flags = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+            submit_info.fence = output->fence[current_frame];
+            submit_info.command_pool = output->command_pool;
+            submit_info.command_buffer = command_buffer;
+            render::SubmitUniversalAsync(submit_info);
+
+            if (!headless) {
+                present_info.wait_semaphores.emplace_back(output->render_completion_semaphore[current_frame]);
+                present_info.swapchains.emplace_back(output->swapchain);
+                present_info.image_indices.emplace_back(image_index);
+                present_info.fences.emplace_back(output->acquisition_fence[current_frame]);
+            }
+        }
+        if (!headless && present_info.swapchains.size() > 0) {
+            render::SubmitPresentAsync(present_info);
+        }
+        if (frame_count == 0) {
+            StartupPhase(nullptr);
+            RENDER_LOG_INFO("STARTUP: First Frame Submitted {:.2f}ms After Launch",
+                            Milliseconds(std::chrono::steady_clock::now() - launch_time));
+        }
+
+        frame_count++;
+        current_frame = (current_frame + 1) % render::frames_in_flight;
     }
 
     render::AwaitIdle();
-    for (uint8_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        render::command_pool::ReturnCommandBuffer(command_pool, command_buffer[i]);
+    if (headless) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        RENDER_LOG_INFO("HEADLESS: {} Frames In {:.2f}s, {:.1f} FPS, {} MB Read Back", frame_count, seconds,
+                        frame_count / seconds, readback_size / (1024 * 1024));
+    }
+}
+
+int main(int argc, char** argv) {
+    launch_time = std::chrono::steady_clock::now();
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        if (argument == "--headless") {
+            headless = true;
+        } else if (argument == "--frames" && i + 1 < argc) {
+            headless_frame_count = std::stoul(argv[++i]);
+        } else if (argument == "--trace" && i + 1 < argc) {
+            trace_filepath = argv[++i];
+        } else if (argument == "--present-mode" && i + 1 < argc) {
+            std::string_view mode = argv[++i];
+            if (mode == "fifo") {
+                present_mode = render::PRESENT_MODE_FIFO;
+            } else if (mode == "fifo_relaxed") {
+                present_mode = render::PRESENT_MODE_FIFO_RELAXED;
+            } else if (mode == "mailbox") {
+                present_mode = render::PRESENT_MODE_MAILBOX;
+            } else if (mode == "immediate") {
+                present_mode = render::PRESENT_MODE_IMMEDIATE;
+            }
+        } else if (argument == "--frames-in-flight" && i + 1 < argc) {
+            requested_frames_in_flight = std::stoul(argv[++i]);
+        } else if (argument == "--fps-limit" && i + 1 < argc) {
+            fps_limit = std::stod(argv[++i]);
+        } else if (argument == "--capture" && i + 1 < argc) {
+            capture_output = argv[++i];
+        } else if (argument == "--capture-format" && i + 1 < argc) {
+            std::string_view format = argv[++i];
+            capture_format = format == "yuv" ? render::CAPTURE_FORMAT_YUV : render::CAPTURE_FORMAT_PNG;
+        } else if (argument == "--pipeline-cache" && i + 1 < argc) {
+            pipeline_cache_filepath = argv[++i];
+        } else if (argument == "--windows" && i + 1 < argc) {
+            output_count = std::clamp((uint32_t)std::stoul(argv[++i]), 1u, MAX_OUTPUT_COUNT);
+        }
+    }
+    if (headless) {
+        output_count = 1;
+    }
+    CORE_TRACE_THREAD_NAME("main");
+    Initialize();
+
+    std::thread render_thread([]() {
+        RenderLoop();
+        rendering = false;
+        core::event_queue::Wake(event_queue);
+    });
+    while (rendering) {
+        core::event_queue::Pump(event_queue, 100);
+    }
+    render_thread.join();
+
+    if (!trace_filepath.empty()) {
+#ifdef ENGINE_ENABLE_TRACING
+        if (!core::trace::Write(trace_filepath)) {
+            RENDER_LOG_ERROR("TRACE: Failed to Write {}!", trace_filepath);
+        }
+#else
+        RENDER_LOG_ERROR("TRACE: Tracing Is Not Compiled In, Configure With ENGINE_ENABLE_TRACING!");
+#endif
+    }
+    for (const render::GpuPassTiming& timing : render::gpu_profiler::GetTimings(gpu_profiler)) {
+        RENDER_LOG_INFO("GPU PASS: {:>{}}{} Average {:.3f}ms, Max {:.3f}ms", "", timing.depth * 2, timing.name,
+                        timing.average_ms, timing.max_ms);
+    }
+    render::FrameTiming wait_timing = render::frame_pacer::GetWaitTiming(frame_pacer);
+    RENDER_LOG_INFO("FRAME PACER: {} Frames In Flight, Wait Average {:.3f}ms, Max {:.3f}ms", render::frames_in_flight,
+                    wait_timing.average_ms, wait_timing.max_ms);
+    if (!headless) {
+        render::FrameTiming latency_timing = render::frame_pacer::GetLatencyTiming(frame_pacer);
+        RENDER_LOG_INFO("FRAME PACER: Input To Present Average {:.3f}ms, Max {:.3f}ms", latency_timing.average_ms,
+                        latency_timing.max_ms);
     }
     Finalize();
 }
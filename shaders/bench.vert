@@ -0,0 +1,14 @@
+#version 450
+
+layout(location = 0) out vec3 fragment_color;
+
+const vec2 positions[3] = vec2[](vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+const vec3 colors[3] = vec3[](vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0));
+
+// Each draw passes its index as firstInstance and lands on its own cell of a 32x32 grid
+void main() {
+    uint cell = uint(gl_InstanceIndex) % 1024u;
+    vec2 offset = (vec2(cell % 32u, cell / 32u) + 0.5) / 16.0 - 1.0;
+    gl_Position = vec4(positions[gl_VertexIndex] / 16.0 + offset, 0.0, 1.0);
+    fragment_color = colors[gl_VertexIndex];
+}
@@ -0,0 +1,24 @@
+#version 450
+
+struct Object {
+    mat4 transform;
+    vec4 bounding_sphere;
+    uint index_count;
+    uint first_index;
+    int vertex_offset;
+    uint padding;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Objects { Object objects[]; };
+layout(std430, set = 0, binding = 3) readonly buffer Vertices { vec4 positions[]; };
+
+layout(push_constant) uniform Camera { mat4 view_projection; };
+
+layout(location = 0) out vec3 fragment_color;
+
+// cull.comp writes the object index as the firstInstance of each draw
+void main() {
+    Object object = objects[gl_InstanceIndex];
+    gl_Position = view_projection * object.transform * vec4(positions[gl_VertexIndex].xyz, 1.0);
+    fragment_color = fract(vec3(0.13, 0.37, 0.71) * float(gl_InstanceIndex + 1));
+}
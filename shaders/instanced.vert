@@ -0,0 +1,14 @@
+#version 450
+
+// Per instance, the offset of the triangle in xy and its scale in z
+layout(location = 0) in vec4 instance;
+
+layout(location = 0) out vec3 fragment_color;
+
+const vec2 positions[3] = vec2[](vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+const vec3 colors[3] = vec3[](vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0));
+
+void main() {
+    gl_Position = vec4(positions[gl_VertexIndex] * instance.z + instance.xy, 0.0, 1.0);
+    fragment_color = colors[gl_VertexIndex];
+}
@@ -0,0 +1,83 @@
+#include "arena.h"
+
+#include <algorithm>
+
+namespace core {
+Arena* CreateArena(ArenaInfo info) {
+    auto arena = new Arena{};
+    arena::Initialize(arena, info);
+    return arena;
+}
+void DestroyArena(Arena* arena) {
+    arena::Finalize(arena);
+    delete arena;
+}
+namespace arena {
+void Initialize(Arena* arena, ArenaInfo info) {
+    arena->info = info;
+    arena->blocks = {};
+    arena->block = 0;
+    arena->offset = 0;
+}
+void Finalize(Arena* arena) {
+    for (ArenaBlock& block : arena->blocks) {
+        ::operator delete(block.memory);
+    }
+    arena->blocks = {};
+    arena->block = 0;
+    arena->offset = 0;
+}
+
+void* Allocate(Arena* arena, size_t size, size_t alignment) {
+    while (arena->block < arena->blocks.size()) {
+        ArenaBlock& block = arena->blocks[arena->block];
+        uintptr_t base = (uintptr_t)block.memory;
+        size_t offset = ((base + arena->offset + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+        if (offset + size <= block.size) {
+            arena->offset = offset + size;
+            return block.memory + offset;
+        }
+        // The rest of the block is wasted until the next reset, kept blocks are tried before growing
+        arena->block++;
+        arena->offset = 0;
+    }
+    ArenaBlock block{};
+    block.size = std::max(arena->info.block_size, size + alignment);
+    block.memory = static_cast<uint8_t*>(::operator new(block.size));
+    arena->blocks.emplace_back(block);
+    arena->block = (uint32_t)arena->blocks.size() - 1;
+    arena->offset = 0;
+    return Allocate(arena, size, alignment);
+}
+void Reset(Arena* arena) {
+    arena->block = 0;
+    arena->offset = 0;
+}
+ArenaMark Mark(Arena* arena) {
+    return {arena->block, arena->offset};
+}
+void Rewind(Arena* arena, ArenaMark mark) {
+    arena->block = mark.block;
+    arena->offset = mark.offset;
+}
+size_t Capacity(Arena* arena) {
+    size_t capacity = 0;
+    for (ArenaBlock& block : arena->blocks) {
+        capacity += block.size;
+    }
+    return capacity;
+}
+} // namespace arena
+
+namespace {
+// Owns the scratch arena of a thread, its blocks are freed when the thread exits
+struct ThreadScratchArena {
+    Arena arena{};
+    ~ThreadScratchArena() { arena::Finalize(&arena); }
+};
+} // namespace
+Arena* ScratchArena() {
+    thread_local ThreadScratchArena scratch{};
+    return &scratch.arena;
+}
+} // namespace core
@@ -0,0 +1,540 @@
+#include "asset.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef ASSET_ENABLE_LZ4
+#include <lz4.h>
+#endif
+#ifdef ASSET_ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+ASSET_LOGGER_DEFINITION
+namespace asset {
+uint64_t HashPath(std::string_view path) {
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (char character : path) {
+        hash ^= (uint8_t)character;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+std::string_view NormalizePath(std::string_view path) {
+    while (path.size() > 0 && path.front() == '/') {
+        path.remove_prefix(1);
+    }
+    while (path.size() > 1 && path[0] == '.' && path[1] == '/') {
+        path.remove_prefix(2);
+    }
+    return path;
+}
+
+namespace compression {
+bool Decompress(Compression compression, const char* source, size_t source_size, char* destination,
+                size_t destination_size) {
+    switch (compression) {
+    case COMPRESSION_NONE: {
+        if (source_size != destination_size) {
+            return false;
+        }
+        memcpy(destination, source, source_size);
+        return true;
+    }
+    case COMPRESSION_LZ4: {
+#ifdef ASSET_ENABLE_LZ4
+        int size = LZ4_decompress_safe(source, destination, (int)source_size, (int)destination_size);
+        return size >= 0 && (size_t)size == destination_size;
+#else
+        ASSET_LOG_ERROR("DECOMPRESSION: Engine Built Without LZ4 Support!");
+        return false;
+#endif
+    }
+    case COMPRESSION_ZSTD: {
+#ifdef ASSET_ENABLE_ZSTD
+        size_t size = ZSTD_decompress(destination, destination_size, source, source_size);
+        return !ZSTD_isError(size) && size == destination_size;
+#else
+        ASSET_LOG_ERROR("DECOMPRESSION: Engine Built Without ZSTD Support!");
+        return false;
+#endif
+    }
+    }
+    return false;
+}
+// Returns false when the codec is unavailable or does not shrink the data, the caller then stores it raw
+// Without LZ4 and ZSTD nothing reads the data
+bool Compress(Compression compression, [[maybe_unused]] const std::vector<char>& source,
+              [[maybe_unused]] std::vector<char>* destination) {
+    switch (compression) {
+    case COMPRESSION_NONE: {
+        return false;
+    }
+    case COMPRESSION_LZ4: {
+#ifdef ASSET_ENABLE_LZ4
+        destination->resize(LZ4_compressBound((int)source.size()));
+        int size = LZ4_compress_default(source.data(), destination->data(), (int)source.size(),
+                                        (int)destination->size());
+        if (size <= 0 || (size_t)size >= source.size()) {
+            return false;
+        }
+        destination->resize(size);
+        return true;
+#else
+        return false;
+#endif
+    }
+    case COMPRESSION_ZSTD: {
+#ifdef ASSET_ENABLE_ZSTD
+        destination->resize(ZSTD_compressBound(source.size()));
+        size_t size = ZSTD_compress(destination->data(), destination->size(), source.data(), source.size(), 19);
+        if (ZSTD_isError(size) || size >= source.size()) {
+            return false;
+        }
+        destination->resize(size);
+        return true;
+#else
+        return false;
+#endif
+    }
+    }
+    return false;
+}
+} // namespace compression
+
+bool ReadHostFile(const std::string& filepath, File* file) {
+    int file_descriptor = open(filepath.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        return false;
+    }
+    struct stat file_stat {};
+    if (fstat(file_descriptor, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        close(file_descriptor);
+        return false;
+    }
+    file->storage.resize(file_stat.st_size);
+    size_t total = 0;
+    while (total < file->storage.size()) {
+        ssize_t count = read(file_descriptor, file->storage.data() + total, file->storage.size() - total);
+        if (count <= 0) {
+            break;
+        }
+        total += count;
+    }
+    close(file_descriptor);
+    if (total != file->storage.size()) {
+        return false;
+    }
+    file->data = file->storage.data();
+    file->size = file->storage.size();
+    return true;
+}
+
+namespace archive {
+// Whether [offset, offset + size) lies within [0, limit), without overflowing on hostile values
+bool InRange(uint64_t offset, uint64_t size, uint64_t limit) { return offset <= limit && size <= limit - offset; }
+bool ValidEntry(Archive* archive, const ArchiveEntry* entry) {
+    if (!InRange(entry->data_offset, entry->data_size, archive->mapping_size) ||
+        !InRange(entry->path_offset, entry->path_size, archive->header->string_size)) {
+        return false;
+    }
+    // Uncompressed entries are served as views of exactly their stored bytes
+    if (entry->compression == COMPRESSION_NONE) {
+        return entry->size == entry->data_size;
+    }
+    return entry->compression == COMPRESSION_LZ4 || entry->compression == COMPRESSION_ZSTD;
+}
+
+bool Initialize(Archive* archive, std::string filepath) {
+    archive->filepath = filepath;
+    archive->file_descriptor = open(filepath.c_str(), O_RDONLY);
+    if (archive->file_descriptor < 0) {
+        ASSET_LOG_ERROR("ARCHIVE OPEN: Failed to Open {}!", filepath);
+        return false;
+    }
+    struct stat file_stat {};
+    fstat(archive->file_descriptor, &file_stat);
+    archive->mapping_size = file_stat.st_size;
+    if (archive->mapping_size < sizeof(ArchiveHeader)) {
+        ASSET_LOG_ERROR("ARCHIVE OPEN: {} is Too Small to be an Archive!", filepath);
+        Finalize(archive);
+        return false;
+    }
+
+    archive->mapping = mmap(nullptr, archive->mapping_size, PROT_READ, MAP_PRIVATE, archive->file_descriptor, 0);
+    if (archive->mapping == MAP_FAILED) {
+        archive->mapping = nullptr;
+        ASSET_LOG_ERROR("ARCHIVE OPEN: Failed to Map {}!", filepath);
+        Finalize(archive);
+        return false;
+    }
+
+    auto base = reinterpret_cast<const char*>(archive->mapping);
+    archive->header = reinterpret_cast<const ArchiveHeader*>(base);
+    if (archive->header->magic != ASSET_ARCHIVE_MAGIC || archive->header->version != ASSET_ARCHIVE_VERSION) {
+        ASSET_LOG_ERROR("ARCHIVE OPEN: {} Has an Unrecognized Header!", filepath);
+        Finalize(archive);
+        return false;
+    }
+    uint64_t entry_table_size = archive->header->entry_count * sizeof(ArchiveEntry);
+    if (!InRange(archive->header->entry_offset, entry_table_size, archive->mapping_size) ||
+        !InRange(archive->header->string_offset, archive->header->string_size, archive->mapping_size)) {
+        ASSET_LOG_ERROR("ARCHIVE OPEN: {} is Truncated!", filepath);
+        Finalize(archive);
+        return false;
+    }
+    archive->entries = reinterpret_cast<const ArchiveEntry*>(base + archive->header->entry_offset);
+    archive->strings = base + archive->header->string_offset;
+
+    // The table of contents is touched on every lookup, entry data is touched once per load
+    madvise(const_cast<ArchiveEntry*>(archive->entries), entry_table_size, MADV_WILLNEED);
+
+    // Lookups and reads trust the table from here on, so one bad entry rejects the whole archive
+    for (uint32_t i = 0; i < archive->header->entry_count; i++) {
+        if (!ValidEntry(archive, &archive->entries[i])) {
+            ASSET_LOG_ERROR("ARCHIVE OPEN: {} Has an Entry Outside the Archive!", filepath);
+            Finalize(archive);
+            return false;
+        }
+    }
+    return true;
+}
+void Finalize(Archive* archive) {
+    if (archive->mapping != nullptr) {
+        munmap(archive->mapping, archive->mapping_size);
+        archive->mapping = nullptr;
+    }
+    if (archive->file_descriptor >= 0) {
+        close(archive->file_descriptor);
+        archive->file_descriptor = -1;
+    }
+    archive->header = nullptr;
+    archive->entries = nullptr;
+    archive->strings = nullptr;
+}
+
+std::string_view EntryPath(Archive* archive, const ArchiveEntry* entry) {
+    return std::string_view(archive->strings + entry->path_offset, entry->path_size);
+}
+const ArchiveEntry* Find(Archive* archive, std::string_view path) {
+    path = NormalizePath(path);
+    uint64_t hash = HashPath(path);
+
+    const ArchiveEntry* begin = archive->entries;
+    const ArchiveEntry* end = archive->entries + archive->header->entry_count;
+    auto iterator = std::lower_bound(begin, end, hash,
+                                     [](const ArchiveEntry& entry, uint64_t hash) { return entry.path_hash < hash; });
+    for (; iterator != end && iterator->path_hash == hash; iterator++) {
+        if (EntryPath(archive, iterator) == path) {
+            return iterator;
+        }
+    }
+    return nullptr;
+}
+
+bool Pack(PackInfo info) {
+    struct PackEntry {
+        std::string path;
+        std::vector<char> data;
+        uint64_t size;
+        Compression compression;
+    };
+    std::vector<PackEntry> pack_entries{};
+    std::error_code error{};
+    for (auto& directory_entry : std::filesystem::recursive_directory_iterator(info.directory, error)) {
+        if (!directory_entry.is_regular_file()) {
+            continue;
+        }
+        PackEntry pack_entry{};
+        pack_entry.path = std::filesystem::relative(directory_entry.path(), info.directory).generic_string();
+
+        File file{};
+        if (!ReadHostFile(directory_entry.path().string(), &file)) {
+            ASSET_LOG_ERROR("ARCHIVE PACK: Failed to Read {}!", directory_entry.path().string());
+            return false;
+        }
+        pack_entry.size = file.storage.size();
+        pack_entry.compression = COMPRESSION_NONE;
+        std::vector<char> compressed{};
+        if (compression::Compress(info.compression, file.storage, &compressed)) {
+            pack_entry.data = std::move(compressed);
+            pack_entry.compression = info.compression;
+        } else {
+            pack_entry.data = std::move(file.storage);
+        }
+        pack_entries.emplace_back(std::move(pack_entry));
+    }
+    if (error) {
+        ASSET_LOG_ERROR("ARCHIVE PACK: Failed to Walk {}!", info.directory);
+        return false;
+    }
+    std::sort(pack_entries.begin(), pack_entries.end(), [](const PackEntry& a, const PackEntry& b) {
+        uint64_t hash_a = HashPath(a.path);
+        uint64_t hash_b = HashPath(b.path);
+        return hash_a != hash_b ? hash_a < hash_b : a.path < b.path;
+    });
+
+    auto align = [&info](uint64_t offset) { return (offset + info.alignment - 1) / info.alignment * info.alignment; };
+
+    std::ofstream output(info.output_filepath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        ASSET_LOG_ERROR("ARCHIVE PACK: Failed to Open {}!", info.output_filepath);
+        return false;
+    }
+    std::vector<ArchiveEntry> entries{};
+    std::string strings{};
+    uint64_t offset = align(sizeof(ArchiveHeader));
+    for (PackEntry& pack_entry : pack_entries) {
+        ArchiveEntry entry{};
+        entry.path_hash = HashPath(pack_entry.path);
+        entry.path_offset = (uint32_t)strings.size();
+        entry.path_size = (uint32_t)pack_entry.path.size();
+        entry.data_offset = offset;
+        entry.data_size = pack_entry.data.size();
+        entry.size = pack_entry.size;
+        entry.compression = pack_entry.compression;
+        entries.emplace_back(entry);
+        strings += pack_entry.path;
+
+        output.seekp(offset);
+        output.write(pack_entry.data.data(), pack_entry.data.size());
+        offset = align(offset + pack_entry.data.size());
+    }
+
+    ArchiveHeader header{};
+    header.magic = ASSET_ARCHIVE_MAGIC;
+    header.version = ASSET_ARCHIVE_VERSION;
+    header.entry_count = (uint32_t)entries.size();
+    header.alignment = info.alignment;
+    header.entry_offset = offset;
+    header.string_offset = offset + entries.size() * sizeof(ArchiveEntry);
+    header.string_size = strings.size();
+
+    output.seekp(header.entry_offset);
+    output.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ArchiveEntry));
+    output.write(strings.data(), strings.size());
+    output.seekp(0);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(ArchiveHeader));
+    if (!output) {
+        ASSET_LOG_ERROR("ARCHIVE PACK: Failed to Write {}!", info.output_filepath);
+        return false;
+    }
+    ASSET_LOG_INFO("ARCHIVE PACK: Packed {} Files Into {}", entries.size(), info.output_filepath);
+    return true;
+}
+} // namespace archive
+Archive* OpenArchive(std::string filepath) {
+    auto archive = new Archive{};
+    if (!archive::Initialize(archive, filepath)) {
+        delete archive;
+        return nullptr;
+    }
+    return archive;
+}
+void CloseArchive(Archive* archive) {
+    archive::Finalize(archive);
+    delete archive;
+}
+
+namespace vfs {
+std::shared_mutex mount_mutex{};
+std::vector<Mount> mounts{};
+
+// Strips the mount point from path, returns false when path does not live under it
+bool ResolveMountPath(const Mount& mount, std::string_view path, std::string_view* relative_path) {
+    if (mount.mount_point.empty()) {
+        *relative_path = path;
+        return true;
+    }
+    if (path.size() <= mount.mount_point.size() || path.compare(0, mount.mount_point.size(), mount.mount_point) != 0 ||
+        path[mount.mount_point.size()] != '/') {
+        return false;
+    }
+    *relative_path = path.substr(mount.mount_point.size() + 1);
+    return true;
+}
+bool ReadArchiveEntry(Archive* archive, const ArchiveEntry* entry, File* file) {
+    const char* source = reinterpret_cast<const char*>(archive->mapping) + entry->data_offset;
+    if (entry->compression == COMPRESSION_NONE) {
+        file->storage.clear();
+        file->data = source;
+        file->size = entry->size;
+        return true;
+    }
+    file->storage.resize(entry->size);
+    if (!compression::Decompress(entry->compression, source, entry->data_size, file->storage.data(), entry->size)) {
+        ASSET_LOG_ERROR("VFS READ: Failed to Decompress {}!", archive::EntryPath(archive, entry));
+        return false;
+    }
+    file->data = file->storage.data();
+    file->size = file->storage.size();
+    return true;
+}
+
+void MountDirectory(std::string mount_point, std::string directory) {
+    std::unique_lock lock(mount_mutex);
+    mounts.emplace_back(Mount{MOUNT_TYPE_DIRECTORY, std::string(NormalizePath(mount_point)), directory, nullptr});
+}
+bool MountArchive(std::string mount_point, std::string filepath) {
+    Archive* archive = OpenArchive(filepath);
+    if (archive == nullptr) {
+        return false;
+    }
+    std::unique_lock lock(mount_mutex);
+    mounts.emplace_back(Mount{MOUNT_TYPE_ARCHIVE, std::string(NormalizePath(mount_point)), "", archive});
+    return true;
+}
+void Unmount(std::string mount_point) {
+    std::unique_lock lock(mount_mutex);
+    mount_point = std::string(NormalizePath(mount_point));
+    for (auto iterator = mounts.begin(); iterator != mounts.end();) {
+        if (iterator->mount_point == mount_point) {
+            if (iterator->archive != nullptr) {
+                CloseArchive(iterator->archive);
+            }
+            iterator = mounts.erase(iterator);
+        } else {
+            iterator++;
+        }
+    }
+}
+
+bool Exists(std::string_view path) {
+    std::string_view normalized_path = NormalizePath(path);
+    {
+        std::shared_lock lock(mount_mutex);
+        for (auto mount = mounts.rbegin(); mount != mounts.rend(); mount++) {
+            std::string_view relative_path;
+            if (!ResolveMountPath(*mount, normalized_path, &relative_path)) {
+                continue;
+            }
+            if (mount->type == MOUNT_TYPE_ARCHIVE && archive::Find(mount->archive, relative_path) != nullptr) {
+                return true;
+            }
+            if (mount->type == MOUNT_TYPE_DIRECTORY &&
+                std::filesystem::is_regular_file(std::filesystem::path(mount->directory) / relative_path)) {
+                return true;
+            }
+        }
+    }
+    return std::filesystem::is_regular_file(std::string(path));
+}
+bool HostPath(std::string_view path, std::string* host_path) {
+    std::string_view normalized_path = NormalizePath(path);
+    {
+        std::shared_lock lock(mount_mutex);
+        for (auto mount = mounts.rbegin(); mount != mounts.rend(); mount++) {
+            std::string_view relative_path;
+            if (!ResolveMountPath(*mount, normalized_path, &relative_path)) {
+                continue;
+            }
+            if (mount->type == MOUNT_TYPE_ARCHIVE && archive::Find(mount->archive, relative_path) != nullptr) {
+                return false;
+            }
+            std::filesystem::path filepath = std::filesystem::path(mount->directory) / relative_path;
+            if (mount->type == MOUNT_TYPE_DIRECTORY && std::filesystem::is_regular_file(filepath)) {
+                *host_path = filepath.string();
+                return true;
+            }
+        }
+    }
+    if (!std::filesystem::is_regular_file(std::string(path))) {
+        return false;
+    }
+    *host_path = std::string(path);
+    return true;
+}
+bool Read(std::string_view path, File* file) {
+    std::string_view normalized_path = NormalizePath(path);
+    {
+        std::shared_lock lock(mount_mutex);
+        for (auto mount = mounts.rbegin(); mount != mounts.rend(); mount++) {
+            std::string_view relative_path;
+            if (!ResolveMountPath(*mount, normalized_path, &relative_path)) {
+                continue;
+            }
+            if (mount->type == MOUNT_TYPE_ARCHIVE) {
+                const ArchiveEntry* entry = archive::Find(mount->archive, relative_path);
+                if (entry != nullptr) {
+                    return ReadArchiveEntry(mount->archive, entry, file);
+                }
+            } else if (ReadHostFile((std::filesystem::path(mount->directory) / relative_path).string(), file)) {
+                return true;
+            }
+        }
+    }
+    // Paths that no mount resolves fall through to the host filesystem as given
+    return ReadHostFile(std::string(path), file);
+}
+
+bool LocateHostFile(const std::string& filepath, FileLocation* location) {
+    int file_descriptor = open(filepath.c_str(), O_RDONLY);
+    if (file_descriptor < 0) {
+        return false;
+    }
+    struct stat file_stat {};
+    if (fstat(file_descriptor, &file_stat) != 0 || !S_ISREG(file_stat.st_mode)) {
+        close(file_descriptor);
+        return false;
+    }
+    *location = FileLocation{};
+    location->file_descriptor = file_descriptor;
+    location->owns_file_descriptor = true;
+    location->stored_size = file_stat.st_size;
+    location->size = file_stat.st_size;
+    return true;
+}
+bool Locate(std::string_view path, FileLocation* location) {
+    std::string_view normalized_path = NormalizePath(path);
+    {
+        std::shared_lock lock(mount_mutex);
+        for (auto mount = mounts.rbegin(); mount != mounts.rend(); mount++) {
+            std::string_view relative_path;
+            if (!ResolveMountPath(*mount, normalized_path, &relative_path)) {
+                continue;
+            }
+            if (mount->type == MOUNT_TYPE_ARCHIVE) {
+                const ArchiveEntry* entry = archive::Find(mount->archive, relative_path);
+                if (entry != nullptr) {
+                    *location = FileLocation{};
+                    location->file_descriptor = mount->archive->file_descriptor;
+                    location->offset = entry->data_offset;
+                    location->stored_size = entry->data_size;
+                    location->size = entry->size;
+                    location->compression = entry->compression;
+                    location->mapping = reinterpret_cast<const char*>(mount->archive->mapping) + entry->data_offset;
+                    return true;
+                }
+            } else if (LocateHostFile((std::filesystem::path(mount->directory) / relative_path).string(), location)) {
+                return true;
+            }
+        }
+    }
+    return LocateHostFile(std::string(path), location);
+}
+void Release(FileLocation* location) {
+    if (location->owns_file_descriptor && location->file_descriptor >= 0) {
+        close(location->file_descriptor);
+    }
+    *location = FileLocation{};
+}
+
+void Finalize() {
+    std::unique_lock lock(mount_mutex);
+    for (Mount& mount : mounts) {
+        if (mount.archive != nullptr) {
+            CloseArchive(mount.archive);
+        }
+    }
+    mounts.clear();
+}
+} // namespace vfs
+} // namespace asset
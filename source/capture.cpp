@@ -0,0 +1,269 @@
+#include "capture.h"
+
+#include <algorithm>
+#include <filesystem>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace render {
+namespace {
+const uint32_t BYTES_PER_PIXEL = 4;
+
+bool CapturableFormat(VkFormat format, bool* bgra) {
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+        *bgra = false;
+        return true;
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+        *bgra = true;
+        return true;
+    default:
+        return false;
+    }
+}
+// The bytes of sRGB formats are already encoded, so they are written as they are
+std::vector<uint8_t> ConvertRGBA(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra) {
+    std::vector<uint8_t> rgba(pixels, pixels + (size_t)width * height * BYTES_PER_PIXEL);
+    if (bgra) {
+        for (size_t i = 0; i < rgba.size(); i += BYTES_PER_PIXEL) {
+            std::swap(rgba[i], rgba[i + 2]);
+        }
+    }
+    return rgba;
+}
+// BT.601 limited range, chroma is the average of each 2x2 block
+std::vector<uint8_t> ConvertI420(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra) {
+    uint32_t chroma_width = (width + 1) / 2;
+    uint32_t chroma_height = (height + 1) / 2;
+    std::vector<uint8_t> yuv((size_t)width * height + 2 * (size_t)chroma_width * chroma_height);
+    uint8_t* y_plane = yuv.data();
+    uint8_t* u_plane = y_plane + (size_t)width * height;
+    uint8_t* v_plane = u_plane + (size_t)chroma_width * chroma_height;
+    uint32_t r_offset = bgra ? 2 : 0;
+    uint32_t b_offset = bgra ? 0 : 2;
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = pixels + (size_t)y * width * BYTES_PER_PIXEL;
+        for (uint32_t x = 0; x < width; x++) {
+            const uint8_t* pixel = row + x * BYTES_PER_PIXEL;
+            int32_t r = pixel[r_offset], g = pixel[1], b = pixel[b_offset];
+            y_plane[(size_t)y * width + x] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+    for (uint32_t y = 0; y < chroma_height; y++) {
+        for (uint32_t x = 0; x < chroma_width; x++) {
+            int32_t r = 0, g = 0, b = 0, count = 0;
+            for (uint32_t sample_y = y * 2; sample_y < std::min(y * 2 + 2, height); sample_y++) {
+                for (uint32_t sample_x = x * 2; sample_x < std::min(x * 2 + 2, width); sample_x++) {
+                    const uint8_t* pixel = pixels + ((size_t)sample_y * width + sample_x) * BYTES_PER_PIXEL;
+                    r += pixel[r_offset];
+                    g += pixel[1];
+                    b += pixel[b_offset];
+                    count++;
+                }
+            }
+            r /= count;
+            g /= count;
+            b /= count;
+            u_plane[(size_t)y * chroma_width + x] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            v_plane[(size_t)y * chroma_width + x] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    return yuv;
+}
+// Called with the mutex held, writes every frame that no earlier frame is still missing for
+void WriteConvertedFrames(Capturer* capturer) {
+    for (auto iterator = capturer->converted_frames.find(capturer->next_write_sequence);
+         iterator != capturer->converted_frames.end();
+         iterator = capturer->converted_frames.find(capturer->next_write_sequence)) {
+        std::vector<uint8_t>& data = iterator->second;
+        if (capturer->file != nullptr && fwrite(data.data(), 1, data.size(), capturer->file) == data.size()) {
+            capturer->statistics.encoded_frames++;
+        } else {
+            capturer->statistics.failed_frames++;
+            RENDER_LOG_RATE_LIMITED(ERROR, 1000, "CAPTURE: Failed to Write Frame {}!", iterator->first);
+        }
+        capturer->converted_frames.erase(iterator);
+        capturer->next_write_sequence++;
+    }
+}
+void Encode(Capturer* capturer, Readback* readback, uint64_t sequence) {
+    CORE_TRACE_ZONE("capture::Encode");
+    buffer::Invalidate(readback->buffer);
+    auto pixels = static_cast<const uint8_t*>(readback->buffer->mapping);
+    uint32_t width = readback->extent.x;
+    uint32_t height = readback->extent.y;
+    bool bgra = false;
+    CapturableFormat(readback->format, &bgra);
+
+    if (capturer->info.format == CAPTURE_FORMAT_PNG) {
+        std::vector<uint8_t> rgba = ConvertRGBA(pixels, width, height, bgra);
+        // The readback is free again before the slow part, which keeps drops down while encoding lags
+        readback_pool::Release(capturer->readback_pool, readback);
+
+        char number[32];
+        snprintf(number, sizeof(number), "%06llu.png", (unsigned long long)sequence);
+        bool written = stbi_write_png((capturer->info.output + number).c_str(), (int)width, (int)height,
+                                      BYTES_PER_PIXEL, rgba.data(), (int)(width * BYTES_PER_PIXEL)) != 0;
+        std::lock_guard<std::mutex> lock(capturer->mutex);
+        if (written) {
+            capturer->statistics.encoded_frames++;
+        } else {
+            capturer->statistics.failed_frames++;
+            RENDER_LOG_RATE_LIMITED(ERROR, 1000, "CAPTURE: Failed to Write Frame {}!", sequence);
+        }
+    } else {
+        std::vector<uint8_t> yuv = ConvertI420(pixels, width, height, bgra);
+        readback_pool::Release(capturer->readback_pool, readback);
+
+        std::lock_guard<std::mutex> lock(capturer->mutex);
+        capturer->converted_frames[sequence] = std::move(yuv);
+        WriteConvertedFrames(capturer);
+    }
+
+    std::lock_guard<std::mutex> lock(capturer->mutex);
+    capturer->encoding_count--;
+    capturer->idle_condition_variable.notify_all();
+}
+void Retire(Capturer* capturer, CaptureFrame retired) {
+    if (!retired.recorded) {
+        readback_pool::Release(capturer->readback_pool, retired.readback);
+        std::lock_guard<std::mutex> lock(capturer->mutex);
+        capturer->statistics.dropped_frames++;
+        return;
+    }
+    Extent3D extent = retired.readback->extent;
+    if (capturer->info.format == CAPTURE_FORMAT_YUV) {
+        if (capturer->stream_extent.x == 0) {
+            capturer->stream_extent = extent;
+        } else if (extent.x != capturer->stream_extent.x || extent.y != capturer->stream_extent.y) {
+            RENDER_LOG_RATE_LIMITED(WARN, 1000, "CAPTURE: Dropped {}x{} Frame, Raw Video Keeps Its First Size!",
+                                    extent.x, extent.y);
+            retired.recorded = false;
+            Retire(capturer, retired);
+            return;
+        }
+    }
+    uint64_t sequence = capturer->next_sequence++;
+    {
+        std::lock_guard<std::mutex> lock(capturer->mutex);
+        capturer->statistics.captured_frames++;
+        capturer->encoding_count++;
+    }
+    Readback* readback = retired.readback;
+    if (capturer->info.thread_pool == nullptr) {
+        Encode(capturer, readback, sequence);
+        return;
+    }
+    core::threadpool::Enqueue(
+        capturer->info.thread_pool, [capturer, readback, sequence]() { Encode(capturer, readback, sequence); },
+        core::JOB_PRIORITY_LOW);
+}
+} // namespace
+
+Capturer* CreateCapturer(CaptureInfo info) {
+    auto capturer = new Capturer{};
+    if (info.buffer_count == 0) {
+        info.buffer_count = frames_in_flight + 2;
+    }
+    capturer->info = info;
+    capturer->readback_pool = CreateReadbackPool({info.buffer_size, info.buffer_count});
+
+    if (info.format == CAPTURE_FORMAT_PNG) {
+        std::filesystem::path directory = std::filesystem::path(info.output).parent_path();
+        std::error_code error{};
+        if (!directory.empty() && !std::filesystem::create_directories(directory, error) && error) {
+            RENDER_LOG_ERROR("CAPTURE: Failed to Create Directory {}!", directory.string());
+        }
+    } else {
+        capturer->file_is_pipe = !info.output.empty() && info.output[0] == '|';
+        capturer->file =
+            capturer->file_is_pipe ? popen(info.output.c_str() + 1, "w") : fopen(info.output.c_str(), "wb");
+        if (capturer->file == nullptr) {
+            RENDER_LOG_ERROR("CAPTURE: Failed to Open {}!", info.output);
+        }
+    }
+    return capturer;
+}
+void DestroyCapturer(Capturer* capturer) {
+    // With the device idle every pending frame has retired
+    while (!capturer->pending_frames.empty()) {
+        CaptureFrame retired = capturer->pending_frames.front();
+        capturer->pending_frames.pop_front();
+        Retire(capturer, retired);
+    }
+    {
+        std::unique_lock<std::mutex> lock(capturer->mutex);
+        capturer->idle_condition_variable.wait(lock, [capturer]() { return capturer->encoding_count == 0; });
+    }
+    if (capturer->file != nullptr) {
+        if (capturer->file_is_pipe) {
+            pclose(capturer->file);
+        } else {
+            fclose(capturer->file);
+        }
+    }
+
+    CaptureStatistics statistics = capturer->statistics;
+    RENDER_LOG_INFO("CAPTURE: {} Frames Captured, {} Encoded, {} Dropped, {} Failed", statistics.captured_frames,
+                    statistics.encoded_frames, statistics.dropped_frames, statistics.failed_frames);
+    DestroyReadbackPool(capturer->readback_pool);
+    delete capturer;
+}
+namespace capturer {
+CaptureFrame* BeginFrame(Capturer* capturer) {
+    CORE_TRACE_ZONE("capturer::BeginFrame");
+    // Like a retired destruction, the frame that recorded a copy is done once its slot comes around
+    while (!capturer->pending_frames.empty() && capturer->pending_frames.front().frame + frames_in_flight <= frame) {
+        CaptureFrame retired = capturer->pending_frames.front();
+        capturer->pending_frames.pop_front();
+        Retire(capturer, retired);
+    }
+
+    Readback* readback = readback_pool::TryAcquire(capturer->readback_pool);
+    if (readback == nullptr) {
+        std::lock_guard<std::mutex> lock(capturer->mutex);
+        capturer->statistics.dropped_frames++;
+        RENDER_LOG_RATE_LIMITED(WARN, 1000, "CAPTURE: Dropped Frame {}, Every Readback Is In Use!", frame);
+        return nullptr;
+    }
+    // Elements of a deque stay in place as others are pushed and popped, the recording thread keeps a pointer
+    capturer->pending_frames.push_back({readback, frame, false});
+    return &capturer->pending_frames.back();
+}
+CaptureStatistics GetStatistics(Capturer* capturer) {
+    std::lock_guard<std::mutex> lock(capturer->mutex);
+    return capturer->statistics;
+}
+} // namespace capturer
+
+namespace command {
+void Capture(CommandBuffer* command_buffer, Capturer* capturer, CaptureFrame* frame, VkImage vk_image,
+             Extent3D extent, VkFormat format, VkImageLayout layout, Fence* fence) {
+    if (frame == nullptr) {
+        return;
+    }
+    bool bgra = false;
+    if (!CapturableFormat(format, &bgra)) {
+        RENDER_LOG_RATE_LIMITED(ERROR, 1000, "CAPTURE: Format {} Cannot Be Captured!", (int)format);
+        return;
+    }
+    if ((VkDeviceSize)extent.x * extent.y * BYTES_PER_PIXEL > frame->readback->buffer->size) {
+        RENDER_LOG_RATE_LIMITED(WARN, 1000, "CAPTURE: {}x{} Frame Does Not Fit the Readback Buffers!", extent.x,
+                                extent.y);
+        return;
+    }
+    readback_pool::RecordCopy(command_buffer, frame->readback, vk_image, {extent.x, extent.y, 1}, format, layout,
+                              fence);
+    frame->recorded = true;
+}
+} // namespace command
+} // namespace render
@@ -0,0 +1,122 @@
+#include "compute.h"
+
+#include <cassert>
+
+#include "stats.h"
+
+namespace render {
+namespace {
+VkDescriptorType VkDescriptorTypeOf(BindingType type) {
+    switch (type) {
+    case BINDING_TYPE_STORAGE_BUFFER:
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    case BINDING_TYPE_UNIFORM_BUFFER:
+        return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    case BINDING_TYPE_STORAGE_IMAGE:
+        return VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    }
+    return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+}
+} // namespace
+
+BindingSet* CreateBindingSet(BindingSetInfo info) {
+    auto set = new BindingSet{};
+    set->bindings = info.bindings;
+
+    std::vector<VkDescriptorSetLayoutBinding> layout_bindings(info.bindings.size());
+    std::vector<VkDescriptorPoolSize> pool_sizes{};
+    for (uint32_t i = 0; i < info.bindings.size(); i++) {
+        VkDescriptorType type = VkDescriptorTypeOf(info.bindings[i]);
+        layout_bindings[i].binding = i;
+        layout_bindings[i].descriptorType = type;
+        layout_bindings[i].descriptorCount = 1;
+        layout_bindings[i].stageFlags = info.stages;
+        pool_sizes.push_back({type, 1});
+    }
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = (uint32_t)layout_bindings.size();
+    layout_info.pBindings = layout_bindings.data();
+    if (vkCreateDescriptorSetLayout(context.vk_device, &layout_info, nullptr, &set->vk_descriptor_set_layout) !=
+        VK_SUCCESS) {
+        RENDER_LOG_ERROR("BINDING SET CREATION: Failed to Create VkDescriptorSetLayout!");
+    }
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = (uint32_t)pool_sizes.size();
+    pool_info.pPoolSizes = pool_sizes.data();
+    if (vkCreateDescriptorPool(context.vk_device, &pool_info, nullptr, &set->vk_descriptor_pool) != VK_SUCCESS) {
+        RENDER_LOG_ERROR("BINDING SET CREATION: Failed to Create VkDescriptorPool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = set->vk_descriptor_pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &set->vk_descriptor_set_layout;
+    if (vkAllocateDescriptorSets(context.vk_device, &allocate_info, &set->vk_descriptor_set) != VK_SUCCESS) {
+        RENDER_LOG_ERROR("BINDING SET CREATION: Failed to Allocate VkDescriptorSet!");
+    }
+    return set;
+}
+void DestroyBindingSet(BindingSet* set) {
+    // The set is freed with its pool
+    vkDestroyDescriptorPool(context.vk_device, set->vk_descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(context.vk_device, set->vk_descriptor_set_layout, nullptr);
+    delete set;
+}
+namespace binding_set {
+void Write(BindingSet* set, uint32_t binding, Buffer* buffer) {
+    assert(binding < set->bindings.size() && set->bindings[binding] != BINDING_TYPE_STORAGE_IMAGE);
+    assert(!buffer->defragmentable && "a defragmentation move would leave the set on the old VkBuffer");
+    VkDescriptorBufferInfo buffer_info{buffer->vk_buffer, 0, VK_WHOLE_SIZE};
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set->vk_descriptor_set;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = VkDescriptorTypeOf(set->bindings[binding]);
+    write.pBufferInfo = &buffer_info;
+    vkUpdateDescriptorSets(context.vk_device, 1, &write, 0, nullptr);
+}
+void Write(BindingSet* set, uint32_t binding, Image* image) {
+    assert(binding < set->bindings.size() && set->bindings[binding] == BINDING_TYPE_STORAGE_IMAGE);
+    assert(!image->defragmentable && "a defragmentation move would leave the set on the old VkImageView");
+    VkDescriptorImageInfo image_info{VK_NULL_HANDLE, image->vk_image_view, VK_IMAGE_LAYOUT_GENERAL};
+    VkWriteDescriptorSet write{};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = set->vk_descriptor_set;
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    write.pImageInfo = &image_info;
+    vkUpdateDescriptorSets(context.vk_device, 1, &write, 0, nullptr);
+}
+} // namespace binding_set
+
+namespace command {
+void BindBindingSet(CommandBuffer* command_buffer, Pipeline* pipeline, uint32_t index, BindingSet* set) {
+    vkCmdBindDescriptorSets(command_buffer->vk_command_buffer, pipeline->vk_bind_point, pipeline->vk_pipeline_layout,
+                            index, 1, &set->vk_descriptor_set, 0, nullptr);
+}
+void Dispatch(CommandBuffer* command_buffer, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z) {
+    vkCmdDispatch(command_buffer->vk_command_buffer, group_count_x, group_count_y, group_count_z);
+    stats::Count(STAT_DISPATCHES);
+}
+void DispatchIndirect(CommandBuffer* command_buffer, Buffer* buffer, VkDeviceSize offset) {
+    vkCmdDispatchIndirect(command_buffer->vk_command_buffer, buffer->vk_buffer, offset);
+    stats::Count(STAT_DISPATCHES);
+}
+void ComputeBarrier(CommandBuffer* command_buffer, VkPipelineStageFlags destination_stages,
+                    VkAccessFlags destination_access) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = destination_access;
+    vkCmdPipelineBarrier(command_buffer->vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, destination_stages,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+} // namespace command
+} // namespace render
@@ -0,0 +1,329 @@
+#include "defrag.h"
+
+#include <chrono>
+
+#include "render.h"
+
+namespace render {
+namespace {
+/* Guards the defragmentation_move of every buffer and image and the destroyed flag of every move, which
+ * Finalize reaches from any thread. Held across beginning and ending a pass too, so no allocation is freed
+ * while VMA hands out or takes back the moves. */
+std::mutex move_mutex{};
+
+void EndDefragmentation(Defragmenter* defragmenter) {
+    VmaDefragmentationStats stats{};
+    vmaEndDefragmentation(context.vma_allocator, defragmenter->vma_context, &stats);
+    defragmenter->vma_context = VK_NULL_HANDLE;
+    defragmenter->next_frame = frame + defragmenter->info.idle_frames;
+
+    defragmenter->statistics.bytes_moved += stats.bytesMoved;
+    defragmenter->statistics.bytes_freed += stats.bytesFreed;
+    defragmenter->statistics.allocations_moved += stats.allocationsMoved;
+    defragmenter->statistics.memory_blocks_freed += stats.deviceMemoryBlocksFreed;
+    defragmenter->statistics.defragmentation_count++;
+}
+// Called with move_mutex held
+void EndPass(Defragmenter* defragmenter) {
+    for (DefragmentationMove& move : defragmenter->pass.moves) {
+        // The pass has retired, so nothing reads the source any more
+        if (move.buffer != nullptr) {
+            vkDestroyBuffer(context.vk_device, move.vk_source_buffer, nullptr);
+        } else {
+            vkDestroyImageView(context.vk_device, move.vk_source_image_view, nullptr);
+            vkDestroyImage(context.vk_device, move.vk_source_image, nullptr);
+        }
+        if (move.destroyed) {
+            // Finalize left the destination to the pass, VMA frees the memory of both sides
+            if (move.buffer != nullptr) {
+                vkDestroyBuffer(context.vk_device, move.vk_destination_buffer, nullptr);
+            } else {
+                vkDestroyImageView(context.vk_device, move.vk_destination_image_view, nullptr);
+                vkDestroyImage(context.vk_device, move.vk_destination_image, nullptr);
+            }
+            move.vma_move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+        } else if (move.buffer != nullptr) {
+            move.buffer->defragmentation_move = nullptr;
+        } else {
+            move.image->defragmentation_move = nullptr;
+        }
+    }
+    defragmenter->pass.moves.clear();
+    defragmenter->pass_active = false;
+    defragmenter->statistics.pass_count++;
+
+    // The source allocations now own the destination memory, VK_SUCCESS when nothing is left to move
+    VkResult result =
+        vmaEndDefragmentationPass(context.vma_allocator, defragmenter->vma_context, &defragmenter->vma_pass);
+    if (result == VK_SUCCESS) {
+        EndDefragmentation(defragmenter);
+    }
+}
+// Creates the destination VkBuffer of a move, false when the buffer may not move
+bool PrepareBufferMove(Defragmenter* defragmenter, VmaDefragmentationMove* vma_move, Buffer* buffer) {
+    if (!buffer->defragmentable) {
+        return false;
+    }
+    VkBufferCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    create_info.pNext = nullptr;
+    create_info.size = buffer->size;
+    create_info.usage = buffer->usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer vk_buffer = VK_NULL_HANDLE;
+    if (vkCreateBuffer(context.vk_device, &create_info, nullptr, &vk_buffer) != VK_SUCCESS) {
+        RENDER_LOG_ERROR("DEFRAGMENTATION: Failed to Create VkBuffer!");
+        return false;
+    }
+    if (vmaBindBufferMemory(context.vma_allocator, vma_move->dstTmpAllocation, vk_buffer) != VK_SUCCESS) {
+        RENDER_LOG_ERROR("DEFRAGMENTATION: Failed to Bind VkBuffer!");
+        vkDestroyBuffer(context.vk_device, vk_buffer, nullptr);
+        return false;
+    }
+    DefragmentationMove move{};
+    move.buffer = buffer;
+    move.vma_move = vma_move;
+    move.vk_source_buffer = buffer->vk_buffer;
+    move.vk_destination_buffer = vk_buffer;
+    move.size = buffer->size;
+    defragmenter->pass.moves.push_back(move);
+    buffer->defragmentation_move = &defragmenter->pass.moves.back();
+    return true;
+}
+// Creates the destination VkImage and VkImageView of a move, false when the image may not move
+bool PrepareImageMove(Defragmenter* defragmenter, VmaDefragmentationMove* vma_move, Image* image) {
+    if (!image->defragmentable) {
+        return false;
+    }
+    VkImageCreateInfo create_info = image::VkCreateInfo(image);
+    VkImage vk_image = VK_NULL_HANDLE;
+    if (vkCreateImage(context.vk_device, &create_info, nullptr, &vk_image) != VK_SUCCESS) {
+        RENDER_LOG_ERROR("DEFRAGMENTATION: Failed to Create VkImage!");
+        return false;
+    }
+    if (vmaBindImageMemory(context.vma_allocator, vma_move->dstTmpAllocation, vk_image) != VK_SUCCESS) {
+        RENDER_LOG_ERROR("DEFRAGMENTATION: Failed to Bind VkImage!");
+        vkDestroyImage(context.vk_device, vk_image, nullptr);
+        return false;
+    }
+    DefragmentationMove move{};
+    move.image = image;
+    move.vma_move = vma_move;
+    move.vk_source_image = image->vk_image;
+    move.vk_source_image_view = image->vk_image_view;
+    move.vk_destination_image = vk_image;
+    move.vk_destination_image_view = image::CreateVkImageView(image, vk_image);
+    move.extent = image->extent;
+    move.aspect = image->aspect;
+    move.layout = image->layout;
+    defragmenter->pass.moves.push_back(move);
+    image->defragmentation_move = &defragmenter->pass.moves.back();
+    return true;
+}
+bool PrepareMove(Defragmenter* defragmenter, VmaDefragmentationMove* vma_move) {
+    VmaAllocationInfo allocation_info{};
+    vmaGetAllocationInfo(context.vma_allocator, vma_move->srcAllocation, &allocation_info);
+    // The user data of allocations made outside resource.cpp is null
+    auto resource_type = static_cast<ResourceType*>(allocation_info.pUserData);
+    if (resource_type == nullptr) {
+        return false;
+    }
+    // The type is the first member of both, so the user data points at the resource as well
+    if (*resource_type == RESOURCE_TYPE_BUFFER) {
+        return PrepareBufferMove(defragmenter, vma_move, reinterpret_cast<Buffer*>(resource_type));
+    }
+    return PrepareImageMove(defragmenter, vma_move, reinterpret_cast<Image*>(resource_type));
+}
+} // namespace
+
+Defragmenter* CreateDefragmenter(DefragmenterInfo info) {
+    auto defragmenter = new Defragmenter{};
+    defragmenter->info = info;
+    defragmenter->next_frame = frame + info.idle_frames;
+    return defragmenter;
+}
+void DestroyDefragmenter(Defragmenter* defragmenter) {
+    std::lock_guard<std::mutex> lock(move_mutex);
+    if (defragmenter->pass_active) {
+        EndPass(defragmenter);
+    }
+    if (defragmenter->vma_context != VK_NULL_HANDLE) {
+        EndDefragmentation(defragmenter);
+    }
+    delete defragmenter;
+}
+namespace defragmenter {
+DefragmentationPass* BeginFrame(Defragmenter* defragmenter) {
+    CORE_TRACE_ZONE("defragmenter::BeginFrame");
+    std::lock_guard<std::mutex> lock(defragmenter->mutex);
+    std::unique_lock<std::mutex> move_lock(move_mutex);
+    if (defragmenter->pass_active) {
+        // Like a retired destruction, the frame that recorded the pass is done once its slot comes around
+        if (defragmenter->pass.frame + frames_in_flight > frame) {
+            return nullptr;
+        }
+        EndPass(defragmenter);
+    }
+
+    if (defragmenter->vma_context == VK_NULL_HANDLE) {
+        if (frame < defragmenter->next_frame) {
+            return nullptr;
+        }
+        VmaDefragmentationInfo defragmentation_info{};
+        defragmentation_info.flags = defragmenter->info.flags;
+        defragmentation_info.maxBytesPerPass = defragmenter->info.max_bytes_per_pass;
+        defragmentation_info.maxAllocationsPerPass = defragmenter->info.max_allocations_per_pass;
+        if (vmaBeginDefragmentation(context.vma_allocator, &defragmentation_info, &defragmenter->vma_context) !=
+            VK_SUCCESS) {
+            RENDER_LOG_ERROR("DEFRAGMENTATION: Failed to Begin Defragmentation!");
+            defragmenter->vma_context = VK_NULL_HANDLE;
+            defragmenter->next_frame = frame + defragmenter->info.idle_frames;
+            return nullptr;
+        }
+    }
+
+    VkResult result =
+        vmaBeginDefragmentationPass(context.vma_allocator, defragmenter->vma_context, &defragmenter->vma_pass);
+    if (result != VK_INCOMPLETE) {
+        EndDefragmentation(defragmenter);
+        return nullptr;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto budget = std::chrono::duration<double, std::milli>(defragmenter->info.max_milliseconds_per_pass);
+    // Resources point into the vector, it must not grow while the pass is active
+    defragmenter->pass.moves.reserve(defragmenter->vma_pass.moveCount);
+    for (uint32_t i = 0; i < defragmenter->vma_pass.moveCount; i++) {
+        VmaDefragmentationMove* vma_move = &defragmenter->vma_pass.pMoves[i];
+        if (std::chrono::steady_clock::now() - start_time > budget || !PrepareMove(defragmenter, vma_move)) {
+            vma_move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+        }
+    }
+    defragmenter->pass.frame = frame;
+    defragmenter->pass_active = true;
+
+    if (defragmenter->pass.moves.empty()) {
+        // Everything VMA picked has to stay, ending here instead of spinning on the same allocations every frame
+        EndPass(defragmenter);
+        if (defragmenter->vma_context != VK_NULL_HANDLE) {
+            EndDefragmentation(defragmenter);
+        }
+        return nullptr;
+    }
+
+    /* Earlier frames still recording read the source handles and are submitted before the copies, so they
+     * have to finish before the resources point elsewhere. A record closure may finalize a resource, which
+     * takes the move lock, so it is not held meanwhile. Frames from here on read the destinations, and the
+     * pass is recorded ahead of all of them. */
+    move_lock.unlock();
+    AwaitRecording();
+    move_lock.lock();
+    for (DefragmentationMove& move : defragmenter->pass.moves) {
+        if (move.destroyed) {
+            continue;
+        }
+        if (move.buffer != nullptr) {
+            move.buffer->vk_buffer = move.vk_destination_buffer;
+        } else {
+            move.image->vk_image = move.vk_destination_image;
+            move.image->vk_image_view = move.vk_destination_image_view;
+        }
+    }
+    return &defragmenter->pass;
+}
+DefragmenterStatistics GetStatistics(Defragmenter* defragmenter) {
+    std::lock_guard<std::mutex> lock(defragmenter->mutex);
+    return defragmenter->statistics;
+}
+} // namespace defragmenter
+
+namespace command {
+void Defragment(CommandBuffer* command_buffer, Defragmenter* defragmenter, DefragmentationPass* pass) {
+    if (pass == nullptr) {
+        return;
+    }
+    VkCommandBuffer vk_command_buffer = command_buffer->vk_command_buffer;
+
+    // Earlier frames on the queue may still write the sources
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+
+    // The pass is only read here, Finalize and the end of the pass touch the moves under their own lock
+    for (const DefragmentationMove& move : pass->moves) {
+        if (move.buffer != nullptr) {
+            VkBufferCopy region{0, 0, move.size};
+            vkCmdCopyBuffer(vk_command_buffer, move.vk_source_buffer, move.vk_destination_buffer, 1, &region);
+            continue;
+        }
+        // Undefined contents need no copy, the destination stays undefined like the source
+        if (move.layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+            continue;
+        }
+        VkImageMemoryBarrier image_barriers[2]{};
+        for (VkImageMemoryBarrier& image_barrier : image_barriers) {
+            image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            image_barrier.subresourceRange = {move.aspect, 0, 1, 0, 1};
+        }
+        image_barriers[0].image = move.vk_source_image;
+        image_barriers[0].oldLayout = move.layout;
+        image_barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        image_barriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        image_barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        image_barriers[1].image = move.vk_destination_image;
+        image_barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        image_barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, 2, image_barriers);
+
+        VkImageCopy region{};
+        region.srcSubresource = {move.aspect, 0, 0, 1};
+        region.dstSubresource = {move.aspect, 0, 0, 1};
+        region.extent = {move.extent.x, move.extent.y, std::max(move.extent.z, 1u)};
+        vkCmdCopyImage(vk_command_buffer, move.vk_source_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       move.vk_destination_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        // Back in the layout the image is known to be in, which is where the rest of the frame expects it
+        image_barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        image_barriers[1].newLayout = move.layout;
+        image_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        image_barriers[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                             0, nullptr, 0, nullptr, 1, &image_barriers[1]);
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+    vkCmdPipelineBarrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+}
+} // namespace command
+
+namespace defragmentation {
+void FinalizeBuffer(Buffer* buffer) {
+    std::lock_guard<std::mutex> lock(move_mutex);
+    if (buffer->defragmentation_move != nullptr) {
+        // The copy of the pass may still be in flight, the pass destroys both VkBuffers once it has retired
+        buffer->defragmentation_move->destroyed = true;
+        return;
+    }
+    vmaDestroyBuffer(context.vma_allocator, buffer->vk_buffer, buffer->vma_allocation);
+}
+void FinalizeImage(Image* image) {
+    std::lock_guard<std::mutex> lock(move_mutex);
+    if (image->defragmentation_move != nullptr) {
+        image->defragmentation_move->destroyed = true;
+        return;
+    }
+    vkDestroyImageView(context.vk_device, image->vk_image_view, nullptr);
+    vmaDestroyImage(context.vma_allocator, image->vk_image, image->vma_allocation);
+}
+} // namespace defragmentation
+} // namespace render
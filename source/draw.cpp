@@ -0,0 +1,251 @@
+#include "draw.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "stats.h"
+#include "trace.h"
+
+namespace render {
+namespace {
+const uint32_t RADIX_BITS = 8;
+const uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+// Below this a comparison sort beats clearing and walking the histograms
+const uint32_t RADIX_MINIMUM_COUNT = 256;
+
+/* Least significant digit first, each pass a stable counting sort of one byte. Passes where every key has
+ * the same byte are skipped, which with keys from draw_key::Pack is most of them: a frame rarely uses
+ * more than a few passes, pipelines and materials. Chunks histogram and scatter their own range, so the
+ * result is the same for any chunk count. */
+void RadixSort(core::ThreadPool* pool, uint32_t chunk_count, std::vector<DrawSortEntry>* entries,
+               std::vector<DrawSortEntry>* scratch) {
+    uint32_t count = (uint32_t)entries->size();
+    uint32_t chunk_size = (count + chunk_count - 1) / chunk_count;
+    std::vector<uint32_t> histograms(chunk_count * RADIX_SIZE);
+    scratch->resize(count);
+
+    for (uint32_t shift = 0; shift < 64; shift += RADIX_BITS) {
+        const DrawSortEntry* source = entries->data();
+        DrawSortEntry* destination = scratch->data();
+        core::threadpool::Dispatch(pool, chunk_count, [&](uint32_t chunk) {
+            uint32_t* histogram = &histograms[chunk * RADIX_SIZE];
+            std::fill(histogram, histogram + RADIX_SIZE, 0u);
+            uint32_t end = std::min(count, (chunk + 1) * chunk_size);
+            for (uint32_t i = chunk * chunk_size; i < end; i++) {
+                histogram[(source[i].key >> shift) & (RADIX_SIZE - 1)]++;
+            }
+        });
+
+        // Turn the counts into where each chunk starts writing each digit, digit major so the sort is stable
+        uint32_t offset = 0;
+        bool uniform = false;
+        for (uint32_t digit = 0; digit < RADIX_SIZE; digit++) {
+            uint32_t digit_begin = offset;
+            for (uint32_t chunk = 0; chunk < chunk_count; chunk++) {
+                uint32_t digit_count = histograms[chunk * RADIX_SIZE + digit];
+                histograms[chunk * RADIX_SIZE + digit] = offset;
+                offset += digit_count;
+            }
+            uniform = uniform || offset - digit_begin == count;
+        }
+        if (uniform) {
+            continue;
+        }
+
+        core::threadpool::Dispatch(pool, chunk_count, [&](uint32_t chunk) {
+            uint32_t* offsets = &histograms[chunk * RADIX_SIZE];
+            uint32_t end = std::min(count, (chunk + 1) * chunk_size);
+            for (uint32_t i = chunk * chunk_size; i < end; i++) {
+                destination[offsets[(source[i].key >> shift) & (RADIX_SIZE - 1)]++] = source[i];
+            }
+        });
+        entries->swap(*scratch);
+    }
+}
+bool SameBatch(const DrawPacket& a, const DrawPacket& b) {
+    return a.pipeline == b.pipeline && a.vk_descriptor_set == b.vk_descriptor_set &&
+           a.vertex_buffer == b.vertex_buffer && a.index_buffer == b.index_buffer && a.count == b.count &&
+           a.first == b.first && a.vertex_offset == b.vertex_offset;
+}
+// Grows geometrically, the buffer it replaces may still be read by the frames in flight
+void ReserveInstanceBuffer(DrawQueue* queue, VkDeviceSize size) {
+    if (queue->instance_buffer != nullptr && queue->instance_buffer->size >= size) {
+        return;
+    }
+    if (queue->instance_buffer != nullptr) {
+        size = std::max(size, queue->instance_buffer->size * 2);
+        Buffer* retired_buffer = queue->instance_buffer;
+        Retire([retired_buffer]() { DestroyBuffer(retired_buffer); });
+    }
+    queue->instance_buffer = CreateBuffer({
+        size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+    });
+}
+} // namespace
+
+DrawQueue* CreateDrawQueue(DrawQueueInfo info) {
+    auto queue = new DrawQueue{};
+    queue->info = info;
+    return queue;
+}
+void DestroyDrawQueue(DrawQueue* queue) {
+    if (queue->instance_buffer != nullptr) {
+        DestroyBuffer(queue->instance_buffer);
+    }
+    // The map still walks its nodes when it is destroyed, the blocks under them are freed after
+    core::Arena mesh_id_arena = queue->mesh_id_arena;
+    delete queue;
+    core::arena::Finalize(&mesh_id_arena);
+}
+namespace draw_queue {
+void Submit(DrawQueue* queue, const DrawPacket& packet, const void* instance_data) {
+    uint64_t key = packet.key;
+    uint32_t stride = queue->info.instance_stride;
+    if (stride > 0) {
+        // Ids in order of first submission, so equal meshes sort next to each other within a material
+        DrawMesh mesh{packet.vertex_buffer, packet.index_buffer, packet.count, packet.first, packet.vertex_offset};
+        auto mesh_id = queue->mesh_ids.emplace(mesh, (uint32_t)queue->mesh_ids.size()).first->second;
+        key = (key & ~draw_key::DEPTH_MASK) | (mesh_id & draw_key::DEPTH_MASK);
+
+        size_t offset = queue->instance_data.size();
+        queue->instance_data.resize(offset + stride);
+        memcpy(&queue->instance_data[offset], instance_data, stride);
+    }
+    queue->order.push_back({key, (uint32_t)queue->packets.size()});
+    queue->packets.push_back(packet);
+    queue->sorted = false;
+}
+void Clear(DrawQueue* queue) {
+    queue->packets.clear();
+    queue->order.clear();
+    queue->instance_data.clear();
+    // Rebuilt on the reset arena, a map may allocate as soon as it is constructed
+    queue->mesh_ids.~DrawMeshIds();
+    core::arena::Reset(&queue->mesh_id_arena);
+    new (&queue->mesh_ids) DrawMeshIds(&queue->mesh_id_arena);
+    queue->sorted = true;
+}
+void Sort(DrawQueue* queue) {
+    if (queue->sorted) {
+        return;
+    }
+    CORE_TRACE_ZONE("draw_queue::Sort");
+    uint32_t count = (uint32_t)queue->order.size();
+    if (count < RADIX_MINIMUM_COUNT) {
+        std::stable_sort(queue->order.begin(), queue->order.end(),
+                         [](const DrawSortEntry& a, const DrawSortEntry& b) { return a.key < b.key; });
+    } else {
+        uint32_t chunk_count = 1;
+        if (queue->info.thread_pool != nullptr && count >= queue->info.parallel_sort_threshold) {
+            // The calling thread sorts a chunk as well
+            chunk_count = (uint32_t)queue->info.thread_pool->threads.size() + 1;
+        }
+        RadixSort(queue->info.thread_pool, chunk_count, &queue->order, &queue->scratch);
+    }
+    queue->sorted = true;
+}
+} // namespace draw_queue
+
+namespace command {
+DrawQueueStats RecordDrawQueue(CommandBuffer* command_buffer, DrawQueue* queue, const VkViewport& viewport,
+                               const VkRect2D& scissor) {
+    draw_queue::Sort(queue);
+    VkCommandBuffer vk_command_buffer = command_buffer->vk_command_buffer;
+
+    DrawQueueStats draw_stats{};
+    Pipeline* bound_pipeline = nullptr;
+    VkPipelineLayout bound_layout = VK_NULL_HANDLE;
+    VkDescriptorSet bound_descriptor_set = VK_NULL_HANDLE;
+    Buffer* bound_vertex_buffer = nullptr;
+    Buffer* bound_index_buffer = nullptr;
+
+    uint32_t stride = queue->info.instance_stride;
+    uint8_t* instances = nullptr;
+    if (stride > 0 && queue->order.size() > 0) {
+        ReserveInstanceBuffer(queue, VkDeviceSize(stride) * queue->order.size());
+        instances = (uint8_t*)queue->instance_buffer->mapping;
+        BindVertexBuffer(command_buffer, queue->info.instance_binding, queue->instance_buffer);
+    }
+    uint32_t packet_count = (uint32_t)queue->order.size();
+    for (uint32_t i = 0; i < packet_count;) {
+        const DrawPacket& packet = queue->packets[queue->order[i].packet];
+        uint32_t instance_count = packet.instance_count;
+        uint32_t first_instance = packet.first_instance;
+        uint32_t batch_end = i + 1;
+        if (instances != nullptr) {
+            // Sorted order is instance order, so a batch is the run of packets that only differ in instance data
+            while (batch_end < packet_count && SameBatch(packet, queue->packets[queue->order[batch_end].packet])) {
+                batch_end++;
+            }
+            for (uint32_t j = i; j < batch_end; j++) {
+                memcpy(instances + size_t(j) * stride, &queue->instance_data[size_t(queue->order[j].packet) * stride],
+                       stride);
+            }
+            instance_count = batch_end - i;
+            first_instance = i;
+            draw_stats.batched_packets += batch_end - i - 1;
+        }
+
+        if (packet.pipeline != bound_pipeline) {
+            BindPipeline(command_buffer, packet.pipeline);
+            vkCmdSetViewport(vk_command_buffer, 0, 1, &viewport);
+            vkCmdSetScissor(vk_command_buffer, 0, 1, &scissor);
+            bound_pipeline = packet.pipeline;
+            draw_stats.pipeline_binds++;
+            // Sets stay bound across pipelines of the same layout, another layout may disturb them
+            if (packet.pipeline->vk_pipeline_layout != bound_layout) {
+                bound_layout = packet.pipeline->vk_pipeline_layout;
+                bound_descriptor_set = VK_NULL_HANDLE;
+            }
+        } else {
+            draw_stats.elided_binds++;
+        }
+
+        if (packet.vk_descriptor_set != VK_NULL_HANDLE) {
+            if (packet.vk_descriptor_set != bound_descriptor_set) {
+                vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, bound_layout, 0, 1,
+                                        &packet.vk_descriptor_set, 0, nullptr);
+                bound_descriptor_set = packet.vk_descriptor_set;
+                draw_stats.descriptor_set_binds++;
+            } else {
+                draw_stats.elided_binds++;
+            }
+        }
+        if (packet.vertex_buffer != nullptr) {
+            if (packet.vertex_buffer != bound_vertex_buffer) {
+                BindVertexBuffer(command_buffer, 0, packet.vertex_buffer);
+                bound_vertex_buffer = packet.vertex_buffer;
+                draw_stats.vertex_buffer_binds++;
+            } else {
+                draw_stats.elided_binds++;
+            }
+        }
+
+        if (packet.index_buffer == nullptr) {
+            Draw(command_buffer, packet.count, instance_count, packet.first, first_instance);
+        } else {
+            if (packet.index_buffer != bound_index_buffer) {
+                BindIndexBuffer(command_buffer, packet.index_buffer);
+                bound_index_buffer = packet.index_buffer;
+                draw_stats.index_buffer_binds++;
+            } else {
+                draw_stats.elided_binds++;
+            }
+            DrawIndexed(command_buffer, packet.count, instance_count, packet.first, packet.vertex_offset,
+                        first_instance);
+        }
+        draw_stats.draw_count++;
+        i = batch_end;
+    }
+    if (instances != nullptr) {
+        buffer::Flush(queue->instance_buffer);
+    }
+    stats::Count(STAT_ELIDED_BINDS, draw_stats.elided_binds);
+    queue->stats = draw_stats;
+    return draw_stats;
+}
+} // namespace command
+} // namespace render
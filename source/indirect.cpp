@@ -0,0 +1,291 @@
+#include "indirect.h"
+
+#include <cstring>
+
+#include "compute.h"
+#include "stats.h"
+
+namespace render {
+namespace {
+const uint32_t CULL_WORKGROUP_SIZE = 64;
+
+// Push constants of cull.comp
+struct CullConstants {
+    float planes[6][4];
+    uint32_t object_count;
+    uint32_t draw_indirect_count;
+};
+
+void CreateCullPipeline(IndirectScene* scene) {
+    scene->cull_pipeline = CreateComputePipeline({
+        {{SHADER_STAGE_COMPUTE, 0, sizeof(CullConstants)}},
+        {scene->vk_descriptor_set_layout},
+        {SHADER_STAGE_COMPUTE, SHADER_FORMAT_SPIRV, "cull.comp.spirv"},
+    });
+}
+void CreateDescriptorSet(IndirectScene* scene) {
+    VkDescriptorSetLayoutBinding bindings[4]{};
+    VkShaderStageFlags binding_stages[4] = {
+        VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        VK_SHADER_STAGE_VERTEX_BIT,
+    };
+    for (uint32_t i = 0; i < 4; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = binding_stages[i];
+    }
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = 4;
+    layout_info.pBindings = bindings;
+    vkCreateDescriptorSetLayout(context.vk_device, &layout_info, nullptr, &scene->vk_descriptor_set_layout);
+
+    VkDescriptorPoolSize pool_size{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4};
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.maxSets = 1;
+    pool_info.poolSizeCount = 1;
+    pool_info.pPoolSizes = &pool_size;
+    vkCreateDescriptorPool(context.vk_device, &pool_info, nullptr, &scene->vk_descriptor_pool);
+
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = scene->vk_descriptor_pool;
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &scene->vk_descriptor_set_layout;
+    VkResult result = vkAllocateDescriptorSets(context.vk_device, &allocate_info, &scene->vk_descriptor_set);
+    if (result != VK_SUCCESS) {
+        RENDER_LOG_ERROR("INDIRECT SCENE CREATION: Failed to Allocate VkDescriptorSet!");
+        return;
+    }
+
+    Buffer* buffers[4] = {scene->object_buffer, scene->draw_buffer, scene->count_buffer, scene->info.vertex_buffer};
+    VkDescriptorBufferInfo buffer_infos[4]{};
+    VkWriteDescriptorSet writes[4]{};
+    for (uint32_t i = 0; i < 4; i++) {
+        buffer_infos[i] = {buffers[i]->vk_buffer, 0, VK_WHOLE_SIZE};
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = scene->vk_descriptor_set;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &buffer_infos[i];
+    }
+    vkUpdateDescriptorSets(context.vk_device, 4, writes, 0, nullptr);
+}
+void Barrier(VkCommandBuffer vk_command_buffer, VkPipelineStageFlags source_stages, VkAccessFlags source_access,
+             VkPipelineStageFlags destination_stages, VkAccessFlags destination_access) {
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = source_access;
+    barrier.dstAccessMask = destination_access;
+    vkCmdPipelineBarrier(vk_command_buffer, source_stages, destination_stages, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+}
+} // namespace
+
+namespace frustum {
+Frustum FromViewProjection(const float view_projection[16]) {
+    // Each plane is w + sign * axis of clip space, except near which is z alone as depth starts at 0
+    const int axes[6] = {0, 0, 1, 1, 2, 2};
+    const float signs[6] = {1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f};
+    Frustum frustum{};
+    for (int i = 0; i < 6; i++) {
+        float* plane = frustum.planes[i];
+        for (int column = 0; column < 4; column++) {
+            float w = i == 4 ? 0.0f : view_projection[column * 4 + 3];
+            plane[column] = w + signs[i] * view_projection[column * 4 + axes[i]];
+        }
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f) {
+            for (int column = 0; column < 4; column++) {
+                plane[column] /= length;
+            }
+        }
+    }
+    return frustum;
+}
+} // namespace frustum
+
+IndirectScene* CreateIndirectScene(IndirectSceneInfo info) {
+    auto scene = new IndirectScene{};
+    scene->info = info;
+    scene->info.max_object_count = std::max(info.max_object_count, 1u);
+    scene->supported = context.vk_enabled_features.multiDrawIndirect == VK_TRUE &&
+                       context.vk_enabled_features.drawIndirectFirstInstance == VK_TRUE;
+    scene->draw_indirect_count = context.vk_enabled_vulkan12_features.drawIndirectCount == VK_TRUE;
+    if (!scene->supported) {
+        RENDER_LOG_ERROR("INDIRECT SCENE CREATION: Device Lacks multiDrawIndirect or drawIndirectFirstInstance!");
+        return scene;
+    }
+    if (info.vertex_buffer == nullptr || info.index_buffer == nullptr) {
+        RENDER_LOG_ERROR("INDIRECT SCENE CREATION: Vertex and Index Buffers Are Required!");
+        scene->supported = false;
+        return scene;
+    }
+    scene->objects.reserve(scene->info.max_object_count);
+
+    VkDeviceSize max_object_count = scene->info.max_object_count;
+    // The descriptor set keeps the VkBuffers, so none of them may be defragmented
+    scene->object_buffer = CreateBuffer({
+        max_object_count * sizeof(GpuObject),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        0,
+        false,
+    });
+    scene->draw_buffer = CreateBuffer({
+        max_object_count * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        0,
+        false,
+    });
+    scene->count_buffer = CreateBuffer({
+        sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+        0,
+        false,
+    });
+    CreateDescriptorSet(scene);
+    CreateCullPipeline(scene);
+    return scene;
+}
+void DestroyIndirectScene(IndirectScene* scene) {
+    DestroyPipeline(scene->cull_pipeline);
+    vkDestroyDescriptorPool(context.vk_device, scene->vk_descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(context.vk_device, scene->vk_descriptor_set_layout, nullptr);
+    for (Buffer* buffer : {scene->object_buffer, scene->draw_buffer, scene->count_buffer}) {
+        if (buffer != nullptr) {
+            DestroyBuffer(buffer);
+        }
+    }
+    for (IndirectFrame& frame : scene->frames) {
+        if (frame.staging_buffer != nullptr) {
+            DestroyBuffer(frame.staging_buffer);
+        }
+    }
+    delete scene;
+}
+namespace indirect_scene {
+uint32_t AddObject(IndirectScene* scene, const GpuObject& object) {
+    if (scene->objects.size() == scene->info.max_object_count) {
+        return UINT32_MAX;
+    }
+    uint32_t index = static_cast<uint32_t>(scene->objects.size());
+    scene->objects.emplace_back(object);
+    SetObject(scene, index, object);
+    return index;
+}
+void SetObject(IndirectScene* scene, uint32_t index, const GpuObject& object) {
+    scene->objects[index] = object;
+    if (scene->dirty_begin == scene->dirty_end) {
+        scene->dirty_begin = index;
+        scene->dirty_end = index + 1;
+        return;
+    }
+    scene->dirty_begin = std::min(scene->dirty_begin, index);
+    scene->dirty_end = std::max(scene->dirty_end, index + 1);
+}
+void Clear(IndirectScene* scene) {
+    scene->objects.clear();
+    scene->dirty_begin = 0;
+    scene->dirty_end = 0;
+}
+
+IndirectFrame* BeginFrame(IndirectScene* scene) {
+    IndirectFrame* frame = &scene->frames[render::frame % frames_in_flight];
+    frame->object_count = static_cast<uint32_t>(scene->objects.size());
+    frame->upload_begin = scene->dirty_begin;
+    frame->upload_end = std::min(scene->dirty_end, frame->object_count);
+    scene->dirty_begin = 0;
+    scene->dirty_end = 0;
+    if (!scene->supported || frame->upload_begin >= frame->upload_end) {
+        frame->upload_begin = frame->upload_end = 0;
+        return frame;
+    }
+
+    // Created on the first upload through the slot, so a scene that never changes holds a single one
+    if (frame->staging_buffer == nullptr) {
+        frame->staging_buffer = CreateBuffer({
+            VkDeviceSize{scene->info.max_object_count} * sizeof(GpuObject),
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        });
+    }
+    memcpy(static_cast<GpuObject*>(frame->staging_buffer->mapping) + frame->upload_begin,
+           &scene->objects[frame->upload_begin], (frame->upload_end - frame->upload_begin) * sizeof(GpuObject));
+    buffer::Flush(frame->staging_buffer);
+    return frame;
+}
+} // namespace indirect_scene
+
+namespace command {
+void CullIndirectScene(CommandBuffer* command_buffer, IndirectScene* scene, IndirectFrame* frame,
+                       const Frustum& frustum) {
+    if (!scene->supported) {
+        return;
+    }
+    VkCommandBuffer vk_command_buffer = command_buffer->vk_command_buffer;
+    // The previous frame may still be reading the objects, draws and count this frame overwrites
+    Barrier(vk_command_buffer,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_TRANSFER_WRITE_BIT);
+    if (frame->upload_begin < frame->upload_end) {
+        VkDeviceSize offset = VkDeviceSize{frame->upload_begin} * sizeof(GpuObject);
+        CopyBuffer(command_buffer, frame->staging_buffer, scene->object_buffer,
+                   VkDeviceSize{frame->upload_end - frame->upload_begin} * sizeof(GpuObject), offset, offset);
+    }
+    vkCmdFillBuffer(vk_command_buffer, scene->count_buffer->vk_buffer, 0, sizeof(uint32_t), 0);
+    Barrier(vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (frame->object_count > 0) {
+        CullConstants constants{};
+        memcpy(constants.planes, frustum.planes, sizeof(constants.planes));
+        constants.object_count = frame->object_count;
+        constants.draw_indirect_count = scene->draw_indirect_count ? 1 : 0;
+        VkPipelineLayout vk_cull_pipeline_layout = scene->cull_pipeline->vk_pipeline_layout;
+        BindPipeline(command_buffer, scene->cull_pipeline);
+        vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, vk_cull_pipeline_layout, 0, 1,
+                                &scene->vk_descriptor_set, 0, nullptr);
+        vkCmdPushConstants(vk_command_buffer, vk_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(constants), &constants);
+        Dispatch(command_buffer, (frame->object_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE);
+    }
+    Barrier(vk_command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT);
+}
+void DrawIndirectScene(CommandBuffer* command_buffer, IndirectScene* scene, IndirectFrame* frame, Pipeline* pipeline,
+                       const float view_projection[16]) {
+    if (!scene->supported || frame->object_count == 0) {
+        return;
+    }
+    VkCommandBuffer vk_command_buffer = command_buffer->vk_command_buffer;
+    vkCmdBindDescriptorSets(vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->vk_pipeline_layout, 0, 1,
+                            &scene->vk_descriptor_set, 0, nullptr);
+    vkCmdPushConstants(vk_command_buffer, pipeline->vk_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+                       16 * sizeof(float), view_projection);
+    BindIndexBuffer(command_buffer, scene->info.index_buffer);
+    if (scene->draw_indirect_count) {
+        vkCmdDrawIndexedIndirectCount(vk_command_buffer, scene->draw_buffer->vk_buffer, 0,
+                                      scene->count_buffer->vk_buffer, 0, frame->object_count,
+                                      sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+        vkCmdDrawIndexedIndirect(vk_command_buffer, scene->draw_buffer->vk_buffer, 0, frame->object_count,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    }
+    stats::Count(STAT_DRAW_CALLS);
+}
+} // namespace command
+} // namespace render
@@ -0,0 +1,405 @@
+#include "io.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <unistd.h>
+
+#ifdef ASSET_ENABLE_IO_URING
+#include <liburing.h>
+#endif
+
+namespace asset {
+namespace io {
+core::JobPriority ToJobPriority(IoPriority priority) { return (core::JobPriority)priority; }
+
+// Only requests without a completion are awaited, so only they keep a status. Call with the queue locked
+void SetStatus(IoQueue* queue, IoOperation* operation, IoStatus status) {
+    if (!operation->request.completion) {
+        queue->statuses[operation->handle] = status;
+    }
+}
+void Complete(IoQueue* queue, IoOperation* operation, IoStatus status) {
+    vfs::Release(&operation->location);
+
+    queue->mutex.lock();
+    queue->in_flight.erase(operation->handle);
+    if (operation->cancelled) {
+        status = IO_STATUS_CANCELLED;
+    }
+    if (status == IO_STATUS_COMPLETE) {
+        queue->bytes_read += operation->completed_size;
+    }
+    queue->completions.emplace_back(operation, status);
+    SetStatus(queue, operation, status);
+    queue->mutex.unlock();
+
+    queue->condition_variable.notify_all();
+    queue->completion_condition_variable.notify_all();
+}
+
+// Archive entries stored compressed are decompressed on a worker, reads within them address the uncompressed bytes
+IoStatus ReadCompressed(IoOperation* operation) {
+    FileLocation& location = operation->location;
+    IoRequest& request = operation->request;
+    if (request.offset == 0 && request.size == location.size) {
+        if (!compression::Decompress(location.compression, location.mapping, location.stored_size,
+                                     (char*)request.destination, request.size)) {
+            return IO_STATUS_FAILED;
+        }
+    } else {
+        std::vector<char> decompressed(location.size);
+        if (!compression::Decompress(location.compression, location.mapping, location.stored_size,
+                                     decompressed.data(), decompressed.size())) {
+            return IO_STATUS_FAILED;
+        }
+        memcpy(request.destination, decompressed.data() + request.offset, request.size);
+    }
+    operation->completed_size = request.size;
+    return IO_STATUS_COMPLETE;
+}
+IoStatus ReadBlocking(IoOperation* operation) {
+    if (operation->location.compression != COMPRESSION_NONE) {
+        return ReadCompressed(operation);
+    }
+    IoRequest& request = operation->request;
+    while (operation->completed_size < request.size) {
+        ssize_t count = pread(operation->location.file_descriptor,
+                              (char*)request.destination + operation->completed_size,
+                              request.size - operation->completed_size,
+                              operation->location.offset + request.offset + operation->completed_size);
+        if (count <= 0) {
+            return IO_STATUS_FAILED;
+        }
+        operation->completed_size += count;
+    }
+    return IO_STATUS_COMPLETE;
+}
+
+#ifdef ASSET_ENABLE_IO_URING
+void PrepareUringRead(IoQueue* queue, IoOperation* operation) {
+    auto ring = reinterpret_cast<io_uring*>(queue->uring);
+    io_uring_sqe* sqe = io_uring_get_sqe(ring);
+    if (sqe == nullptr) {
+        io_uring_submit(ring);
+        sqe = io_uring_get_sqe(ring);
+    }
+    IoRequest& request = operation->request;
+    io_uring_prep_read(sqe, operation->location.file_descriptor,
+                       (char*)request.destination + operation->completed_size,
+                       (unsigned int)(request.size - operation->completed_size),
+                       operation->location.offset + request.offset + operation->completed_size);
+    io_uring_sqe_set_data(sqe, operation);
+}
+void ReapUringCompletions(IoQueue* queue) {
+    auto ring = reinterpret_cast<io_uring*>(queue->uring);
+    // Bounded wait so newly queued requests are picked up while reads are in flight
+    __kernel_timespec timeout{0, 1000000};
+    io_uring_cqe* cqe = nullptr;
+    if (io_uring_wait_cqe_timeout(ring, &cqe, &timeout) != 0) {
+        return;
+    }
+    bool resubmit = false;
+    while (io_uring_peek_cqe(ring, &cqe) == 0) {
+        auto operation = reinterpret_cast<IoOperation*>(io_uring_cqe_get_data(cqe));
+        int result = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+
+        if (result <= 0) {
+            Complete(queue, operation, IO_STATUS_FAILED);
+            continue;
+        }
+        operation->completed_size += result;
+        if (operation->completed_size < operation->request.size) {
+            // Short read, queue the remainder
+            PrepareUringRead(queue, operation);
+            resubmit = true;
+            continue;
+        }
+        Complete(queue, operation, IO_STATUS_COMPLETE);
+    }
+    if (resubmit) {
+        io_uring_submit(ring);
+    }
+}
+#endif
+
+void Submit(IoQueue* queue, std::vector<IoOperation*>& operations) {
+#ifdef ASSET_ENABLE_IO_URING
+    if (queue->backend == IO_BACKEND_IO_URING) {
+        bool prepared = false;
+        for (IoOperation* operation : operations) {
+            if (operation->location.compression != COMPRESSION_NONE) {
+                core::threadpool::Enqueue(
+                    queue->worker_pool, [queue, operation]() { Complete(queue, operation, ReadCompressed(operation)); },
+                    ToJobPriority(operation->request.priority));
+                continue;
+            }
+            PrepareUringRead(queue, operation);
+            prepared = true;
+        }
+        // The whole batch goes to the kernel in a single io_uring_enter
+        if (prepared) {
+            io_uring_submit(reinterpret_cast<io_uring*>(queue->uring));
+        }
+        return;
+    }
+#endif
+    for (IoOperation* operation : operations) {
+        core::threadpool::Enqueue(
+            queue->worker_pool, [queue, operation]() { Complete(queue, operation, ReadBlocking(operation)); },
+            ToJobPriority(operation->request.priority));
+    }
+}
+
+void IoThreadFunction(IoQueue* queue) {
+    std::vector<IoOperation*> operations{};
+    while (true) {
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        auto has_pending = [queue]() {
+            for (auto& pending_queue : queue->pending_queues) {
+                if (pending_queue.size() > 0) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        bool reaping = queue->backend == IO_BACKEND_IO_URING && queue->in_flight.size() > 0;
+        if (!reaping) {
+            queue->condition_variable.wait(lock, [queue, &has_pending]() {
+                return !queue->active || (has_pending() && queue->in_flight.size() < queue->queue_depth);
+            });
+        }
+        if (!queue->active && queue->in_flight.size() == 0) {
+            return;
+        }
+
+        operations.clear();
+        for (int priority = IO_PRIORITY_COUNT - 1; priority >= 0 && queue->active; priority--) {
+            auto& pending_queue = queue->pending_queues[priority];
+            while (pending_queue.size() > 0 && queue->in_flight.size() < queue->queue_depth) {
+                IoOperation* operation = pending_queue.front();
+                pending_queue.pop_front();
+                queue->in_flight[operation->handle] = operation;
+                operations.emplace_back(operation);
+            }
+        }
+        lock.unlock();
+
+        if (operations.size() > 0) {
+            Submit(queue, operations);
+        }
+#ifdef ASSET_ENABLE_IO_URING
+        if (queue->backend == IO_BACKEND_IO_URING) {
+            ReapUringCompletions(queue);
+        }
+#endif
+        if (!queue->active && queue->backend == IO_BACKEND_THREAD_POOL) {
+            lock.lock();
+            queue->condition_variable.wait(lock, [queue]() { return queue->in_flight.size() == 0; });
+            return;
+        }
+    }
+}
+
+IoHandle Enqueue(IoQueue* queue, IoRequest& request) {
+    auto operation = new IoOperation{};
+    operation->request = std::move(request);
+
+    IoStatus status = IO_STATUS_PENDING;
+    if (!vfs::Locate(operation->request.path, &operation->location)) {
+        ASSET_LOG_ERROR("IO READ: Failed to Locate {}!", operation->request.path);
+        status = IO_STATUS_FAILED;
+    } else {
+        if (operation->request.size == 0 && operation->request.offset < operation->location.size) {
+            operation->request.size = operation->location.size - operation->request.offset;
+        }
+        if (operation->request.offset + operation->request.size > operation->location.size) {
+            ASSET_LOG_ERROR("IO READ: Read Past the End of {}!", operation->request.path);
+            status = IO_STATUS_FAILED;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    operation->handle = queue->next_handle++;
+    SetStatus(queue, operation, status);
+    if (status == IO_STATUS_FAILED) {
+        vfs::Release(&operation->location);
+        queue->completions.emplace_back(operation, status);
+        queue->completion_condition_variable.notify_all();
+        return operation->handle;
+    }
+    queue->pending_queues[operation->request.priority].emplace_back(operation);
+    return operation->handle;
+}
+IoHandle ReadAsync(IoQueue* queue, IoRequest request) {
+    IoHandle handle = Enqueue(queue, request);
+    queue->condition_variable.notify_all();
+    return handle;
+}
+std::vector<IoHandle> ReadBatchAsync(IoQueue* queue, std::vector<IoRequest> requests) {
+    std::vector<IoHandle> handles{};
+    handles.reserve(requests.size());
+    for (IoRequest& request : requests) {
+        handles.emplace_back(Enqueue(queue, request));
+    }
+    // Wake the I/O thread once so the batch is submitted together
+    queue->condition_variable.notify_all();
+    return handles;
+}
+bool Cancel(IoQueue* queue, IoHandle handle) {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    for (auto& pending_queue : queue->pending_queues) {
+        for (auto iterator = pending_queue.begin(); iterator != pending_queue.end(); iterator++) {
+            if ((*iterator)->handle == handle) {
+                IoOperation* operation = *iterator;
+                pending_queue.erase(iterator);
+                vfs::Release(&operation->location);
+                queue->completions.emplace_back(operation, IO_STATUS_CANCELLED);
+                SetStatus(queue, operation, IO_STATUS_CANCELLED);
+                queue->completion_condition_variable.notify_all();
+                return true;
+            }
+        }
+    }
+    auto iterator = queue->in_flight.find(handle);
+    if (iterator != queue->in_flight.end()) {
+        iterator->second->cancelled = true;
+        return true;
+    }
+    return false;
+}
+
+uint32_t Poll(IoQueue* queue) {
+    std::vector<std::pair<IoOperation*, IoStatus>> completions{};
+    queue->mutex.lock();
+    completions.swap(queue->completions);
+    queue->mutex.unlock();
+
+    for (auto& [operation, status] : completions) {
+        if (operation->request.completion) {
+            operation->request.completion(
+                IoResult{operation->handle, status, operation->request.destination, operation->completed_size});
+        }
+        delete operation;
+    }
+    return (uint32_t)completions.size();
+}
+IoStatus Await(IoQueue* queue, IoHandle handle) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    auto iterator = queue->statuses.find(handle);
+    // A request with a completion never has a status to wait for, nor has one awaited before
+    assert(iterator != queue->statuses.end() && "awaited a request with a completion, or awaited it twice");
+    if (iterator == queue->statuses.end()) {
+        return IO_STATUS_FAILED;
+    }
+    // Looked up again after every wake, inserting other requests may rehash the map
+    queue->completion_condition_variable.wait(
+        lock, [queue, handle]() { return queue->statuses.find(handle)->second != IO_STATUS_PENDING; });
+    iterator = queue->statuses.find(handle);
+    IoStatus status = iterator->second;
+    queue->statuses.erase(iterator);
+    return status;
+}
+} // namespace io
+
+IoQueue* CreateIoQueue(IoQueueInfo info) {
+    auto queue = new IoQueue{};
+    queue->backend = IO_BACKEND_THREAD_POOL;
+    queue->queue_depth = info.queue_depth;
+    queue->worker_pool = core::CreateThreadPool(info.worker_count);
+
+#ifdef ASSET_ENABLE_IO_URING
+    if (info.prefer_io_uring) {
+        auto ring = new io_uring{};
+        int result = io_uring_queue_init(info.queue_depth, ring, 0);
+        if (result == 0) {
+            queue->uring = ring;
+            queue->backend = IO_BACKEND_IO_URING;
+        } else {
+            // Kernels without io_uring, or with it disabled by policy, fall back to the worker pool
+            ASSET_LOG_INFO("IO QUEUE CREATION: io_uring Unavailable ({}), Using Thread Pool Backend", result);
+            delete ring;
+        }
+    }
+#endif
+
+    queue->io_thread = std::thread(io::IoThreadFunction, queue);
+    return queue;
+}
+void DestroyIoQueue(IoQueue* queue) {
+    queue->mutex.lock();
+    queue->active = false;
+    for (auto& pending_queue : queue->pending_queues) {
+        for (IoOperation* operation : pending_queue) {
+            vfs::Release(&operation->location);
+            queue->completions.emplace_back(operation, IO_STATUS_CANCELLED);
+        }
+        pending_queue.clear();
+    }
+    queue->mutex.unlock();
+    queue->condition_variable.notify_all();
+
+    queue->io_thread.join();
+    core::DestroyThreadPool(queue->worker_pool);
+
+#ifdef ASSET_ENABLE_IO_URING
+    if (queue->uring != nullptr) {
+        io_uring_queue_exit(reinterpret_cast<io_uring*>(queue->uring));
+        delete reinterpret_cast<io_uring*>(queue->uring);
+    }
+#endif
+    for (auto& [operation, status] : queue->completions) {
+        delete operation;
+    }
+    if (queue->statuses.size() > 0) {
+        ASSET_LOG_ERROR("IO QUEUE DESTRUCTION: {} Requests Without a Completion Were Never Awaited!",
+                        queue->statuses.size());
+    }
+    delete queue;
+}
+
+StagingRing* CreateStagingRing(void* memory, uint64_t capacity) {
+    auto ring = new StagingRing{};
+    ring->memory = reinterpret_cast<char*>(memory);
+    ring->capacity = capacity;
+    return ring;
+}
+void DestroyStagingRing(StagingRing* ring) { delete ring; }
+namespace staging_ring {
+void* Allocate(StagingRing* ring, uint64_t size, uint64_t alignment, uint64_t* offset) {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    if (size > ring->capacity) {
+        return nullptr;
+    }
+    // head and tail grow monotonically, their difference is the number of bytes in use
+    uint64_t position = ring->head % ring->capacity;
+    uint64_t padding = (alignment - position % alignment) % alignment;
+    if (position + padding + size > ring->capacity) {
+        // Not enough contiguous space before the end, wrap to the start of the memory
+        padding = ring->capacity - position;
+    }
+    if (ring->head + padding + size - ring->tail > ring->capacity) {
+        return nullptr;
+    }
+    uint64_t begin = (ring->head + padding) % ring->capacity;
+    ring->head += padding + size;
+    ring->allocation_ends.emplace_back(ring->head);
+
+    *offset = begin;
+    return ring->memory + begin;
+}
+void Release(StagingRing* ring) {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    if (ring->allocation_ends.size() == 0) {
+        return;
+    }
+    ring->tail = ring->allocation_ends.front();
+    ring->allocation_ends.pop_front();
+}
+uint64_t Available(StagingRing* ring) {
+    std::lock_guard<std::mutex> lock(ring->mutex);
+    return ring->capacity - (ring->head - ring->tail);
+}
+} // namespace staging_ring
+} // namespace asset
@@ -0,0 +1,189 @@
+#include "offscreen.h"
+
+namespace render {
+namespace offscreen_target {
+void Initialize(OffscreenTarget* target, OffscreenTargetInfo info) {
+    target->extent = info.extent;
+    target->format = info.format;
+    target->next_image_index = 0;
+    if (info.image_count == 0) {
+        info.image_count = frames_in_flight;
+    }
+    for (uint32_t i = 0; i < info.image_count; i++) {
+        Image* image = CreateImage({
+            info.extent,
+            info.format,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            VMA_MEMORY_USAGE_AUTO,
+            // Framebuffers keep the view
+            false,
+        });
+        target->images.emplace_back(image);
+        target->vk_image_views.emplace_back(image->vk_image_view);
+    }
+}
+void Finalize(OffscreenTarget* target) {
+    for (Image* image : target->images) {
+        DestroyImage(image);
+    }
+    target->images = {};
+    target->vk_image_views = {};
+}
+
+void Recreate(OffscreenTarget* target, Extent3D extent) {
+    std::vector<Image*> retired_images = target->images;
+    Retire([retired_images]() {
+        for (Image* image : retired_images) {
+            DestroyImage(image);
+        }
+    });
+    OffscreenTargetInfo info{extent, target->format, static_cast<uint32_t>(target->images.size())};
+    target->images = {};
+    target->vk_image_views = {};
+    Initialize(target, info);
+
+    for (auto function : target->recreation_functions) {
+        function();
+    }
+}
+void AcquireImage(OffscreenTarget* target, uint32_t* image_index) {
+    *image_index = target->next_image_index;
+    target->next_image_index = (target->next_image_index + 1) % target->images.size();
+}
+
+void BindRecreationFunction(OffscreenTarget* target, std::function<void()> function) {
+    target->recreation_functions.emplace_back(function);
+}
+} // namespace offscreen_target
+OffscreenTarget* CreateOffscreenTarget(OffscreenTargetInfo info) {
+    auto target = new OffscreenTarget{};
+    offscreen_target::Initialize(target, info);
+    return target;
+}
+void DestroyOffscreenTarget(OffscreenTarget* target) {
+    offscreen_target::Finalize(target);
+    delete target;
+}
+
+ReadbackPool* CreateReadbackPool(ReadbackPoolInfo info) {
+    auto pool = new ReadbackPool{};
+    if (info.buffer_count == 0) {
+        info.buffer_count = frames_in_flight + 1;
+    }
+    for (uint32_t i = 0; i < info.buffer_count; i++) {
+        auto readback = new Readback{};
+        readback->buffer = CreateBuffer({
+            info.buffer_size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+            VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        });
+        pool->readbacks.emplace_back(readback);
+        pool->free_readbacks.emplace_back(readback);
+    }
+    return pool;
+}
+void DestroyReadbackPool(ReadbackPool* pool) {
+    for (Readback* readback : pool->readbacks) {
+        DestroyBuffer(readback->buffer);
+        delete readback;
+    }
+    delete pool;
+}
+namespace readback_pool {
+Readback* Acquire(ReadbackPool* pool) {
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->condition_variable.wait(lock, [pool]() { return pool->free_readbacks.size() > 0; });
+    Readback* readback = pool->free_readbacks.front();
+    pool->free_readbacks.pop_front();
+    return readback;
+}
+Readback* TryAcquire(ReadbackPool* pool) {
+    std::lock_guard<std::mutex> lock(pool->mutex);
+    if (pool->free_readbacks.empty()) {
+        return nullptr;
+    }
+    Readback* readback = pool->free_readbacks.front();
+    pool->free_readbacks.pop_front();
+    return readback;
+}
+void Release(ReadbackPool* pool, Readback* readback) {
+    readback->fence = nullptr;
+    pool->mutex.lock();
+    pool->free_readbacks.emplace_back(readback);
+    pool->mutex.unlock();
+    pool->condition_variable.notify_one();
+}
+
+void RecordCopy(CommandBuffer* command_buffer, Readback* readback, Image* image, Fence* fence) {
+    RecordCopy(command_buffer, readback, image->vk_image, image->extent, image->format,
+               VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, fence);
+}
+void RecordCopy(CommandBuffer* command_buffer, Readback* readback, VkImage vk_image, Extent3D extent, VkFormat format,
+                VkImageLayout layout, Fence* fence) {
+    readback->extent = extent;
+    readback->format = format;
+    readback->fence = fence;
+
+    // The renderpass leaves the image in layout, but its color writes still have to reach the copy
+    VkImageMemoryBarrier image_barrier{};
+    image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    image_barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    image_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    image_barrier.oldLayout = layout;
+    image_barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    image_barrier.image = vk_image;
+    image_barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(command_buffer->vk_command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_barrier);
+
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {extent.x, extent.y, std::max(extent.z, 1u)};
+    vkCmdCopyImageToBuffer(command_buffer->vk_command_buffer, vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           readback->buffer->vk_buffer, 1, &region);
+
+    if (layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+        // Presentation waits on a semaphore, which already makes the image available to it
+        image_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        image_barrier.dstAccessMask = 0;
+        image_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        image_barrier.newLayout = layout;
+        vkCmdPipelineBarrier(command_buffer->vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &image_barrier);
+    }
+
+    // Makes the copy visible to host reads once the fence signals
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = readback->buffer->vk_buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(command_buffer->vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+const void* Read(Readback* readback) {
+    if (readback->fence == nullptr) {
+        RENDER_LOG_RATE_LIMITED(ERROR, 1000, "READBACK: Readback Was Never Recorded!");
+        return nullptr;
+    }
+    fence::Await(readback->fence);
+    buffer::Invalidate(readback->buffer);
+    return readback->buffer->mapping;
+}
+} // namespace readback_pool
+} // namespace render
@@ -0,0 +1,83 @@
+#include "pacing.h"
+
+#include <thread>
+
+namespace render {
+namespace {
+int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+void AddSample(FramePacer* pacer, FrameTimingHistory* history, double milliseconds) {
+    if (history->samples.size() == 0) {
+        history->samples.resize(pacer->info.history_frame_count, 0.0);
+    }
+    if (history->sample_count == history->samples.size()) {
+        history->sum -= history->samples[history->next_sample];
+    } else {
+        history->sample_count++;
+    }
+    history->samples[history->next_sample] = milliseconds;
+    history->next_sample = (history->next_sample + 1) % history->samples.size();
+    history->sum += milliseconds;
+    history->last = milliseconds;
+}
+FrameTiming GetTiming(FramePacer* pacer, const FrameTimingHistory& history) {
+    std::lock_guard<std::mutex> lock(pacer->mutex);
+    if (history.sample_count == 0) {
+        return {};
+    }
+    double max = 0.0;
+    for (uint32_t i = 0; i < history.sample_count; i++) {
+        max = std::max(max, history.samples[i]);
+    }
+    return {history.last, history.sum / history.sample_count, max};
+}
+} // namespace
+
+FramePacer* CreateFramePacer(FramePacerInfo info) {
+    auto pacer = new FramePacer{};
+    pacer->info = info;
+    pacer->info.history_frame_count = std::max(info.history_frame_count, 1u);
+    frame_pacer::SetTargetFrameRate(pacer, info.target_frame_rate);
+    return pacer;
+}
+void DestroyFramePacer(FramePacer* pacer) { delete pacer; }
+namespace frame_pacer {
+int64_t Wait(FramePacer* pacer) {
+    CORE_TRACE_ZONE("FramePacer Wait");
+    int64_t begin = Now();
+    int64_t now = begin;
+    if (pacer->target_frame_ns > 0) {
+        int64_t sleep_ns = pacer->next_frame_ns - now - pacer->info.spin_threshold_ns;
+        if (sleep_ns > 0) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(sleep_ns));
+        }
+        while ((now = Now()) < pacer->next_frame_ns) {
+            std::this_thread::yield();
+        }
+        // A frame more than a period late restarts the cadence rather than shortening the frames after it
+        pacer->next_frame_ns += pacer->target_frame_ns;
+        if (pacer->next_frame_ns < now) {
+            pacer->next_frame_ns = now + pacer->target_frame_ns;
+        }
+    }
+    std::lock_guard<std::mutex> lock(pacer->mutex);
+    AddSample(pacer, &pacer->wait, (now - begin) / 1000000.0);
+    return now;
+}
+void SetTargetFrameRate(FramePacer* pacer, double target_frame_rate) {
+    pacer->info.target_frame_rate = target_frame_rate;
+    pacer->target_frame_ns = target_frame_rate > 0.0 ? (int64_t)(1000000000.0 / target_frame_rate) : 0;
+    pacer->next_frame_ns = 0;
+}
+
+void RecordPresent(FramePacer* pacer, int64_t input_time_ns) {
+    int64_t now = Now();
+    std::lock_guard<std::mutex> lock(pacer->mutex);
+    AddSample(pacer, &pacer->latency, (now - input_time_ns) / 1000000.0);
+}
+FrameTiming GetWaitTiming(FramePacer* pacer) { return GetTiming(pacer, pacer->wait); }
+FrameTiming GetLatencyTiming(FramePacer* pacer) { return GetTiming(pacer, pacer->latency); }
+} // namespace frame_pacer
+} // namespace render
@@ -0,0 +1,196 @@
+#include "profiler.h"
+
+#include <cstring>
+
+namespace render {
+namespace {
+void AddSample(GpuProfiler* profiler, const char* name, uint32_t depth, double milliseconds) {
+    GpuPassHistory* history = nullptr;
+    for (GpuPassHistory& pass : profiler->passes) {
+        if (pass.depth == depth && pass.name == name) {
+            history = &pass;
+            break;
+        }
+    }
+    if (history == nullptr) {
+        history = &profiler->passes.emplace_back();
+        history->name = name;
+        history->depth = depth;
+        history->samples.resize(profiler->info.history_frame_count, 0.0);
+    }
+    if (history->sample_count == history->samples.size()) {
+        history->sum -= history->samples[history->next_sample];
+    } else {
+        history->sample_count++;
+    }
+    history->samples[history->next_sample] = milliseconds;
+    history->next_sample = (history->next_sample + 1) % history->samples.size();
+    history->sum += milliseconds;
+    history->last = milliseconds;
+}
+
+void Resolve(GpuProfiler* profiler, GpuProfile* profile) {
+    if (profile->query_count == 0) {
+        return;
+    }
+    // Each query is followed by its availability, so a partially available frame still yields its finished scopes
+    VkResult result = vkGetQueryPoolResults(context.vk_device, profile->vk_query_pool, 0, profile->query_count,
+                                            profile->query_count * 2 * sizeof(uint64_t), profiler->results.data(),
+                                            2 * sizeof(uint64_t),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        RENDER_LOG_RATE_LIMITED(ERROR, 1000, "GPU PROFILER: Failed to Get Query Pool Results!");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(profiler->mutex);
+    bool complete = true;
+    for (const GpuScope& scope : profile->scopes) {
+        if (scope.end_query == UINT32_MAX) {
+            continue;
+        }
+        const uint64_t* begin = &profiler->results[scope.begin_query * 2];
+        const uint64_t* end = &profiler->results[scope.end_query * 2];
+        if (begin[1] == 0 || end[1] == 0) {
+            complete = false;
+            continue;
+        }
+        // Masking the difference keeps it correct across a wrap of the valid bits
+        uint64_t ticks = (end[0] - begin[0]) & profiler->timestamp_mask;
+        AddSample(profiler, scope.name, scope.depth, ticks * profiler->timestamp_period_ns / 1000000.0);
+    }
+    if (complete) {
+        profiler->resolved_frame_count++;
+    } else {
+        profiler->unavailable_frame_count++;
+    }
+}
+} // namespace
+
+GpuProfiler* CreateGpuProfiler(GpuProfilerInfo info) {
+    auto profiler = new GpuProfiler{};
+    profiler->info = info;
+    profiler->info.max_scope_count = std::max(info.max_scope_count, 1u);
+    profiler->info.history_frame_count = std::max(info.history_frame_count, 1u);
+    uint32_t query_count = profiler->info.max_scope_count * 2;
+
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(context.vk_physical_device, &properties);
+    uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(context.vk_physical_device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(context.vk_physical_device, &queue_family_count, queue_families.data());
+
+    uint32_t valid_bits = queue_families[context.universal_queue.vk_family_index].timestampValidBits;
+    profiler->supported = valid_bits > 0 && properties.limits.timestampPeriod > 0.0f;
+    profiler->timestamp_period_ns = properties.limits.timestampPeriod;
+    profiler->timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+    if (!profiler->supported) {
+        RENDER_LOG_ERROR("GPU PROFILER: Universal Queue Does Not Support Timestamps!");
+        return profiler;
+    }
+
+    for (GpuProfile& profile : profiler->profiles) {
+        VkQueryPoolCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        create_info.pNext = nullptr;
+        create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        create_info.queryCount = query_count;
+        VkResult result = vkCreateQueryPool(context.vk_device, &create_info, nullptr, &profile.vk_query_pool);
+        if (result != VK_SUCCESS) {
+            RENDER_LOG_ERROR("GPU PROFILER: Failed to Create VkQueryPool!");
+            profiler->supported = false;
+        }
+        // Reserved up front, recording a frame never allocates
+        profile.scopes.reserve(profiler->info.max_scope_count);
+        profile.open_scopes.reserve(profiler->info.max_scope_count);
+    }
+    profiler->results.resize(query_count * 2);
+    return profiler;
+}
+void DestroyGpuProfiler(GpuProfiler* profiler) {
+    for (GpuProfile& profile : profiler->profiles) {
+        vkDestroyQueryPool(context.vk_device, profile.vk_query_pool, nullptr);
+    }
+    delete profiler;
+}
+namespace gpu_profiler {
+GpuProfile* BeginFrame(GpuProfiler* profiler) {
+    GpuProfile* profile = &profiler->profiles[frame % frames_in_flight];
+    if (profile->recorded) {
+        Resolve(profiler, profile);
+    }
+    profile->frame = frame;
+    profile->recorded = false;
+    profile->query_count = 0;
+    profile->scopes.clear();
+    profile->open_scopes.clear();
+    profile->dropped_scope_count = 0;
+    return profile;
+}
+std::vector<GpuPassTiming> GetTimings(GpuProfiler* profiler) {
+    std::lock_guard<std::mutex> lock(profiler->mutex);
+    std::vector<GpuPassTiming> timings{};
+    for (const GpuPassHistory& pass : profiler->passes) {
+        double max = 0.0;
+        for (uint32_t i = 0; i < pass.sample_count; i++) {
+            max = std::max(max, pass.samples[i]);
+        }
+        timings.push_back({pass.name, pass.depth, pass.last, pass.sum / pass.sample_count, max});
+    }
+    return timings;
+}
+} // namespace gpu_profiler
+
+namespace command {
+void BeginGpuProfile(CommandBuffer* command_buffer, GpuProfiler* profiler, GpuProfile* profile) {
+    if (!profiler->supported) {
+        return;
+    }
+    vkCmdResetQueryPool(command_buffer->vk_command_buffer, profile->vk_query_pool, 0,
+                        profiler->info.max_scope_count * 2);
+    profile->recorded = true;
+}
+void BeginGpuScope(CommandBuffer* command_buffer, GpuProfiler* profiler, GpuProfile* profile, const char* name) {
+    if (!profile->recorded) {
+        return;
+    }
+    if (profile->scopes.size() == profiler->info.max_scope_count) {
+        // Still pushed, so the matching EndGpuScope pops the right scope
+        profile->open_scopes.emplace_back(UINT32_MAX);
+        profile->dropped_scope_count++;
+        return;
+    }
+    uint32_t query = profile->query_count++;
+    vkCmdWriteTimestamp(command_buffer->vk_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profile->vk_query_pool,
+                        query);
+    profile->open_scopes.emplace_back(static_cast<uint32_t>(profile->scopes.size()));
+    profile->scopes.push_back({name, static_cast<uint32_t>(profile->open_scopes.size() - 1), query, UINT32_MAX});
+}
+void EndGpuScope(CommandBuffer* command_buffer, GpuProfiler* profiler, GpuProfile* profile) {
+    if (!profile->recorded) {
+        return;
+    }
+    if (profile->open_scopes.size() == 0) {
+        RENDER_LOG_RATE_LIMITED(ERROR, 1000, "GPU PROFILER: Scope Ended Without Being Begun!");
+        return;
+    }
+    uint32_t scope = profile->open_scopes.back();
+    profile->open_scopes.pop_back();
+    if (scope == UINT32_MAX) {
+        return;
+    }
+    uint32_t query = profile->query_count++;
+    vkCmdWriteTimestamp(command_buffer->vk_command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        profile->vk_query_pool, query);
+    profile->scopes[scope].end_query = query;
+}
+
+ScopedGpuScope::ScopedGpuScope(CommandBuffer* command_buffer, GpuProfiler* profiler, GpuProfile* profile,
+                               const char* name)
+    : command_buffer(command_buffer), profiler(profiler), profile(profile) {
+    BeginGpuScope(command_buffer, profiler, profile, name);
+}
+ScopedGpuScope::~ScopedGpuScope() { EndGpuScope(command_buffer, profiler, profile); }
+} // namespace command
+} // namespace render
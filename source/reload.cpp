@@ -0,0 +1,231 @@
+#include "reload.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "asset.h"
+#include "render.h"
+
+namespace render {
+namespace {
+// A GLSL source compiled once for every pipeline built from it
+struct SourceCompile {
+    std::string filepath;
+    ShaderStage shader_stage;
+    std::string spirv_filepath;
+};
+// A pipeline rebuilt once the sources it was queued for have compiled
+struct PipelineRebuild {
+    Pipeline* pipeline;
+    std::vector<std::string> sources;
+    std::optional<PipelineInfo> info;
+    std::optional<ComputePipelineInfo> compute_info;
+    VkPipelineLayout vk_pipeline_layout;
+};
+
+std::vector<ShaderInfo> PipelineShaders(Pipeline* pipeline) {
+    if (pipeline->recreation_info.has_value()) {
+        return pipeline->recreation_info->shaders;
+    }
+    if (pipeline->compute_recreation_info.has_value()) {
+        return {pipeline->compute_recreation_info->shader};
+    }
+    return {};
+}
+// Watched shaders are read from the SPIR-V of their source, so a rebuild never runs glslc again
+void ReadFromSource(PipelineReloader* reloader, const std::string& filepath, ShaderInfo* shader) {
+    if (filepath.empty()) {
+        return;
+    }
+    shader->shader_code_format = SHADER_FORMAT_SPIRV;
+    shader->filepath = reloader->sources.at(filepath).spirv_filepath;
+}
+PipelineRebuild QueueRebuild(PipelineReloader* reloader, Pipeline* pipeline) {
+    reloader->compiling.insert(pipeline);
+    PipelineRebuild rebuild{pipeline, reloader->pipeline_sources[pipeline], pipeline->recreation_info,
+                            pipeline->compute_recreation_info, pipeline->vk_pipeline_layout};
+    for (size_t i = 0; i < rebuild.sources.size(); i++) {
+        ShaderInfo* shader = rebuild.info ? &rebuild.info->shaders[i] : &rebuild.compute_info->shader;
+        ReadFromSource(reloader, rebuild.sources[i], shader);
+    }
+    return rebuild;
+}
+void RebuildAsync(PipelineReloader* reloader, PipelineRebuild rebuild) {
+    core::threadpool::Enqueue(reloader->worker_pool, [reloader, rebuild]() {
+        VkPipeline vk_pipeline = VK_NULL_HANDLE;
+        try {
+            vk_pipeline = rebuild.info ? pipeline::Compile(rebuild.info.value(), rebuild.vk_pipeline_layout)
+                                       : pipeline::Compile(rebuild.compute_info.value(), rebuild.vk_pipeline_layout);
+        } catch (const std::runtime_error& error) {
+            // A broken shader keeps the pipeline on its previous build until the next save
+            RENDER_LOG_ERROR("PIPELINE RELOAD: {}", error.what());
+        }
+        std::lock_guard<std::mutex> lock(reloader->mutex);
+        reloader->compiled.emplace_back(rebuild.pipeline, vk_pipeline);
+    });
+}
+/* Compiles every changed GLSL source once, each into a file of its own renamed over its SPIR-V, then
+ * rebuilds the pipelines. A pipeline with a source that failed to compile keeps its previous build. */
+void ReloadAsync(PipelineReloader* reloader, std::vector<SourceCompile> compiles,
+                 std::vector<PipelineRebuild> rebuilds) {
+    core::threadpool::Enqueue(reloader->worker_pool, [reloader, compiles, rebuilds]() {
+        std::vector<std::string> failed{};
+        for (const SourceCompile& compile : compiles) {
+            try {
+                shader::CompileGLSLFile(compile.shader_stage, compile.filepath, compile.spirv_filepath);
+            } catch (const std::runtime_error& error) {
+                RENDER_LOG_ERROR("PIPELINE RELOAD: {}", error.what());
+                failed.emplace_back(compile.filepath);
+            }
+        }
+        for (const PipelineRebuild& rebuild : rebuilds) {
+            bool broken =
+                std::any_of(rebuild.sources.begin(), rebuild.sources.end(), [&failed](const std::string& source) {
+                    return std::find(failed.begin(), failed.end(), source) != failed.end();
+                });
+            if (broken) {
+                std::lock_guard<std::mutex> lock(reloader->mutex);
+                reloader->compiled.emplace_back(rebuild.pipeline, VK_NULL_HANDLE);
+                continue;
+            }
+            RebuildAsync(reloader, rebuild);
+        }
+    });
+}
+} // namespace
+
+PipelineReloader* CreatePipelineReloader(PipelineReloaderInfo info) {
+    auto reloader = new PipelineReloader{};
+    reloader->worker_pool = info.worker_pool;
+    reloader->watcher = core::CreateFileWatcher({info.poll_interval_ms});
+    return reloader;
+}
+void DestroyPipelineReloader(PipelineReloader* reloader) {
+    core::DestroyFileWatcher(reloader->watcher);
+    core::threadpool::AwaitIdle(reloader->worker_pool);
+    for (auto& [pipeline, vk_pipeline] : reloader->compiled) {
+        vkDestroyPipeline(context.vk_device, vk_pipeline, nullptr);
+    }
+    delete reloader;
+}
+namespace pipeline_reloader {
+void Register(PipelineReloader* reloader, Pipeline* pipeline) { Register(reloader, pipeline, {}); }
+void Register(PipelineReloader* reloader, Pipeline* pipeline, const std::vector<ShaderInfo>& sources) {
+    std::vector<ShaderInfo> shaders = PipelineShaders(pipeline);
+    if (shaders.size() == 0) {
+        RENDER_LOG_ERROR("PIPELINE RELOAD: Pipeline Has No Recreation Info!");
+        return;
+    }
+    if (sources.size() != 0 && sources.size() != shaders.size()) {
+        RENDER_LOG_ERROR("PIPELINE RELOAD: Pipeline Needs One Source Per Shader!");
+        return;
+    }
+    std::lock_guard<std::mutex> lock(reloader->mutex);
+    std::vector<std::string>& pipeline_sources = reloader->pipeline_sources[pipeline];
+    pipeline_sources.assign(shaders.size(), std::string{});
+    for (size_t i = 0; i < shaders.size(); i++) {
+        const ShaderInfo& source = sources.size() != 0 ? sources[i] : shaders[i];
+        std::string host_filepath;
+        std::string shader_host_filepath;
+        if (!asset::vfs::HostPath(source.filepath, &host_filepath) ||
+            !asset::vfs::HostPath(shaders[i].filepath, &shader_host_filepath)) {
+            RENDER_LOG_ERROR("PIPELINE RELOAD: Shader {} Is Not On The Host!", source.filepath);
+            continue;
+        }
+        // The SPIR-V the pipeline reads, which a GLSL shader was compiled to on creation
+        std::string spirv_filepath = shaders[i].shader_code_format == SHADER_FORMAT_GLSL
+                                         ? shader::SpirvFilepath(shader_host_filepath)
+                                         : shader_host_filepath;
+        if (source.shader_code_format == SHADER_FORMAT_SPIRV) {
+            spirv_filepath = host_filepath;
+        }
+
+        std::string filepath = core::file_watcher::Watch(reloader->watcher, host_filepath);
+        ReloadSource& reload_source = reloader->sources[filepath];
+        reload_source.shader_stage = source.shader_stage;
+        reload_source.shader_code_format = source.shader_code_format;
+        reload_source.spirv_filepath = spirv_filepath;
+        reload_source.dependents.insert(pipeline);
+        pipeline_sources[i] = filepath;
+    }
+}
+void Unregister(PipelineReloader* reloader, Pipeline* pipeline) {
+    // A compile still running for the pipeline would swap into freed memory
+    reloader->mutex.lock();
+    bool compiling = reloader->compiling.count(pipeline) > 0;
+    reloader->mutex.unlock();
+    if (compiling) {
+        core::threadpool::AwaitIdle(reloader->worker_pool);
+    }
+    std::lock_guard<std::mutex> lock(reloader->mutex);
+    for (auto iterator = reloader->sources.begin(); iterator != reloader->sources.end();) {
+        iterator->second.dependents.erase(pipeline);
+        if (iterator->second.dependents.size() == 0) {
+            core::file_watcher::Unwatch(reloader->watcher, iterator->first);
+            reloader->stale.erase(iterator->first);
+            iterator = reloader->sources.erase(iterator);
+        } else {
+            iterator++;
+        }
+    }
+    reloader->pipeline_sources.erase(pipeline);
+    reloader->compiling.erase(pipeline);
+    for (auto iterator = reloader->compiled.begin(); iterator != reloader->compiled.end();) {
+        if (iterator->first == pipeline) {
+            vkDestroyPipeline(context.vk_device, iterator->second, nullptr);
+            iterator = reloader->compiled.erase(iterator);
+        } else {
+            iterator++;
+        }
+    }
+}
+
+void Update(PipelineReloader* reloader) {
+    std::vector<std::string> changes = core::file_watcher::Poll(reloader->watcher);
+
+    std::lock_guard<std::mutex> lock(reloader->mutex);
+    for (auto& [pipeline, vk_pipeline] : reloader->compiled) {
+        reloader->compiling.erase(pipeline);
+        if (vk_pipeline == VK_NULL_HANDLE) {
+            continue;
+        }
+        VkPipeline retired_vk_pipeline = pipeline->vk_pipeline.exchange(vk_pipeline);
+        Retire([retired_vk_pipeline]() { vkDestroyPipeline(context.vk_device, retired_vk_pipeline, nullptr); });
+        RENDER_LOG_INFO("PIPELINE RELOADED!");
+    }
+    reloader->compiled.clear();
+
+    /* Only pipelines built from a changed file are rebuilt. A source with a dependent still compiling waits
+     * for it to land, so no two compiles of one source ever run at once. */
+    std::set<std::string> changed(changes.begin(), changes.end());
+    changed.insert(reloader->stale.begin(), reloader->stale.end());
+    reloader->stale.clear();
+    std::vector<SourceCompile> compiles{};
+    std::set<Pipeline*> affected{};
+    for (const std::string& filepath : changed) {
+        auto source = reloader->sources.find(filepath);
+        if (source == reloader->sources.end()) {
+            continue;
+        }
+        const std::set<Pipeline*>& dependents = source->second.dependents;
+        if (std::any_of(dependents.begin(), dependents.end(),
+                        [reloader](Pipeline* pipeline) { return reloader->compiling.count(pipeline) > 0; })) {
+            reloader->stale.insert(filepath);
+            continue;
+        }
+        if (source->second.shader_code_format == SHADER_FORMAT_GLSL) {
+            compiles.push_back({filepath, source->second.shader_stage, source->second.spirv_filepath});
+        }
+        affected.insert(dependents.begin(), dependents.end());
+    }
+    if (affected.size() == 0) {
+        return;
+    }
+    std::vector<PipelineRebuild> rebuilds{};
+    for (Pipeline* pipeline : affected) {
+        rebuilds.emplace_back(QueueRebuild(reloader, pipeline));
+    }
+    ReloadAsync(reloader, std::move(compiles), std::move(rebuilds));
+}
+} // namespace pipeline_reloader
+} // namespace render
@@ -1,5 +1,21 @@
 #include "render.h"
 
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+
+#include <unistd.h>
+
+#include "asset.h"
+#include "offscreen.h"
+#include "stats.h"
+
 #ifndef VMA_IMPLEMENTATION
 #define VMA_IMPLEMENTATION
 #include "vk_mem_alloc.h"
@@ -29,64 +45,219 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 }
 } // namespace vkutil
 namespace validation {
-std::vector<const char*> VkInstanceExtensionSupport(std::vector<const char*> extension_names) {
-    uint32_t extension_property_count = 0;
-    vkEnumerateInstanceExtensionProperties(nullptr, &extension_property_count, nullptr);
-    auto extension_properties = new VkExtensionProperties[extension_property_count];
-    vkEnumerateInstanceExtensionProperties(nullptr, &extension_property_count, extension_properties);
-    for (unsigned int i = 0; i < extension_property_count; i++) {
-        for (auto iterator = extension_names.begin(); iterator != extension_names.end(); iterator++) {
-            if (strcmp(extension_properties[i].extensionName, *iterator) == 0) {
-                extension_names.erase(iterator);
+namespace {
+/* Support checks repeat for every extension group and every candidate device, the properties are enumerated
+ * once and kept until DestroyContext. Only CreateContext queries them, so they are not synchronized. */
+std::optional<std::vector<VkExtensionProperties>> instance_extension_properties{};
+std::optional<std::vector<VkLayerProperties>> instance_layer_properties{};
+std::unordered_map<VkPhysicalDevice, std::vector<VkExtensionProperties>> device_extension_properties{};
+
+// Removes every name found in properties, what is left is unsupported
+template <typename Properties, typename Function>
+std::vector<const char*> Unsupported(const std::vector<Properties>& properties, std::vector<const char*> names,
+                                     Function property_name) {
+    for (const Properties& property : properties) {
+        for (auto iterator = names.begin(); iterator != names.end(); iterator++) {
+            if (strcmp(property_name(property), *iterator) == 0) {
+                names.erase(iterator);
                 break;
             }
         }
     }
-    delete[] extension_properties;
-    return extension_names;
+    return names;
+}
+} // namespace
+std::vector<const char*> VkInstanceExtensionSupport(std::vector<const char*> extension_names) {
+    if (!instance_extension_properties) {
+        uint32_t extension_property_count = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extension_property_count, nullptr);
+        instance_extension_properties.emplace(extension_property_count);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extension_property_count,
+                                               instance_extension_properties->data());
+    }
+    return Unsupported(*instance_extension_properties, std::move(extension_names),
+                       [](const VkExtensionProperties& property) { return property.extensionName; });
 }
 std::vector<const char*> VkInstanceLayerSupport(std::vector<const char*> layer_names) {
-    uint32_t layer_property_count = 0;
-    vkEnumerateInstanceLayerProperties(&layer_property_count, nullptr);
-    auto layer_properties = new VkLayerProperties[layer_property_count];
-    vkEnumerateInstanceLayerProperties(&layer_property_count, layer_properties);
-    for (unsigned int i = 0; i < layer_property_count; i++) {
-        for (auto iterator = layer_names.begin(); iterator != layer_names.end(); iterator++) {
-            if (strcmp(layer_properties[i].layerName, *iterator) == 0) {
-                layer_names.erase(iterator);
-                break;
-            }
-        }
+    if (!instance_layer_properties) {
+        uint32_t layer_property_count = 0;
+        vkEnumerateInstanceLayerProperties(&layer_property_count, nullptr);
+        instance_layer_properties.emplace(layer_property_count);
+        vkEnumerateInstanceLayerProperties(&layer_property_count, instance_layer_properties->data());
     }
-    delete[] layer_properties;
-    return layer_names;
+    return Unsupported(*instance_layer_properties, std::move(layer_names),
+                       [](const VkLayerProperties& property) { return property.layerName; });
 }
 static VKAPI_ATTR VkBool32 VKAPI_CALL DefaultVkDebugUtilsMessengerEXTCallback(
     VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity, VkDebugUtilsMessageTypeFlagsEXT messageType,
     const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData, void* pUserData) {
-    RENDER_LOG_ERROR("VULKAN VALIDATION LAYER: {}", pCallbackData->pMessage);
+    // Called on whichever thread made the Vulkan call, the asynchronous logger keeps the output off that thread
+    if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        RENDER_LOG_ERROR("VULKAN VALIDATION LAYER: {}", pCallbackData->pMessage);
+    } else if (messageSeverity >= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        RENDER_LOG_WARN("VULKAN VALIDATION LAYER: {}", pCallbackData->pMessage);
+    } else {
+        RENDER_LOG_DEBUG("VULKAN VALIDATION LAYER: {}", pCallbackData->pMessage);
+    }
     return VK_FALSE;
 }
 
 std::vector<const char*> VkDeviceExtensionSupport(VkPhysicalDevice vk_physical_device,
                                                   std::vector<const char*> extension_names) {
-    uint32_t extension_property_count = 0;
-    vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &extension_property_count, nullptr);
-    auto extension_properties = new VkExtensionProperties[extension_property_count];
-    vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &extension_property_count, extension_properties);
-    for (unsigned int i = 0; i < extension_property_count; i++) {
-        for (auto iterator = extension_names.begin(); iterator != extension_names.end(); iterator++) {
-            if (strcmp(extension_properties[i].extensionName, *iterator) == 0) {
-                extension_names.erase(iterator);
-                break;
-            }
-        }
+    auto iterator = device_extension_properties.find(vk_physical_device);
+    if (iterator == device_extension_properties.end()) {
+        uint32_t extension_property_count = 0;
+        vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &extension_property_count, nullptr);
+        std::vector<VkExtensionProperties> extension_properties(extension_property_count);
+        vkEnumerateDeviceExtensionProperties(vk_physical_device, nullptr, &extension_property_count,
+                                             extension_properties.data());
+        iterator = device_extension_properties.emplace(vk_physical_device, std::move(extension_properties)).first;
     }
-    delete[] extension_properties;
-    return extension_names;
+    return Unsupported(iterator->second, std::move(extension_names),
+                       [](const VkExtensionProperties& property) { return property.extensionName; });
+}
+// Handles of the next instance may reuse the addresses of this one
+void ClearCapabilities() {
+    instance_extension_properties.reset();
+    instance_layer_properties.reset();
+    device_extension_properties.clear();
 }
 } // namespace validation
 
+namespace {
+// What rating and the capability log read from a physical device
+struct VkPhysicalDeviceDescription {
+    VkPhysicalDeviceProperties properties;
+    VkDeviceSize device_local_bytes;
+    bool universal_family;
+    bool dedicated_compute_family;
+    bool dedicated_transfer_family;
+    bool timeline_semaphore;
+    bool descriptor_indexing;
+    bool dynamic_rendering;
+    bool draw_indirect_count;
+    bool multi_draw_indirect;
+    bool pipeline_statistics_query;
+};
+VkPhysicalDeviceDescription QueryVkPhysicalDeviceDescription(VkPhysicalDevice vk_physical_device) {
+    VkPhysicalDeviceDescription description{};
+    vkGetPhysicalDeviceProperties(vk_physical_device, &description.properties);
+
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    vkGetPhysicalDeviceMemoryProperties(vk_physical_device, &memory_properties);
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++) {
+        if (memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            description.device_local_bytes =
+                std::max(description.device_local_bytes, memory_properties.memoryHeaps[i].size);
+        }
+    }
+
+    uint32_t queue_family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> queue_family_properties(queue_family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(vk_physical_device, &queue_family_count, queue_family_properties.data());
+    for (const VkQueueFamilyProperties& family : queue_family_properties) {
+        bool graphics = family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+        bool compute = family.queueFlags & VK_QUEUE_COMPUTE_BIT;
+        description.universal_family |= graphics && compute;
+        description.dedicated_compute_family |= compute && !graphics;
+        description.dedicated_transfer_family |= (family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !graphics && !compute;
+    }
+
+    // Dynamic rendering is core in 1.3, the features of the extension are only queried where it exists
+    bool dynamic_rendering_exposed =
+        description.properties.apiVersion >= VK_API_VERSION_1_3 ||
+        validation::VkDeviceExtensionSupport(vk_physical_device, {VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME}).empty();
+    VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features{};
+    dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+    VkPhysicalDeviceVulkan12Features vulkan12_features{};
+    vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12_features.pNext = dynamic_rendering_exposed ? &dynamic_rendering_features : nullptr;
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &vulkan12_features;
+    if (description.properties.apiVersion >= VK_API_VERSION_1_2) {
+        vkGetPhysicalDeviceFeatures2(vk_physical_device, &features2);
+    } else {
+        vkGetPhysicalDeviceFeatures(vk_physical_device, &features2.features);
+    }
+    description.timeline_semaphore = vulkan12_features.timelineSemaphore;
+    description.descriptor_indexing = vulkan12_features.descriptorIndexing;
+    description.dynamic_rendering = dynamic_rendering_features.dynamicRendering;
+    description.draw_indirect_count = vulkan12_features.drawIndirectCount;
+    description.multi_draw_indirect = features2.features.multiDrawIndirect;
+    description.pipeline_statistics_query = features2.features.pipelineStatisticsQuery;
+    return description;
+}
+// Rating, the device log and the chosen device all describe the same devices, cleared with the capabilities
+std::unordered_map<VkPhysicalDevice, VkPhysicalDeviceDescription> physical_device_descriptions{};
+const VkPhysicalDeviceDescription& DescribeVkPhysicalDevice(VkPhysicalDevice vk_physical_device) {
+    auto iterator = physical_device_descriptions.find(vk_physical_device);
+    if (iterator == physical_device_descriptions.end()) {
+        iterator = physical_device_descriptions
+                       .emplace(vk_physical_device, QueryVkPhysicalDeviceDescription(vk_physical_device))
+                       .first;
+    }
+    return iterator->second;
+}
+const char* VkPhysicalDeviceTypeName(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        return "Discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        return "Integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        return "Virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU:
+        return "CPU";
+    default:
+        return "Other";
+    }
+}
+void LogVkPhysicalDevice(const VkPhysicalDeviceDescription& description) {
+    const VkPhysicalDeviceProperties& properties = description.properties;
+    const VkPhysicalDeviceLimits& limits = properties.limits;
+    RENDER_LOG_INFO("PHYSICAL DEVICE: {}, {} GPU, Vulkan {}.{}.{}, Driver {:#x}, {} MB Device Local",
+                    properties.deviceName, VkPhysicalDeviceTypeName(properties.deviceType),
+                    VK_API_VERSION_MAJOR(properties.apiVersion), VK_API_VERSION_MINOR(properties.apiVersion),
+                    VK_API_VERSION_PATCH(properties.apiVersion), properties.driverVersion,
+                    description.device_local_bytes / (1024 * 1024));
+    RENDER_LOG_INFO("PHYSICAL DEVICE: Queues Universal {}, Dedicated Compute {}, Dedicated Transfer {}",
+                    description.universal_family, description.dedicated_compute_family,
+                    description.dedicated_transfer_family);
+    RENDER_LOG_INFO("PHYSICAL DEVICE: Timeline Semaphores {}, Descriptor Indexing {}, Dynamic Rendering {}, "
+                    "Draw Indirect Count {}, Multi Draw Indirect {}, Pipeline Statistics {}",
+                    description.timeline_semaphore, description.descriptor_indexing, description.dynamic_rendering,
+                    description.draw_indirect_count, description.multi_draw_indirect,
+                    description.pipeline_statistics_query);
+    RENDER_LOG_INFO("PHYSICAL DEVICE: Max Image 2D {}, Push Constants {} B, Compute Shared Memory {} B, Bound Sets {}, "
+                    "Draw Indirect Count {}, Timestamp Period {}ns",
+                    limits.maxImageDimension2D, limits.maxPushConstantsSize, limits.maxComputeSharedMemorySize,
+                    limits.maxBoundDescriptorSets, limits.maxDrawIndirectCount, limits.timestampPeriod);
+}
+// ENGINE_DEVICE, or ContextInfo::device_preference without it, an index into the enumeration or part of a name
+bool PreferredVkPhysicalDevice(const char* preference, uint32_t index, const VkPhysicalDeviceDescription& description) {
+    if (preference == nullptr || preference[0] == '\0') {
+        return false;
+    }
+    size_t length = strlen(preference);
+    if (std::all_of(preference, preference + length, [](char c) { return c >= '0' && c <= '9'; })) {
+        // Asked once per device, an index that does not parse is no preference rather than a failed startup
+        uint32_t preferred_index = 0;
+        std::from_chars_result result = std::from_chars(preference, preference + length, preferred_index);
+        if (result.ec != std::errc{}) {
+            RENDER_LOG_RATE_LIMITED(WARN, 1000, "PHYSICAL DEVICE: Ignoring Out of Range Device Index {}", preference);
+            return false;
+        }
+        return preferred_index == index;
+    }
+    return strstr(description.properties.deviceName, preference) != nullptr;
+}
+} // namespace
+
+/* 0 for a device that cannot run the engine. Otherwise the device type dominates, so a discrete GPU wins
+ * over an integrated one and both over a software rasterizer, and device local memory, queue families,
+ * optional features and limits order devices of one type. */
 uint32_t RateVkPhysicalDevice(VkPhysicalDevice vk_physical_device, std::vector<const char*> device_extension_names) {
     auto unsupported_extensions = validation::VkDeviceExtensionSupport(vk_physical_device, device_extension_names);
     if (unsupported_extensions.size() > 0) {
@@ -98,7 +269,41 @@ uint32_t RateVkPhysicalDevice(VkPhysicalDevice vk_physical_device, std::vector<c
         RENDER_LOG_ERROR("The Following VkDevice Extensions are Unsupported: {}", unsupported_extension_string);
         return 0;
     }
-    return 1;
+    const VkPhysicalDeviceDescription& description = DescribeVkPhysicalDevice(vk_physical_device);
+    if (description.properties.apiVersion < VK_API_VERSION_1_2 || !description.universal_family) {
+        return 0;
+    }
+
+    uint32_t rating = 1;
+    switch (description.properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+        rating += 100000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+        rating += 50000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+        rating += 25000;
+        break;
+    case VK_PHYSICAL_DEVICE_TYPE_OTHER:
+        rating += 10000;
+        break;
+    default:
+        break;
+    }
+    // A point per 64 MB, up to 1 TB
+    rating += (uint32_t)std::min<VkDeviceSize>(description.device_local_bytes >> 26, 16384);
+    rating += description.dedicated_compute_family ? 2000 : 0;
+    rating += description.dedicated_transfer_family ? 2000 : 0;
+    rating += description.timeline_semaphore ? 1000 : 0;
+    rating += description.descriptor_indexing ? 1000 : 0;
+    rating += description.dynamic_rendering ? 1000 : 0;
+    rating += description.draw_indirect_count ? 500 : 0;
+    rating += description.multi_draw_indirect ? 500 : 0;
+    rating += description.pipeline_statistics_query ? 100 : 0;
+    rating += description.properties.limits.maxImageDimension2D / 1024;
+    rating += std::min(description.properties.limits.maxComputeSharedMemorySize / 1024, 64u);
+    return rating;
 }
 VulkanQueueIndices QueryVkPhysicalDeviceQueueSupport(VkPhysicalDevice vk_physical_device) {
     VulkanQueueIndices queue_indices{};
@@ -120,9 +325,46 @@ VulkanQueueIndices QueryVkPhysicalDeviceQueueSupport(VkPhysicalDevice vk_physica
     return queue_indices;
 }
 
+namespace {
+std::vector<char> ReadPipelineCache(const std::string& filepath) {
+    std::ifstream input(filepath, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+}
+// Not every driver rejects the data of another driver or device, so it is checked before creation
+bool PipelineCacheCompatible(const std::vector<char>& data, const VkPhysicalDeviceProperties& properties) {
+    VkPipelineCacheHeaderVersionOne header{};
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header.vendorID == properties.vendorID && header.deviceID == properties.deviceID &&
+           memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+void WritePipelineCache(const std::string& filepath, VkDevice vk_device, VkPipelineCache vk_pipeline_cache) {
+    size_t size = 0;
+    vkGetPipelineCacheData(vk_device, vk_pipeline_cache, &size, nullptr);
+    std::vector<char> data(size);
+    if (vkGetPipelineCacheData(vk_device, vk_pipeline_cache, &size, data.data()) != VK_SUCCESS) {
+        RENDER_LOG_ERROR("CONTEXT DESTRUCTION: Failed to Get VkPipelineCache Data!");
+        return;
+    }
+    std::ofstream output(filepath, std::ios::binary | std::ios::trunc);
+    if (!output.write(data.data(), (std::streamsize)size)) {
+        RENDER_LOG_ERROR("CONTEXT DESTRUCTION: Failed to Write Pipeline Cache {}!", filepath);
+    }
+}
+} // namespace
+
 render::Context context{};
 Context CreateContext(ContextInfo info) {
     Context context{};
+    // The file is read while the instance and device are created, it is only needed once the device exists
+    std::future<std::vector<char>> pipeline_cache_data{};
+    if (info.pipeline_cache_filepath != nullptr) {
+        context.pipeline_cache_filepath = info.pipeline_cache_filepath;
+        pipeline_cache_data = std::async(std::launch::async, ReadPipelineCache, context.pipeline_cache_filepath);
+    }
     std::vector<const char*> extension_names{};
 
     if (info.window) {
@@ -133,7 +375,12 @@ Context CreateContext(ContextInfo info) {
                                                       extension_names.data());
     }
 
-    extension_names.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+    // Only MoltenVK style implementations expose portability enumeration, lavapipe and SwiftShader do not
+    bool portability_enumeration =
+        validation::VkInstanceExtensionSupport({VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME}).size() == 0;
+    if (portability_enumeration) {
+        extension_names.emplace_back(VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
+    }
     extension_names.emplace_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
 
     if (info.enable_validation_layers) {
@@ -153,12 +400,14 @@ Context CreateContext(ContextInfo info) {
     if (info.enable_validation_layers) {
         layer_names.emplace_back("VK_LAYER_KHRONOS_validation");
     }
-    auto unsupported_layers = validation::VkInstanceExtensionSupport(extension_names);
+    auto unsupported_layers = validation::VkInstanceLayerSupport(layer_names);
     if (unsupported_layers.size() > 0) {
         std::string unsupported_layer_string;
         for (const char* layer : unsupported_layers) {
             unsupported_layer_string += layer;
             unsupported_layer_string += ", ";
+            // Build machines often lack the validation layers, run without them rather than fail instance creation
+            layer_names.erase(std::find(layer_names.begin(), layer_names.end(), layer));
         }
         RENDER_LOG_ERROR("The Following VkInstance Layers are Unsupported: {}", unsupported_layer_string);
     }
@@ -176,7 +425,7 @@ Context CreateContext(ContextInfo info) {
     VkInstanceCreateInfo instance_create_info{};
     instance_create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     instance_create_info.pNext = nullptr;
-    instance_create_info.flags = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+    instance_create_info.flags = portability_enumeration ? VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR : 0;
 
     instance_create_info.pApplicationInfo = &application_info;
 
@@ -213,7 +462,6 @@ Context CreateContext(ContextInfo info) {
     }
 
     std::vector<const char*> device_extension_names{};
-    device_extension_names.emplace_back("VK_KHR_portability_subset");
     if (info.window) {
         device_extension_names.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
     }
@@ -222,19 +470,47 @@ Context CreateContext(ContextInfo info) {
     vkEnumeratePhysicalDevices(context.vk_instance, &physical_device_count, nullptr);
     VkPhysicalDevice* physical_devices = new VkPhysicalDevice[physical_device_count];
     vkEnumeratePhysicalDevices(context.vk_instance, &physical_device_count, physical_devices);
+    const char* device_preference = std::getenv("ENGINE_DEVICE");
+    if (device_preference == nullptr) {
+        device_preference = info.device_preference;
+    }
+    bool preference_matched = false;
     std::vector<std::tuple<uint32_t, VkPhysicalDevice>> rated_physical_devices;
     for (unsigned int i = 0; i < physical_device_count; i++) {
-        rated_physical_devices.emplace_back(
-            std::make_tuple(RateVkPhysicalDevice(physical_devices[i], device_extension_names), physical_devices[i]));
+        uint32_t rating = RateVkPhysicalDevice(physical_devices[i], device_extension_names);
+        const VkPhysicalDeviceDescription& description = DescribeVkPhysicalDevice(physical_devices[i]);
+        // A preferred device is tried first, unless it cannot run the engine at all
+        if (rating > 0 && PreferredVkPhysicalDevice(device_preference, i, description)) {
+            rating = UINT32_MAX;
+            preference_matched = true;
+        }
+        RENDER_LOG_INFO("PHYSICAL DEVICE {}: {}, {} GPU, Rating {}", i, description.properties.deviceName,
+                        VkPhysicalDeviceTypeName(description.properties.deviceType), rating);
+        if (rating > 0) {
+            rated_physical_devices.emplace_back(std::make_tuple(rating, physical_devices[i]));
+        }
     }
     delete[] physical_devices;
-    // Sort By First Element of Tuple / Device Rating
-    std::sort(rated_physical_devices.begin(), rated_physical_devices.end());
+    if (device_preference != nullptr && !preference_matched) {
+        RENDER_LOG_WARN("CONTEXT CREATION: No Usable Physical Device Matches Preference {}", device_preference);
+    }
+    // Highest rating first, devices of equal rating in enumeration order
+    std::stable_sort(rated_physical_devices.begin(), rated_physical_devices.end(),
+                     [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
 
     VulkanQueueIndices queue_indices{};
+    bool memory_budget = false;
     for (std::tuple<uint32_t, VkPhysicalDevice> tuple : rated_physical_devices) {
         auto vk_physical_device = std::get<1>(tuple);
 
+        // Optional extensions are enabled per device, portability_subset must be enabled wherever it is exposed
+        std::vector<const char*> enabled_extension_names = device_extension_names;
+        for (const char* optional_extension : {"VK_KHR_portability_subset", VK_EXT_MEMORY_BUDGET_EXTENSION_NAME}) {
+            if (validation::VkDeviceExtensionSupport(vk_physical_device, {optional_extension}).size() == 0) {
+                enabled_extension_names.emplace_back(optional_extension);
+            }
+        }
+
         queue_indices = QueryVkPhysicalDeviceQueueSupport(vk_physical_device);
         float priority = 1.0f;
         std::vector<VkDeviceQueueCreateInfo> device_queue_create_info{};
@@ -251,25 +527,45 @@ Context CreateContext(ContextInfo info) {
             device_queue_create_info.emplace_back(queue_create_info);
         }
 
+        VkPhysicalDeviceVulkan12Features supported_vulkan12_features{};
+        supported_vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 supported_features2{};
+        supported_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        supported_features2.pNext = &supported_vulkan12_features;
+        vkGetPhysicalDeviceFeatures2(vk_physical_device, &supported_features2);
+        const VkPhysicalDeviceFeatures& supported_features = supported_features2.features;
         VkPhysicalDeviceFeatures device_features{};
+        device_features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
+        device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+        device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+        VkPhysicalDeviceVulkan12Features vulkan12_features{};
+        vulkan12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        vulkan12_features.drawIndirectCount = supported_vulkan12_features.drawIndirectCount;
 
         VkDeviceCreateInfo device_create_info{};
         device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        device_create_info.pNext = nullptr;
+        device_create_info.pNext = &vulkan12_features;
         device_create_info.flags = 0;
 
         device_create_info.queueCreateInfoCount = (uint32_t)device_queue_create_info.size();
         device_create_info.pQueueCreateInfos = device_queue_create_info.data();
 
-        device_create_info.enabledExtensionCount = (uint32_t)device_extension_names.size();
-        device_create_info.ppEnabledExtensionNames = device_extension_names.data();
+        device_create_info.enabledExtensionCount = (uint32_t)enabled_extension_names.size();
+        device_create_info.ppEnabledExtensionNames = enabled_extension_names.data();
         device_create_info.enabledLayerCount = (uint32_t)layer_names.size();
         device_create_info.ppEnabledLayerNames = layer_names.data();
         device_create_info.pEnabledFeatures = &device_features;
 
         result = vkCreateDevice(vk_physical_device, &device_create_info, nullptr, &context.vk_device);
         if (result == VK_SUCCESS) {
+            LogVkPhysicalDevice(DescribeVkPhysicalDevice(vk_physical_device));
             context.vk_physical_device = vk_physical_device;
+            context.vk_enabled_features = device_features;
+            context.vk_enabled_vulkan12_features = vulkan12_features;
+            memory_budget = std::find_if(enabled_extension_names.begin(), enabled_extension_names.end(),
+                                         [](const char* name) {
+                                             return strcmp(name, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+                                         }) != enabled_extension_names.end();
             break;
         }
     }
@@ -278,13 +574,17 @@ Context CreateContext(ContextInfo info) {
     }
     context.universal_queue.vk_family_index = queue_indices.universal_family_index;
     vkGetDeviceQueue(context.vk_device, context.universal_queue.vk_family_index, 0, &context.universal_queue.vk_queue);
+    // Presentation and compute go through the universal queue
+    context.present_queue = context.universal_queue;
+    context.compute_queue = context.universal_queue;
 
     VmaVulkanFunctions vma_vulkan_functions = {};
     vma_vulkan_functions.vkGetInstanceProcAddr = &vkGetInstanceProcAddr;
     vma_vulkan_functions.vkGetDeviceProcAddr = &vkGetDeviceProcAddr;
 
     VmaAllocatorCreateInfo allocator_create_info = {};
-    allocator_create_info.flags = VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    // Without VK_EXT_memory_budget VMA estimates the budget from the heap sizes
+    allocator_create_info.flags = memory_budget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0;
     allocator_create_info.vulkanApiVersion = VK_API_VERSION_1_2;
     allocator_create_info.physicalDevice = context.vk_physical_device;
     allocator_create_info.device = context.vk_device;
@@ -294,19 +594,82 @@ Context CreateContext(ContextInfo info) {
     if (result != VK_SUCCESS) {
         RENDER_LOG_ERROR("CONTEXT CREATION: Failed to Create VmaAllocator!");
     }
+
+    std::vector<char> initial_data = pipeline_cache_data.valid() ? pipeline_cache_data.get() : std::vector<char>{};
+    if (!initial_data.empty() && context.vk_device != VK_NULL_HANDLE &&
+        !PipelineCacheCompatible(initial_data, DescribeVkPhysicalDevice(context.vk_physical_device).properties)) {
+        RENDER_LOG_WARN("CONTEXT CREATION: Pipeline Cache {} Belongs to Another Device!",
+                        context.pipeline_cache_filepath);
+        initial_data.clear();
+    }
+    VkPipelineCacheCreateInfo pipeline_cache_create_info{};
+    pipeline_cache_create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    pipeline_cache_create_info.pNext = nullptr;
+    pipeline_cache_create_info.flags = 0;
+    pipeline_cache_create_info.initialDataSize = initial_data.size();
+    pipeline_cache_create_info.pInitialData = initial_data.data();
+    result = vkCreatePipelineCache(context.vk_device, &pipeline_cache_create_info, nullptr, &context.vk_pipeline_cache);
+    if (result != VK_SUCCESS) {
+        RENDER_LOG_ERROR("CONTEXT CREATION: Failed to Create VkPipelineCache!");
+        context.vk_pipeline_cache = VK_NULL_HANDLE;
+    }
     return context;
 }
 void DestroyContext(Context context) {
+    if (context.vk_pipeline_cache != VK_NULL_HANDLE) {
+        if (!context.pipeline_cache_filepath.empty()) {
+            WritePipelineCache(context.pipeline_cache_filepath, context.vk_device, context.vk_pipeline_cache);
+        }
+        vkDestroyPipelineCache(context.vk_device, context.vk_pipeline_cache, nullptr);
+    }
     vmaDestroyAllocator(context.vma_allocator);
 
     vkDestroyDevice(context.vk_device, nullptr);
 
     vkutil::DestroyDebugUtilsMessengerEXT(context.vk_instance, context.vk_debug_utils_messenger, nullptr);
     vkDestroyInstance(context.vk_instance, nullptr);
+
+    validation::ClearCapabilities();
+    physical_device_descriptions.clear();
+}
+
+namespace {
+core::Pool<CommandPool> command_pool_pool{};
+core::Pool<Fence> fence_pool{};
+core::Pool<Swapchain> swapchain_pool{};
+core::Pool<Renderpass> renderpass_pool{};
+core::Pool<Framebuffer> framebuffer_pool{};
+core::Pool<Pipeline> pipeline_pool{};
+} // namespace
+CommandPool* Resolve(CommandPoolHandle handle) {
+    return core::pool::Get(&command_pool_pool, handle);
 }
+CommandBuffer* Resolve(CommandPool* pool, CommandBufferHandle handle) {
+    return core::pool::Get(&pool->command_buffers, handle);
+}
+Fence* Resolve(FenceHandle handle) {
+    return core::pool::Get(&fence_pool, handle);
+}
+Swapchain* Resolve(SwapchainHandle handle) {
+    return core::pool::Get(&swapchain_pool, handle);
+}
+Renderpass* Resolve(RenderpassHandle handle) {
+    return core::pool::Get(&renderpass_pool, handle);
+}
+Framebuffer* Resolve(FramebufferHandle handle) {
+    return core::pool::Get(&framebuffer_pool, handle);
+}
+Pipeline* Resolve(PipelineHandle handle) {
+    return core::pool::Get(&pipeline_pool, handle);
+}
+
+// Closures queued on the record threads that have not finished yet, see AwaitRecording
+std::mutex recording_mutex{};
+uint32_t recording_count = 0;
+std::condition_variable recording_condition{};
 
 CommandPool* CreateCommandPool() {
-    CommandPool* pool = new CommandPool{};
+    CommandPool* pool = core::pool::Create(&command_pool_pool);
     VkCommandPoolCreateInfo pool_create_info{};
     pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
     pool_create_info.pNext = nullptr;
@@ -323,28 +686,33 @@ CommandPool* CreateCommandPool() {
     return pool;
 }
 void DestroyCommandPool(CommandPool* pool) {
+    // The record thread runs what is still queued before it exits, so AwaitRecording never waits on a lost closure
     pool->mutex.lock();
     pool->active = false;
-    pool->record_queue.emplace_back([]() {});
     pool->mutex.unlock();
     pool->condition_variable.notify_all();
 
     pool->record_thread.join();
 
     vkDestroyCommandPool(context.vk_device, pool->vk_command_pool, nullptr);
-    for (auto command_buffer : pool->free_command_buffer_queue) {
-        delete command_buffer;
+    for (auto& frame_allocators : pool->frame_allocators) {
+        for (FrameCommandAllocator& allocator : frame_allocators) {
+            vkDestroyCommandPool(context.vk_device, allocator.vk_command_pool, nullptr);
+        }
     }
-    delete pool;
+    // Borrowed command buffers go as well, their VkCommandBuffers were freed with the VkCommandPools
+    core::pool::Finalize(&pool->command_buffers);
+    core::pool::Destroy(&command_pool_pool, pool);
 }
 namespace command_pool {
 CommandBuffer* BorrowCommandBuffer(CommandPool* pool) {
-    if (pool->free_command_buffer_queue.size() != 0) {
-        auto command_buffer = pool->free_command_buffer_queue.back();
-        pool->free_command_buffer_queue.pop_back();
+    std::lock_guard<std::mutex> lock(pool->free_command_buffer_mutex);
+    if (pool->free_command_buffers.size() != 0) {
+        auto command_buffer = pool->free_command_buffers.back();
+        pool->free_command_buffers.pop_back();
         return command_buffer;
     }
-    auto command_buffer = new CommandBuffer{};
+    auto command_buffer = core::pool::Create(&pool->command_buffers);
     VkCommandBufferAllocateInfo allocate_info{};
     allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocate_info.pNext = nullptr;
@@ -359,7 +727,8 @@ CommandBuffer* BorrowCommandBuffer(CommandPool* pool) {
     return command_buffer;
 }
 void ReturnCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer) {
-    pool->free_command_buffer_queue.emplace_front(command_buffer);
+    std::lock_guard<std::mutex> lock(pool->free_command_buffer_mutex);
+    pool->free_command_buffers.emplace_back(command_buffer);
 }
 void ResetCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer) {
     pool->completion_mutex.lock();
@@ -368,39 +737,141 @@ void ResetCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer) {
     pool->completion_mutex.unlock();
 }
 
+CommandBuffer* AllocateFrameCommandBuffer(CommandPool* pool) {
+    std::thread::id thread_id = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(pool->frame_allocator_mutex);
+    std::vector<FrameCommandAllocator>& frame_allocators = pool->frame_allocators[frame % frames_in_flight];
+    auto allocator = std::find_if(frame_allocators.begin(), frame_allocators.end(),
+                                  [thread_id](const FrameCommandAllocator& allocator) {
+                                      return allocator.thread_id == thread_id;
+                                  });
+    if (allocator == frame_allocators.end()) {
+        VkCommandPoolCreateInfo pool_create_info{};
+        pool_create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_create_info.pNext = nullptr;
+        // Reset as a whole, so no flag allowing buffers to be reset one by one
+        pool_create_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        pool_create_info.queueFamilyIndex = context.universal_queue.vk_family_index;
+        FrameCommandAllocator new_allocator{};
+        new_allocator.thread_id = thread_id;
+        VkResult result =
+            vkCreateCommandPool(context.vk_device, &pool_create_info, nullptr, &new_allocator.vk_command_pool);
+        if (result != VK_SUCCESS) {
+            RENDER_LOG_ERROR("FRAME COMMAND ALLOCATOR: Failed to Create VkCommandPool!");
+        }
+        allocator = frame_allocators.insert(frame_allocators.end(), new_allocator);
+    }
+
+    if (allocator->used_count == allocator->command_buffers.size()) {
+        CommandBuffer* command_buffer = core::pool::Create(&pool->command_buffers);
+        VkCommandBufferAllocateInfo allocate_info{};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.pNext = nullptr;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+        allocate_info.commandPool = allocator->vk_command_pool;
+        VkResult result =
+            vkAllocateCommandBuffers(context.vk_device, &allocate_info, &command_buffer->vk_command_buffer);
+        if (result != VK_SUCCESS) {
+            RENDER_LOG_ERROR("FRAME COMMAND ALLOCATOR: Failed to Allocate VkCommandBuffer!");
+        }
+        allocator->command_buffers.emplace_back(command_buffer);
+    }
+    return allocator->command_buffers[allocator->used_count++];
+}
+void BeginFrame(CommandPool* pool) {
+    CORE_TRACE_ZONE("command_pool::BeginFrame");
+    std::lock_guard<std::mutex> lock(pool->frame_allocator_mutex);
+    // One reset per thread that recorded in the frame, in place of one per command buffer
+    for (FrameCommandAllocator& allocator : pool->frame_allocators[frame % frames_in_flight]) {
+        if (allocator.used_count > 0) {
+            vkResetCommandPool(context.vk_device, allocator.vk_command_pool, 0);
+            allocator.used_count = 0;
+        }
+    }
+}
+
 void RecordThreadFunction(CommandPool* pool) {
-    while (pool->active) {
+    CORE_TRACE_THREAD_NAME("record");
+    while (true) {
         std::unique_lock<std::mutex> lock(pool->mutex);
-        pool->condition_variable.wait(lock, [pool]() { return pool->record_queue.size() > 0; });
-        auto function = pool->record_queue.front();
-        pool->record_queue.pop_front();
+        pool->condition_variable.wait(
+            lock, [pool]() { return !pool->active || pool->record_queue_head < pool->record_queue.size(); });
+        if (pool->record_queue_head == pool->record_queue.size()) {
+            return;
+        }
+        auto function = std::move(pool->record_queue[pool->record_queue_head++]);
+        if (pool->record_queue_head == pool->record_queue.size()) {
+            pool->record_queue.clear();
+            pool->record_queue_head = 0;
+        }
         lock.unlock();
 
         function();
+        recording_mutex.lock();
+        recording_count--;
+        recording_mutex.unlock();
+        recording_condition.notify_all();
     }
 }
 void RecordAsync(CommandPool* pool, CommandBuffer* command_buffer, std::function<void()> function) {
+    CommandBufferHandle handle = core::pool::HandleOf(command_buffer);
+    QueueRecord(pool, command_buffer, [pool, handle, function = std::move(function)]() {
+        if (Resolve(pool, handle) == nullptr) {
+            RENDER_LOG_RATE_LIMITED(ERROR, 1000, "COMMAND RECORDING: Command Buffer Destroyed Before Recording!");
+            return;
+        }
+        function();
+    });
+}
+void QueueRecord(CommandPool* pool, CommandBuffer* command_buffer, std::function<void()> function) {
+    CORE_TRACE_ZONE("RecordAsync");
+    assert(core::pool::Alive(pool) && core::pool::Alive(command_buffer));
+#ifdef ENGINE_ENABLE_TRACING
+    uint64_t flow_id = core::trace::NewFlowId();
+    CORE_TRACE_FLOW_BEGIN("frame", flow_id);
+    function = [function = std::move(function), flow_id]() {
+        CORE_TRACE_ZONE("Record");
+        CORE_TRACE_FLOW_STEP("frame", flow_id);
+        function();
+    };
+#endif
     pool->completion_mutex.lock();
     command_buffer->completion_flag = false;
+#ifdef ENGINE_ENABLE_TRACING
+    command_buffer->trace_flow_id = flow_id;
+#endif
     pool->completion_mutex.unlock();
 
+    recording_mutex.lock();
+    recording_count++;
+    recording_mutex.unlock();
+
     pool->mutex.lock();
-    pool->record_queue.emplace_back(function);
+    pool->record_queue.emplace_back(std::move(function));
     pool->mutex.unlock();
 
     pool->condition_variable.notify_all();
 }
 void AwaitRecord(CommandPool* pool, CommandBuffer* command_buffer) {
+    CORE_TRACE_ZONE("AwaitRecord");
     std::unique_lock<std::mutex> lock(pool->completion_mutex);
     pool->completion_condition_variable.wait(lock, [command_buffer] { return command_buffer->completion_flag; });
+    CORE_TRACE_FLOW_STEP("frame", command_buffer->trace_flow_id);
     lock.unlock();
 }
 } // namespace command_pool
+void AwaitRecording() {
+    CORE_TRACE_ZONE("AwaitRecording");
+    std::unique_lock<std::mutex> lock(recording_mutex);
+    recording_condition.wait(lock, []() { return recording_count == 0; });
+}
 
 namespace renderpass {
-void Initialize(Renderpass* renderpass, RenderpassInfo info) {
-    std::vector<VkAttachmentDescription> vk_attachment_descriptions{};
-    for (Attachment& attachment : info.attachments) {
+void Initialize(Renderpass* renderpass, const RenderpassInfo& info) {
+    core::ScratchScope scratch{};
+    core::ArenaVector<VkAttachmentDescription> vk_attachment_descriptions(scratch.arena);
+    for (const Attachment& attachment : info.attachments) {
         VkAttachmentDescription vk_attachment{};
         vk_attachment.flags = 0;
         vk_attachment.initialLayout = attachment.initial_layout;
@@ -424,14 +895,14 @@ void Initialize(Renderpass* renderpass, RenderpassInfo info) {
         vk_attachment_descriptions.emplace_back(vk_attachment);
     }
 
-    std::vector<VkSubpassDescription> vk_subpass_descriptions{};
-    for (Subpass& subpass : info.subpasses) {
+    core::ArenaVector<VkSubpassDescription> vk_subpass_descriptions(scratch.arena);
+    for (const Subpass& subpass : info.subpasses) {
         VkSubpassDescription vk_subpass{};
         vk_subpass.flags = 0;
         vk_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         vk_subpass.colorAttachmentCount = (uint32_t)subpass.color_attachments.size();
-        vk_subpass.pColorAttachments = (VkAttachmentReference*)subpass.color_attachments.data();
-        vk_subpass.pDepthStencilAttachment = (VkAttachmentReference*)subpass.depth_stencil_attachment;
+        vk_subpass.pColorAttachments = (const VkAttachmentReference*)subpass.color_attachments.data();
+        vk_subpass.pDepthStencilAttachment = (const VkAttachmentReference*)subpass.depth_stencil_attachment;
         vk_subpass_descriptions.emplace_back(vk_subpass);
     }
 
@@ -453,25 +924,25 @@ void Initialize(Renderpass* renderpass, RenderpassInfo info) {
 void Finalize(Renderpass* renderpass) {
     vkDestroyRenderPass(render::context.vk_device, renderpass->vk_render_pass, nullptr);
 }
-void Recreate(Renderpass* renderpass, RenderpassInfo info) {
+void Recreate(Renderpass* renderpass, const RenderpassInfo& info) {
     Finalize(renderpass);
     Initialize(renderpass, info);
 }
 } // namespace renderpass
 Renderpass* CreateRenderpass(RenderpassInfo info) {
-    auto renderpass = new Renderpass{};
+    auto renderpass = core::pool::Create(&renderpass_pool);
     renderpass->recreation_info = info;
     renderpass::Initialize(renderpass, info);
     return renderpass;
 }
 void DestroyRenderpass(Renderpass* renderpass) {
     renderpass::Finalize(renderpass);
-    delete renderpass;
+    core::pool::Destroy(&renderpass_pool, renderpass);
 }
 void CreateInstance();
 
 namespace framebuffer {
-void Initialize(Framebuffer* framebuffer, FramebufferInfo info) {
+void Initialize(Framebuffer* framebuffer, const FramebufferInfo& info) {
     VkFramebufferCreateInfo create_info{};
     create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
     create_info.flags = 0;
@@ -482,15 +953,23 @@ void Initialize(Framebuffer* framebuffer, FramebufferInfo info) {
     create_info.height = info.extent.y;
     create_info.layers = info.extent.z;
 
+    const std::vector<VkImageView>* target_views = nullptr;
     if (info.swapchain != nullptr) {
-        Swapchain* swapchain = (Swapchain*)info.swapchain;
-
-        uint32_t swapchain_attachment_index = info.attachments.size();
-        info.attachments.emplace_back(VkImageView{VK_NULL_HANDLE});
-        create_info.attachmentCount = info.attachments.size();
-        create_info.pAttachments = info.attachments.data();
-        for (auto view : swapchain->vk_image_views) {
-            info.attachments[swapchain_attachment_index] = view;
+        target_views = &info.swapchain->vk_image_views;
+    } else if (info.offscreen_target != nullptr) {
+        target_views = &info.offscreen_target->vk_image_views;
+    }
+    if (target_views != nullptr) {
+        // The attachments with a slot for the target view after them
+        core::ScratchScope scratch{};
+        core::ArenaVector<VkImageView> attachments(scratch.arena);
+        attachments.reserve(info.attachments.size() + 1);
+        attachments.assign(info.attachments.begin(), info.attachments.end());
+        attachments.emplace_back(VkImageView{VK_NULL_HANDLE});
+        create_info.attachmentCount = (uint32_t)attachments.size();
+        create_info.pAttachments = attachments.data();
+        for (auto view : *target_views) {
+            attachments.back() = view;
             VkFramebuffer vk_framebuffer = VK_NULL_HANDLE;
             VkResult result = vkCreateFramebuffer(context.vk_device, &create_info, nullptr, &vk_framebuffer);
             if (result != VK_SUCCESS) {
@@ -519,20 +998,20 @@ void Finalize(Framebuffer* framebuffer) {
     framebuffer->vk_framebuffer = {};
 }
 
-void Recreate(Framebuffer* framebuffer, FramebufferInfo info) {
+void Recreate(Framebuffer* framebuffer, const FramebufferInfo& info) {
     Finalize(framebuffer);
     Initialize(framebuffer, info);
 }
 } // namespace framebuffer
 Framebuffer* CreateFramebuffer(FramebufferInfo info) {
-    auto framebuffer = new Framebuffer{};
+    auto framebuffer = core::pool::Create(&framebuffer_pool);
     framebuffer->recreation_info = info;
     framebuffer::Initialize(framebuffer, info);
     return framebuffer;
 }
 void DestroyFramebuffer(Framebuffer* framebuffer) {
     framebuffer::Finalize(framebuffer);
-    delete framebuffer;
+    core::pool::Destroy(&framebuffer_pool, framebuffer);
 }
 
 VkSurfaceFormatKHR SelectVkSwapchainSurfaceFormat(VkSurfaceKHR vk_surface) {
@@ -553,7 +1032,7 @@ VkSurfaceFormatKHR SelectVkSwapchainSurfaceFormat(VkSurfaceKHR vk_surface) {
     delete[] available_surface_formats;
     return chosen_surface_format;
 }
-VkPresentModeKHR SelectVkSwapchainPresentMode(VkSurfaceKHR vk_surface) {
+VkPresentModeKHR SelectVkSwapchainPresentMode(VkSurfaceKHR vk_surface, PresentMode present_mode) {
     uint32_t available_present_mode_count;
     vkGetPhysicalDeviceSurfacePresentModesKHR(render::context.vk_physical_device, vk_surface,
                                               &available_present_mode_count, nullptr);
@@ -561,20 +1040,44 @@ VkPresentModeKHR SelectVkSwapchainPresentMode(VkSurfaceKHR vk_surface) {
     vkGetPhysicalDeviceSurfacePresentModesKHR(render::context.vk_physical_device, vk_surface,
                                               &available_present_mode_count, available_present_modes);
 
+    // In order of preference, FIFO is always supported and ends every list
+    std::vector<VkPresentModeKHR> preferred_present_modes{};
+    switch (present_mode) {
+    case PRESENT_MODE_FIFO:
+        break;
+    case PRESENT_MODE_FIFO_RELAXED:
+        preferred_present_modes = {VK_PRESENT_MODE_FIFO_RELAXED_KHR};
+        break;
+    case PRESENT_MODE_MAILBOX:
+        preferred_present_modes = {VK_PRESENT_MODE_MAILBOX_KHR};
+        break;
+    case PRESENT_MODE_IMMEDIATE:
+        preferred_present_modes = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR};
+        break;
+    }
+    preferred_present_modes.emplace_back(VK_PRESENT_MODE_FIFO_KHR);
+
     VkPresentModeKHR chosen_present_mode = VK_PRESENT_MODE_FIFO_KHR;
-    for (int i = 0; i < available_present_mode_count; i++) {
-        if (available_present_modes[i] == VK_PRESENT_MODE_MAILBOX_KHR) {
-            chosen_present_mode = available_present_modes[i];
+    for (VkPresentModeKHR preferred_present_mode : preferred_present_modes) {
+        auto end = available_present_modes + available_present_mode_count;
+        if (std::find(available_present_modes, end, preferred_present_mode) != end) {
+            chosen_present_mode = preferred_present_mode;
             break;
         }
     }
     delete[] available_present_modes;
+    if (chosen_present_mode != preferred_present_modes.front()) {
+        // Recreation on every resize would repeat it
+        RENDER_LOG_RATE_LIMITED(WARN, 10000, "SWAPCHAIN CREATION: Present Mode Unsupported, Using VkPresentModeKHR {}",
+                                (int)chosen_present_mode);
+    }
     return chosen_present_mode;
 }
 struct VkSwapchainImageDetails {
     Extent2D extent;
     uint32_t image_count;
     VkSurfaceTransformFlagBitsKHR pre_transform;
+    VkImageUsageFlags supported_usage;
 };
 VkSwapchainImageDetails QueryVkSwapchainImageDetails(core::Window window, VkSurfaceKHR vk_surface) {
     VkSwapchainImageDetails image_details{};
@@ -597,6 +1100,7 @@ VkSwapchainImageDetails QueryVkSwapchainImageDetails(core::Window window, VkSurf
         image_details.image_count = vk_surface_capabilities.maxImageCount;
     }
     image_details.pre_transform = vk_surface_capabilities.currentTransform;
+    image_details.supported_usage = vk_surface_capabilities.supportedUsageFlags;
     return image_details;
 }
 void CreateSwapchainVkImageViews(Swapchain* swapchain) {
@@ -627,8 +1131,15 @@ void Initialize(Swapchain* swapchain) {
     if (swapchain->vk_surface == VK_NULL_HANDLE) {
         RENDER_LOG_ERROR("SWAPCHAIN CREATION: Failed to Create VkSurfaceKHR!");
     }
+    // The present queue was picked against the window of the context, other windows may be elsewhere
+    VkBool32 present_supported = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(context.vk_physical_device, context.present_queue.vk_family_index,
+                                         swapchain->vk_surface, &present_supported);
+    if (present_supported == VK_FALSE) {
+        RENDER_LOG_ERROR("SWAPCHAIN CREATION: Present Queue Cannot Present to VkSurfaceKHR!");
+    }
     swapchain->vk_surface_format = SelectVkSwapchainSurfaceFormat(swapchain->vk_surface);
-    auto present_mode = SelectVkSwapchainPresentMode(swapchain->vk_surface);
+    swapchain->vk_present_mode = SelectVkSwapchainPresentMode(swapchain->vk_surface, swapchain->present_mode);
     VkSwapchainImageDetails details = QueryVkSwapchainImageDetails(swapchain->window, swapchain->vk_surface);
 
     swapchain->extent = {details.extent.x, details.extent.y, 1};
@@ -643,7 +1154,10 @@ void Initialize(Swapchain* swapchain) {
     create_info.imageColorSpace = swapchain->vk_surface_format.colorSpace;
     create_info.imageExtent = *(VkExtent2D*)&details.extent;
     create_info.imageArrayLayers = 1;
+    // Capture copies out of the images where the surface allows it
     create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    create_info.imageUsage |= details.supported_usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    swapchain->vk_image_usage = create_info.imageUsage;
     if (context.universal_queue.vk_family_index != context.present_queue.vk_family_index) {
         uint32_t family_indices[] = {context.universal_queue.vk_family_index, context.present_queue.vk_family_index};
         create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
@@ -656,6 +1170,7 @@ void Initialize(Swapchain* swapchain) {
     }
     create_info.preTransform = details.pre_transform;
     create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    create_info.presentMode = swapchain->vk_present_mode;
     create_info.clipped = VK_TRUE;
     create_info.oldSwapchain = VK_NULL_HANDLE;
 
@@ -689,31 +1204,44 @@ void Recreate(Swapchain* swapchain) {
     }
 };
 
-void AcquireImage(Swapchain* swapchain, uint32_t* image_index, Semaphore semaphore, Fence* fence) {
+bool TakeOutOfDate(Swapchain* swapchain) { return swapchain->out_of_date.exchange(false); }
+bool AcquireImage(Swapchain* swapchain, uint32_t* image_index, Semaphore semaphore, Fence* fence) {
+    // Recreation idles the device, which waits on presents that need usage_mutex, so it is left to the frame thread
     swapchain->usage_mutex.lock();
     VkResult result = vkAcquireNextImageKHR(context.vk_device, swapchain->vk_swapchain, UINT64_MAX,
                                             semaphore.vk_semaphore, fence->vk_fence, image_index);
+    swapchain->usage_mutex.unlock();
     if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        RENDER_LOG_INFO("SWAPCHAIN IMAGE ACQUISITION: Swapchain Out of Date");
-        Recreate(swapchain);
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        RENDER_LOG_ERROR("SWAPCHAIN IMAGE ACQUISITION: Failed to Acquire Swapchain Image!");
+        RENDER_LOG_RATE_LIMITED(INFO, 1000, "SWAPCHAIN IMAGE ACQUISITION: Swapchain Out of Date");
+        swapchain->out_of_date.store(true);
+        return false;
     }
-    swapchain->usage_mutex.unlock();
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        RENDER_LOG_RATE_LIMITED(ERROR, 1000, "SWAPCHAIN IMAGE ACQUISITION: Failed to Acquire Swapchain Image!");
+        return false;
+    }
+    return true;
 }
 
 void BindRecreationFunction(Swapchain* swapchain, std::function<void()> function) {
     swapchain->recreation_functions.emplace_back(function);
 }
+void SetPresentMode(Swapchain* swapchain, PresentMode present_mode) {
+    if (swapchain->present_mode == present_mode) {
+        return;
+    }
+    swapchain->present_mode = present_mode;
+    Recreate(swapchain);
+}
 } // namespace swapchain
-Swapchain* CreateSwapchain(core::Window window) {
-    Swapchain* swapchain = new Swapchain{window};
+Swapchain* CreateSwapchain(core::Window window, PresentMode present_mode) {
+    Swapchain* swapchain = core::pool::Create(&swapchain_pool, window, present_mode);
     swapchain::Initialize(swapchain);
     return swapchain;
 }
 void DestroySwapchain(Swapchain* swapchain) {
     swapchain::Finalize(swapchain);
-    delete swapchain;
+    core::pool::Destroy(&swapchain_pool, swapchain);
 }
 
 namespace shader {
@@ -733,33 +1261,82 @@ VkShaderModule CompileSPIRV(size_t buffer_size, char* buffer) {
     }
     return vk_shader_module;
 }
+namespace {
+// A prefetched file is taken once, a shader reloaded later reads the file as it is then
+std::mutex prefetch_mutex{};
+std::unordered_map<std::string, asset::File> prefetched_files{};
+
+bool TakePrefetched(const std::string& filepath, asset::File* file) {
+    std::lock_guard<std::mutex> lock(prefetch_mutex);
+    auto iterator = prefetched_files.find(filepath);
+    if (iterator == prefetched_files.end()) {
+        return false;
+    }
+    *file = std::move(iterator->second);
+    prefetched_files.erase(iterator);
+    return true;
+}
+} // namespace
+std::string SpirvFilepath(const std::string& host_filepath) { return host_filepath + ".spirv"; }
+void CompileGLSLFile(ShaderStage stage, const std::string& host_filepath, const std::string& spirv_filepath) {
+    static std::atomic<uint64_t> compile_count{0};
+    std::string stage_argument("-fshader-stage=");
+    switch (stage) {
+    case SHADER_STAGE_VERTEX: {
+        stage_argument += "vertex ";
+        break;
+    }
+    case SHADER_STAGE_FRAGMENT: {
+        stage_argument += "fragment ";
+        break;
+    }
+    case SHADER_STAGE_COMPUTE: {
+        stage_argument += "compute ";
+        break;
+    }
+    }
+    std::string temporary_filepath =
+        spirv_filepath + "." + std::to_string(getpid()) + "." + std::to_string(compile_count++) + ".tmp";
+    std::string cmd =
+        std::string(RENDER_GLSLC_PATH) + " " + stage_argument + host_filepath + " -o " + temporary_filepath;
+    if (system(cmd.c_str()) != 0) {
+        std::remove(temporary_filepath.c_str());
+        throw std::runtime_error("FAILED TO COMPILE SHADER " + host_filepath);
+    }
+    if (std::rename(temporary_filepath.c_str(), spirv_filepath.c_str()) != 0) {
+        std::remove(temporary_filepath.c_str());
+        throw std::runtime_error("FAILED TO REPLACE SHADER " + spirv_filepath);
+    }
+}
+void Prefetch(const std::string& filepath) {
+    CORE_TRACE_ZONE("shader::Prefetch");
+    asset::File file{};
+    // A file that cannot be read is left to Initialize, which reports it
+    if (!asset::vfs::Read(filepath, &file)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(prefetch_mutex);
+    prefetched_files[filepath] = std::move(file);
+}
 void Initialize(Shader* pointer, ShaderInfo info) {
-    size_t name_end = info.filepath.find_last_of(".");
+    std::string spirv_filepath = info.filepath;
     switch (info.shader_code_format) {
     case SHADER_FORMAT_GLSL: {
-        std::string stage_argument("-fshader-stage=");
-        switch (info.shader_stage) {
-        case SHADER_STAGE_VERTEX: {
-            stage_argument += "vertex ";
-            break;
-        }
-        case SHADER_STAGE_FRAGMENT: {
-            stage_argument += "fragment ";
-            break;
-        }
+        // glslc needs the source on the host, so GLSL shaders cannot be served from an archive
+        std::string host_filepath;
+        if (!asset::vfs::HostPath(info.filepath, &host_filepath)) {
+            throw std::runtime_error("FAILED TO LOCATE SHADER " + info.filepath);
         }
-
-        std::string cmd = "/Users/natalie/VulkanSDK/1.3.268.1/macOS/bin/glslc " + stage_argument + info.filepath +
-                          " -o " + info.filepath.substr(0, name_end) + ".spirv";
-        system(cmd.c_str());
+        spirv_filepath = SpirvFilepath(host_filepath);
+        CompileGLSLFile(info.shader_stage, host_filepath, spirv_filepath);
     }
     case SHADER_FORMAT_SPIRV: {
-        size_t size = std::filesystem::file_size(info.filepath);
-        std::ifstream file(info.filepath);
-
-        char* buffer = new char[size];
-        file.read(buffer, size);
-        pointer->vk_shader_module = CompileSPIRV(size, buffer);
+        asset::File file{};
+        if (!TakePrefetched(spirv_filepath, &file) && !asset::vfs::Read(spirv_filepath, &file)) {
+            throw std::runtime_error("FAILED TO READ SHADER " + spirv_filepath);
+        }
+        pointer->shader_stage = info.shader_stage;
+        pointer->vk_shader_module = CompileSPIRV(file.size, const_cast<char*>(file.data));
         break;
     }
     }
@@ -777,14 +1354,23 @@ void DestroyShader(Shader* shader) {
 }
 
 namespace pipeline {
-void Initialize(Pipeline* pointer, PipelineInfo info) {
+VkPipeline Compile(PipelineInfo info, VkPipelineLayout vk_pipeline_layout) {
     std::vector<VkPipelineShaderStageCreateInfo> vk_shader_stage_info{};
     VkPipelineShaderStageCreateInfo stage_info{};
     stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     stage_info.pName = "main";
     for (ShaderInfo shader_info : info.shaders) {
+        Shader shader{};
+        try {
+            shader::Initialize(&shader, shader_info);
+        } catch (...) {
+            for (VkPipelineShaderStageCreateInfo info : vk_shader_stage_info) {
+                vkDestroyShaderModule(context.vk_device, info.module, nullptr);
+            }
+            throw;
+        }
         stage_info.stage = (VkShaderStageFlagBits)shader_info.shader_stage;
-        stage_info.module = CreateShader(shader_info)->vk_shader_module;
+        stage_info.module = shader.vk_shader_module;
         vk_shader_stage_info.emplace_back(stage_info);
     }
 
@@ -873,19 +1459,6 @@ void Initialize(Pipeline* pointer, PipelineInfo info) {
     blend_state.blendConstants[2] = 0.0f;
     blend_state.blendConstants[3] = 0.0f;
 
-    /* Pipeline Layout */
-    VkPipelineLayoutCreateInfo layout_info{};
-    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    /*layout_info.pushConstantRangeCount = (uint32_t)info.push_constant_ranges.size();
-    layout_info.pPushConstantRanges = (VkPushConstantRange*)info.push_constant_ranges.data();
-    layout_info.setLayoutCount = (uint32_t)info.descriptor_set_layouts.size();
-    layout_info.pSetLayouts = (VkDescriptorSetLayout*)info.descriptor_set_layouts.data();*/
-
-    VkResult vk_result = vkCreatePipelineLayout(context.vk_device, &layout_info, nullptr, &pointer->vk_pipeline_layout);
-    if (vk_result != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
-    }
-
     VkGraphicsPipelineCreateInfo pipeline_info{};
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipeline_info.stageCount = (uint32_t)vk_shader_stage_info.size();
@@ -900,7 +1473,7 @@ void Initialize(Pipeline* pointer, PipelineInfo info) {
     pipeline_info.pColorBlendState = &blend_state;
     pipeline_info.pDynamicState = &dynamic_state;
 
-    pipeline_info.layout = pointer->vk_pipeline_layout;
+    pipeline_info.layout = vk_pipeline_layout;
 
     pipeline_info.renderPass = info.renderpass->vk_render_pass;
     pipeline_info.subpass = 0;
@@ -909,15 +1482,70 @@ void Initialize(Pipeline* pointer, PipelineInfo info) {
     pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
     pipeline_info.basePipelineIndex = -1;
 
-    vk_result =
-        vkCreateGraphicsPipelines(context.vk_device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pointer->vk_pipeline);
+    VkPipeline vk_pipeline = VK_NULL_HANDLE;
+    VkResult vk_result = vkCreateGraphicsPipelines(context.vk_device, context.vk_pipeline_cache, 1, &pipeline_info,
+                                                   nullptr, &vk_pipeline);
 
+    for (VkPipelineShaderStageCreateInfo info : vk_shader_stage_info) {
+        vkDestroyShaderModule(context.vk_device, info.module, nullptr);
+    }
     if (vk_result != VK_SUCCESS) {
         throw std::runtime_error("FAILED TO CREATE GRAPHICS PIPELINE");
     }
-    for (VkPipelineShaderStageCreateInfo info : vk_shader_stage_info) {
-        vkDestroyShaderModule(context.vk_device, info.module, nullptr);
+    return vk_pipeline;
+}
+VkPipeline Compile(ComputePipelineInfo info, VkPipelineLayout vk_pipeline_layout) {
+    Shader shader{};
+    shader::Initialize(&shader, info.shader);
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = shader.vk_shader_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = vk_pipeline_layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = -1;
+
+    VkPipeline vk_pipeline = VK_NULL_HANDLE;
+    VkResult vk_result = vkCreateComputePipelines(context.vk_device, context.vk_pipeline_cache, 1, &pipeline_info,
+                                                  nullptr, &vk_pipeline);
+    shader::Finalize(&shader);
+    if (vk_result != VK_SUCCESS) {
+        throw std::runtime_error("FAILED TO CREATE COMPUTE PIPELINE");
+    }
+    return vk_pipeline;
+}
+namespace {
+VkPipelineLayout CreateVkPipelineLayout(const std::vector<PushConstantRange>& push_constant_ranges,
+                                        const std::vector<VkDescriptorSetLayout>& descriptor_set_layouts) {
+    VkPipelineLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layout_info.pushConstantRangeCount = (uint32_t)push_constant_ranges.size();
+    layout_info.pPushConstantRanges = (VkPushConstantRange*)push_constant_ranges.data();
+    layout_info.setLayoutCount = (uint32_t)descriptor_set_layouts.size();
+    layout_info.pSetLayouts = descriptor_set_layouts.data();
+
+    VkPipelineLayout vk_pipeline_layout = VK_NULL_HANDLE;
+    VkResult vk_result = vkCreatePipelineLayout(context.vk_device, &layout_info, nullptr, &vk_pipeline_layout);
+    if (vk_result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
     }
+    return vk_pipeline_layout;
+}
+} // namespace
+void Initialize(Pipeline* pointer, PipelineInfo info) {
+    pointer->vk_pipeline_layout = CreateVkPipelineLayout(info.push_constant_ranges, info.descriptor_set_layouts);
+    pointer->vk_bind_point = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    pointer->vk_pipeline = Compile(info, pointer->vk_pipeline_layout);
+    pointer->recreation_info = info;
+}
+void Initialize(Pipeline* pointer, ComputePipelineInfo info) {
+    pointer->vk_pipeline_layout = CreateVkPipelineLayout(info.push_constant_ranges, info.descriptor_set_layouts);
+    pointer->vk_bind_point = VK_PIPELINE_BIND_POINT_COMPUTE;
+    pointer->vk_pipeline = Compile(info, pointer->vk_pipeline_layout);
+    pointer->compute_recreation_info = info;
 }
 void Finalize(Pipeline* pointer) {
     vkDestroyPipeline(context.vk_device, pointer->vk_pipeline, nullptr);
@@ -925,13 +1553,18 @@ void Finalize(Pipeline* pointer) {
 }
 } // namespace pipeline
 Pipeline* CreatePipeline(PipelineInfo info) {
-    auto pipeline = new Pipeline{};
+    auto pipeline = core::pool::Create(&pipeline_pool);
+    pipeline::Initialize(pipeline, info);
+    return pipeline;
+}
+Pipeline* CreateComputePipeline(ComputePipelineInfo info) {
+    auto pipeline = core::pool::Create(&pipeline_pool);
     pipeline::Initialize(pipeline, info);
     return pipeline;
 }
 void DestroyPipeline(Pipeline* pointer) {
     pipeline::Finalize(pointer);
-    delete pointer;
+    core::pool::Destroy(&pipeline_pool, pointer);
 }
 
 namespace semaphore {
@@ -962,6 +1595,7 @@ void Initialize(Fence* pointer, FenceInitializationState init_state) {
 void Finalize(Fence* pointer) { vkDestroyFence(render::context.vk_device, pointer->vk_fence, nullptr); }
 
 void Await(Fence* fence) {
+    CORE_TRACE_ZONE("fence::Await");
     std::unique_lock<std::mutex> lock(submission_mutex);
     submission_condition.wait(lock, [fence] { return fence->submission_flag; });
     lock.unlock();
@@ -975,13 +1609,13 @@ void Reset(Fence* fence) {
 }
 } // namespace fence
 Fence* CreateFence(fence::FenceInitializationState init_state) {
-    auto fence = new Fence{};
+    auto fence = core::pool::Create(&fence_pool);
     fence::Initialize(fence, init_state);
     return fence;
 }
 void DestroyFence(Fence* fence) {
     fence::Finalize(fence);
-    delete fence;
+    core::pool::Destroy(&fence_pool, fence);
 }
 
 namespace command {
@@ -995,6 +1629,7 @@ void BeginCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer) {
 }
 void EndCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer) {
     vkEndCommandBuffer(command_buffer->vk_command_buffer);
+    stats::Count(STAT_COMMAND_BUFFERS_RECORDED);
     pool->completion_mutex.lock();
     command_buffer->completion_flag = true;
     pool->completion_mutex.unlock();
@@ -1002,15 +1637,29 @@ void EndCommandBuffer(CommandPool* pool, CommandBuffer* command_buffer) {
 }
 
 void BindPipeline(CommandBuffer* command_buffer, Pipeline* pipeline) {
-    vkCmdBindPipeline(command_buffer->vk_command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->vk_pipeline);
+    vkCmdBindPipeline(command_buffer->vk_command_buffer, pipeline->vk_bind_point, pipeline->vk_pipeline);
+    stats::Count(STAT_PIPELINE_BINDS);
+}
+void Draw(CommandBuffer* command_buffer, uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex,
+          uint32_t first_instance) {
+    vkCmdDraw(command_buffer->vk_command_buffer, vertex_count, instance_count, first_vertex, first_instance);
+    stats::Count(STAT_DRAW_CALLS);
+    stats::Count(STAT_DRAWN_VERTICES, uint64_t(vertex_count) * instance_count);
+}
+void DrawIndexed(CommandBuffer* command_buffer, uint32_t index_count, uint32_t instance_count, uint32_t first_index,
+                 int32_t vertex_offset, uint32_t first_instance) {
+    vkCmdDrawIndexed(command_buffer->vk_command_buffer, index_count, instance_count, first_index, vertex_offset,
+                     first_instance);
+    stats::Count(STAT_DRAW_CALLS);
+    stats::Count(STAT_DRAWN_VERTICES, uint64_t(index_count) * instance_count);
 }
 } // namespace command
 
 bool submission_active = true;
 
-std::thread submission_thread = std::thread(SubmissionThread);
 std::mutex submission_queue_mutex{};
-std::deque<std::function<void()>> submission_function_queue{};
+std::vector<std::function<void()>> submission_function_queue{};
+size_t submission_function_queue_head = 0;
 std::condition_variable submission_queue_condition{};
 
 std::condition_variable submission_empty_condition{};
@@ -1018,44 +1667,136 @@ std::condition_variable submission_empty_condition{};
 std::mutex submission_mutex{};
 std::condition_variable submission_condition{};
 
+#ifdef ENGINE_ENABLE_TRACING
+// Only touched by the submission thread, a present continues the flow of the submission queued before it
+uint64_t submitted_trace_flow_id = 0;
+#endif
+// Started after the globals above are constructed, it waits on them as soon as it runs
+std::thread submission_thread = std::thread(SubmissionThread);
+
 void SubmissionThread() {
+    CORE_TRACE_THREAD_NAME("submission");
     while (submission_active) {
         std::unique_lock lock(submission_queue_mutex);
-        submission_queue_condition.wait(lock, []() { return submission_function_queue.size() > 0; });
-        std::function<void()> function = submission_function_queue.front();
+        submission_queue_condition.wait(
+            lock, []() { return submission_function_queue_head < submission_function_queue.size(); });
+        // Stays queued while it runs, so AwaitIdle also waits for the function in flight
+        std::function<void()> function = std::move(submission_function_queue[submission_function_queue_head]);
         lock.unlock();
         function();
 
         lock.lock();
-        submission_function_queue.pop_front();
+        submission_function_queue_head++;
+        if (submission_function_queue_head == submission_function_queue.size()) {
+            submission_function_queue.clear();
+            submission_function_queue_head = 0;
+        }
         lock.unlock();
         submission_empty_condition.notify_one();
     }
 }
-void SubmitUniversalAsync(SubmitInfo submit_info) {
+namespace {
+template <typename T> core::ArenaVector<T> CopyToArena(const core::ArenaVector<T>& source, core::Arena* arena) {
+    return core::ArenaVector<T>(source.begin(), source.end(), arena);
+}
+/* The info copied into the frame arena, so the queued function only holds a pointer to it. Pooled objects are
+ * kept as handles and resolved on the submission thread, where one destroyed meanwhile resolves to nullptr. */
+struct SubmitRecord {
+    core::ArenaVector<Semaphore> wait_semaphores;
+    VkPipelineStageFlags wait_stage_flags;
+    core::ArenaVector<Semaphore> signal_semaphores;
+    FenceHandle fence;
+    CommandPoolHandle command_pool;
+    CommandBufferHandle command_buffer;
+    std::function<void()> submitted;
+    uint32_t frame_slot;
+};
+struct PresentRecord {
+    core::ArenaVector<Semaphore> wait_semaphores;
+    core::ArenaVector<SwapchainHandle> swapchain_handles;
+    core::ArenaVector<uint32_t> image_indices;
+    core::ArenaVector<FenceHandle> fences;
+    std::function<void()> presented;
+    uint32_t frame_slot;
+    // Filled on the submission thread with the swapchains still alive, while they cannot be recreated
+    uint32_t swapchain_count;
+    core::ArenaVector<Swapchain*> swapchains;
+    core::ArenaVector<VkSwapchainKHR> vk_swapchains;
+    core::ArenaVector<VkResult> results;
+    // Swapchains by address, the order their usage mutexes are locked in
+    core::ArenaVector<Swapchain*> locking_order;
+};
+FenceHandle HandleOfFence(Fence* fence) { return fence != nullptr ? core::pool::HandleOf(fence) : FenceHandle{}; }
+} // namespace
+namespace {
+void SubmitAsync(const SubmitInfo& info, DeviceQueue* queue) {
+    // Caught here rather than on the submission thread, where a destroyed object would be used much later
+    assert(core::pool::Alive(info.command_buffer) && (info.fence == nullptr || core::pool::Alive(info.fence)));
+    core::Arena* arena = FrameArena();
+    SubmitRecord* record = core::arena::New<SubmitRecord>(arena);
+    record->wait_semaphores = CopyToArena(info.wait_semaphores, arena);
+    record->wait_stage_flags = info.wait_stage_flags;
+    record->signal_semaphores = CopyToArena(info.signal_semaphores, arena);
+    record->fence = HandleOfFence(info.fence);
+    record->command_pool = core::pool::HandleOf(info.command_pool);
+    record->command_buffer = core::pool::HandleOf(info.command_buffer);
+    record->submitted = info.submitted;
+    record->frame_slot = PinFrameArena();
+
     submission_queue_mutex.lock();
-    submission_function_queue.emplace_back([submit_info]() {
-        render::command_pool::AwaitRecord(submit_info.command_pool, submit_info.command_buffer);
+    submission_function_queue.emplace_back([record, queue]() {
+        Fence* fence = Resolve(record->fence);
+        if (record->fence && fence == nullptr) {
+            RENDER_LOG_RATE_LIMITED(ERROR, 1000, "QUEUE SUBMISSION: Fence Destroyed Before Submission!");
+        }
+        CommandPool* command_pool = Resolve(record->command_pool);
+        CommandBuffer* command_buffer =
+            command_pool != nullptr ? Resolve(command_pool, record->command_buffer) : nullptr;
+        if (command_buffer != nullptr) {
+            render::command_pool::AwaitRecord(command_pool, command_buffer);
+        } else {
+            RENDER_LOG_RATE_LIMITED(ERROR, 1000, "QUEUE SUBMISSION: Command Buffer Destroyed Before Submission!");
+        }
 
         VkSubmitInfo vk_submit_info{};
         vk_submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         vk_submit_info.pNext = nullptr;
 
-        vk_submit_info.waitSemaphoreCount = (uint32_t)submit_info.wait_semaphores.size();
-        vk_submit_info.pWaitSemaphores = (VkSemaphore*)submit_info.wait_semaphores.data();
-        vk_submit_info.pWaitDstStageMask = &submit_info.wait_stage_flags;
+        vk_submit_info.waitSemaphoreCount = (uint32_t)record->wait_semaphores.size();
+        vk_submit_info.pWaitSemaphores = (VkSemaphore*)record->wait_semaphores.data();
+        vk_submit_info.pWaitDstStageMask = &record->wait_stage_flags;
 
-        vk_submit_info.signalSemaphoreCount = (uint32_t)submit_info.signal_semaphores.size();
-        vk_submit_info.pSignalSemaphores = (VkSemaphore*)submit_info.signal_semaphores.data();
+        vk_submit_info.signalSemaphoreCount = (uint32_t)record->signal_semaphores.size();
+        vk_submit_info.pSignalSemaphores = (VkSemaphore*)record->signal_semaphores.data();
 
-        vk_submit_info.commandBufferCount = 1;
-        vk_submit_info.pCommandBuffers = &submit_info.command_buffer->vk_command_buffer;
+        // Without its command buffer the submission still waits and signals, so the frame keeps its ordering
+        vk_submit_info.commandBufferCount = command_buffer != nullptr ? 1 : 0;
+        vk_submit_info.pCommandBuffers = command_buffer != nullptr ? &command_buffer->vk_command_buffer : nullptr;
 
-        vkQueueSubmit(render::context.universal_queue.vk_queue, 1, &vk_submit_info, submit_info.fence->vk_fence);
+        {
+            CORE_TRACE_ZONE("vkQueueSubmit");
+            if (command_buffer != nullptr) {
+                CORE_TRACE_FLOW_STEP("frame", command_buffer->trace_flow_id);
+            }
+            vkQueueSubmit(queue->vk_queue, 1, &vk_submit_info, fence != nullptr ? fence->vk_fence : VK_NULL_HANDLE);
+        }
+        stats::Count(STAT_QUEUE_SUBMITS);
+#ifdef ENGINE_ENABLE_TRACING
+        if (command_buffer != nullptr) {
+            submitted_trace_flow_id = command_buffer->trace_flow_id;
+        }
+#endif
+        if (record->submitted) {
+            record->submitted();
+        }
 
-        if (submit_info.fence != nullptr) {
+        // Done with the record before the fence lets the caller reuse the frame slot
+        uint32_t frame_slot = record->frame_slot;
+        record->~SubmitRecord();
+        ReleaseFrameArena(frame_slot);
+        if (fence != nullptr) {
             submission_mutex.lock();
-            submit_info.fence->submission_flag = true;
+            fence->submission_flag = true;
             submission_mutex.unlock();
 
             submission_condition.notify_all();
@@ -1064,32 +1805,118 @@ void SubmitUniversalAsync(SubmitInfo submit_info) {
     submission_queue_mutex.unlock();
     submission_queue_condition.notify_one();
 }
-void SubmitCompute(SubmitInfo submit_info) {}
-void SubmitStaging(SubmitInfo submit_info) {}
+} // namespace
+void SubmitUniversalAsync(const SubmitInfo& submit_info) { SubmitAsync(submit_info, &context.universal_queue); }
+void SubmitCompute(const SubmitInfo& submit_info) { SubmitAsync(submit_info, &context.compute_queue); }
+void SubmitStaging(const SubmitInfo& submit_info) {}
+
+void SubmitPresentAsync(const PresentInfo& info) {
+    assert(info.swapchains.size() > 0 && info.swapchains.size() == info.image_indices.size());
+    for (Swapchain* swapchain : info.swapchains) {
+        assert(core::pool::Alive(swapchain));
+    }
+    core::Arena* arena = FrameArena();
+    size_t swapchain_count = info.swapchains.size();
+    PresentRecord* record = core::arena::New<PresentRecord>(arena);
+    record->wait_semaphores = CopyToArena(info.wait_semaphores, arena);
+    record->swapchain_handles = core::ArenaVector<SwapchainHandle>(arena);
+    record->swapchain_handles.reserve(swapchain_count);
+    for (Swapchain* swapchain : info.swapchains) {
+        record->swapchain_handles.emplace_back(core::pool::HandleOf(swapchain));
+    }
+    record->image_indices = CopyToArena(info.image_indices, arena);
+    record->fences = core::ArenaVector<FenceHandle>(arena);
+    record->fences.reserve(info.fences.size());
+    for (Fence* fence : info.fences) {
+        record->fences.emplace_back(HandleOfFence(fence));
+    }
+    record->presented = info.presented;
+    record->frame_slot = PinFrameArena();
+    record->swapchains = core::ArenaVector<Swapchain*>(swapchain_count, nullptr, arena);
+    record->vk_swapchains = core::ArenaVector<VkSwapchainKHR>(swapchain_count, VK_NULL_HANDLE, arena);
+    record->results = core::ArenaVector<VkResult>(swapchain_count, VK_SUCCESS, arena);
+    record->locking_order = core::ArenaVector<Swapchain*>(swapchain_count, nullptr, arena);
+#ifndef NDEBUG
+    core::ArenaVector<Swapchain*> sorted_swapchains = CopyToArena(info.swapchains, arena);
+    std::sort(sorted_swapchains.begin(), sorted_swapchains.end());
+    assert(std::adjacent_find(sorted_swapchains.begin(), sorted_swapchains.end()) == sorted_swapchains.end() &&
+           "swapchain presented twice");
+#endif
 
-void SubmitPresentAsync(PresentInfo present_info) {
     submission_queue_mutex.lock();
-    submission_function_queue.emplace_back([present_info]() {
+    submission_function_queue.emplace_back([record]() {
+        // Swapchains destroyed since the call are left out of the present, with the image indices they had
+        record->swapchain_count = 0;
+        for (size_t i = 0; i < record->swapchain_handles.size(); i++) {
+            Swapchain* swapchain = Resolve(record->swapchain_handles[i]);
+            if (swapchain == nullptr) {
+                RENDER_LOG_RATE_LIMITED(ERROR, 1000, "SWAPCHAIN PRESENTATION: Swapchain Destroyed Before Present!");
+                continue;
+            }
+            record->swapchains[record->swapchain_count] = swapchain;
+            record->image_indices[record->swapchain_count] = record->image_indices[i];
+            record->locking_order[record->swapchain_count] = swapchain;
+            record->swapchain_count++;
+        }
+        uint32_t swapchain_count = record->swapchain_count;
+        std::sort(record->locking_order.begin(), record->locking_order.begin() + swapchain_count);
+
         VkPresentInfoKHR vk_present_info{};
         vk_present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         vk_present_info.pNext = nullptr;
 
-        vk_present_info.waitSemaphoreCount = (uint32_t)present_info.wait_semaphores.size();
-        vk_present_info.pWaitSemaphores = (VkSemaphore*)present_info.wait_semaphores.data();
+        vk_present_info.waitSemaphoreCount = (uint32_t)record->wait_semaphores.size();
+        vk_present_info.pWaitSemaphores = (VkSemaphore*)record->wait_semaphores.data();
 
-        vk_present_info.swapchainCount = (uint32_t)present_info.swapchains.size();
-        vk_present_info.pSwapchains = &present_info.swapchains[0]->vk_swapchain;
-        vk_present_info.pImageIndices = present_info.image_indices.data();
+        vk_present_info.swapchainCount = swapchain_count;
+        vk_present_info.pSwapchains = record->vk_swapchains.data();
+        vk_present_info.pImageIndices = record->image_indices.data();
+        vk_present_info.pResults = record->results.data();
 
-        present_info.swapchains[0]->usage_mutex.lock();
-        vkQueuePresentKHR(context.universal_queue.vk_queue, &vk_present_info);
-        present_info.swapchains[0]->usage_mutex.unlock();
-
-        if (present_info.fence != nullptr) {
-            submission_mutex.lock();
-            present_info.fence->submission_flag = true;
-            submission_mutex.unlock();
+        // Locked in address order, so two threads locking the same swapchains cannot deadlock
+        for (uint32_t i = 0; i < swapchain_count; i++) {
+            record->locking_order[i]->usage_mutex.lock();
+        }
+        for (uint32_t i = 0; i < swapchain_count; i++) {
+            record->vk_swapchains[i] = record->swapchains[i]->vk_swapchain;
+        }
+        if (swapchain_count > 0) {
+            CORE_TRACE_ZONE("vkQueuePresentKHR");
+            CORE_TRACE_FLOW_END("frame", submitted_trace_flow_id);
+            vkQueuePresentKHR(context.universal_queue.vk_queue, &vk_present_info);
+        }
+        for (uint32_t i = 0; i < swapchain_count; i++) {
+            VkResult result = record->results[i];
+            record->swapchains[i]->present_result.store(result, std::memory_order_relaxed);
+            if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+                record->swapchains[i]->out_of_date.store(true);
+                RENDER_LOG_RATE_LIMITED(INFO, 1000, "SWAPCHAIN PRESENTATION: Swapchain Out of Date");
+            } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+                RENDER_LOG_RATE_LIMITED(ERROR, 1000, "SWAPCHAIN PRESENTATION: Failed to Present Swapchain Image!");
+            }
+        }
+        for (uint32_t i = swapchain_count; i > 0; i--) {
+            record->locking_order[i - 1]->usage_mutex.unlock();
+        }
+        if (record->presented) {
+            record->presented();
+        }
 
+        // The frame slot stays pinned until the record is released, so the fences are resolved from it first
+        bool signaled = false;
+        submission_mutex.lock();
+        for (FenceHandle fence_handle : record->fences) {
+            Fence* fence = Resolve(fence_handle);
+            if (fence != nullptr) {
+                fence->submission_flag = true;
+                signaled = true;
+            }
+        }
+        submission_mutex.unlock();
+        uint32_t frame_slot = record->frame_slot;
+        record->~PresentRecord();
+        ReleaseFrameArena(frame_slot);
+        if (signaled) {
             submission_condition.notify_all();
         }
     });
@@ -1099,11 +1926,87 @@ void SubmitPresentAsync(PresentInfo present_info) {
 
 void AwaitIdle() {
     std::unique_lock lock(submission_queue_mutex);
-    submission_empty_condition.wait(lock, []() { return submission_function_queue.size() == 0; });
+    submission_empty_condition.wait(lock, []() { return submission_function_queue.empty(); });
     vkDeviceWaitIdle(render::context.vk_device);
     lock.unlock();
 }
 
+uint64_t frame = 0;
+uint32_t frames_in_flight = DEFAULT_FRAMES_IN_FLIGHT;
+void SetFramesInFlight(uint32_t count) {
+    if (count < 1 || count > MAX_FRAMES_IN_FLIGHT) {
+        RENDER_LOG_WARN("FRAMES IN FLIGHT: {} Outside 1 to {}, Clamping", count, MAX_FRAMES_IN_FLIGHT);
+    }
+    frames_in_flight = std::clamp(count, 1u, (uint32_t)MAX_FRAMES_IN_FLIGHT);
+}
+
+core::Arena frame_arenas[MAX_FRAMES_IN_FLIGHT]{};
+// Work queued on other threads that still holds the frame arena of a slot
+uint32_t frame_arena_pins[MAX_FRAMES_IN_FLIGHT]{};
+std::mutex frame_arena_mutex{};
+std::condition_variable frame_arena_condition{};
+
+core::Arena* FrameArena() {
+    return &frame_arenas[frame % frames_in_flight];
+}
+uint32_t PinFrameArena() {
+    uint32_t slot = frame % frames_in_flight;
+    std::lock_guard<std::mutex> lock(frame_arena_mutex);
+    frame_arena_pins[slot]++;
+    return slot;
+}
+void ReleaseFrameArena(uint32_t slot) {
+    frame_arena_mutex.lock();
+    frame_arena_pins[slot]--;
+    frame_arena_mutex.unlock();
+    frame_arena_condition.notify_all();
+}
+
+std::mutex retirement_mutex{};
+// Destructions paired with the frame that was current when they were retired
+std::deque<std::pair<uint64_t, std::function<void()>>> retirement_queue{};
+
+// Only touched by BeginFrame, kept so retiring stops allocating once it has grown
+std::vector<std::pair<uint64_t, std::function<void()>>> retired_destructions{};
+
+void BeginFrame() {
+    CORE_TRACE_ZONE("BeginFrame");
+    retirement_mutex.lock();
+    frame++;
+    // The fence awaited before this call belongs to frame - frames_in_flight, so it and all earlier frames are done
+    while (retirement_queue.size() > 0 && retirement_queue.front().first + frames_in_flight <= frame) {
+        retired_destructions.emplace_back(std::move(retirement_queue.front()));
+        retirement_queue.pop_front();
+    }
+    retirement_mutex.unlock();
+
+    for (auto& [retirement_frame, destruction] : retired_destructions) {
+        destruction();
+    }
+    retired_destructions.clear();
+
+    /* The fence awaited for the slot was signaled once its submission ran, a present or the end of a
+     * record closure may still be finishing on another thread */
+    uint32_t slot = frame % frames_in_flight;
+    std::unique_lock<std::mutex> lock(frame_arena_mutex);
+    frame_arena_condition.wait(lock, [slot]() { return frame_arena_pins[slot] == 0; });
+    core::arena::Reset(&frame_arenas[slot]);
+}
+void Retire(std::function<void()> destruction) {
+    std::lock_guard<std::mutex> lock(retirement_mutex);
+    retirement_queue.emplace_back(frame, std::move(destruction));
+}
+void FlushRetired() {
+    std::deque<std::pair<uint64_t, std::function<void()>>> retired{};
+    retirement_mutex.lock();
+    retired.swap(retirement_queue);
+    retirement_mutex.unlock();
+
+    for (auto& [retirement_frame, destruction] : retired) {
+        destruction();
+    }
+}
+
 void InitializeSubmission() {}
 void FinalizeSubmission() {
     submission_queue_mutex.lock();
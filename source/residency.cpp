@@ -0,0 +1,244 @@
+#include "residency.h"
+
+#include <algorithm>
+
+#include "render.h"
+
+namespace render {
+namespace {
+struct StreamIn {
+    ResidentAsset* asset;
+    uint32_t level;
+    std::function<bool(uint32_t level)> function;
+};
+VkDeviceSize HeapBudget(ResidencyManager* manager, uint32_t heap_index) {
+    VkDeviceSize budget = manager->budgets[heap_index].budget;
+    if (manager->info.budget_limit != 0) {
+        budget = std::min(budget, manager->info.budget_limit);
+    }
+    return budget;
+}
+// Usage as reported by VMA plus the bytes of levels still in flight, so stream-ins are not started twice over
+VkDeviceSize HeapUsage(ResidencyManager* manager, uint32_t heap_index, VkDeviceSize evicted_bytes) {
+    VkDeviceSize usage = manager->budgets[heap_index].usage + manager->streaming_bytes[heap_index];
+    return usage - std::min(usage, evicted_bytes);
+}
+void EvictLevel(ResidencyManager* manager, ResidentAsset* asset) {
+    uint32_t level = asset->resident_level_count - 1;
+    if (asset->info.evict) {
+        asset->info.evict(level);
+    }
+    asset->resident_level_count--;
+    asset->resident_bytes -= asset->info.level_sizes[level];
+    manager->statistics.evicted_level_count++;
+}
+void FreeAsset(ResidencyManager* manager, ResidentAsset* asset) {
+    while (asset->resident_level_count > 0) {
+        EvictLevel(manager, asset);
+    }
+    delete asset;
+}
+} // namespace
+
+ResidencyManager* CreateResidencyManager(ResidencyInfo info) {
+    auto manager = new ResidencyManager{};
+    manager->info = info;
+
+    const VkPhysicalDeviceMemoryProperties* memory_properties;
+    vmaGetMemoryProperties(context.vma_allocator, &memory_properties);
+
+    VkDeviceSize largest_heap_size = 0;
+    for (uint32_t i = 0; i < memory_properties->memoryHeapCount; i++) {
+        const VkMemoryHeap& heap = memory_properties->memoryHeaps[i];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size > largest_heap_size) {
+            largest_heap_size = heap.size;
+            manager->device_local_heap = i;
+        }
+    }
+    vmaGetHeapBudgets(context.vma_allocator, manager->budgets);
+    return manager;
+}
+void DestroyResidencyManager(ResidencyManager* manager) {
+    for (ResidentAsset* asset : manager->assets) {
+        delete asset;
+    }
+    for (ResidentAsset* asset : manager->unregistered_assets) {
+        delete asset;
+    }
+    delete manager;
+}
+namespace residency {
+ResidentAsset* Register(ResidencyManager* manager, ResidentAssetInfo info) {
+    if (info.level_sizes.size() == 0) {
+        RENDER_LOG_ERROR("RESIDENCY: Resident Asset Requires At Least One Level!");
+        return nullptr;
+    }
+    auto asset = new ResidentAsset{};
+    asset->info = std::move(info);
+    if (asset->info.heap_index == UINT32_MAX) {
+        asset->info.heap_index = manager->device_local_heap;
+    }
+
+    std::lock_guard<std::mutex> lock(manager->mutex);
+    asset->last_used_frame = manager->frame;
+    manager->assets.push_back(asset);
+    return asset;
+}
+void Unregister(ResidencyManager* manager, ResidentAsset* asset) {
+    std::lock_guard<std::mutex> lock(manager->mutex);
+    auto iterator = std::find(manager->assets.begin(), manager->assets.end(), asset);
+    if (iterator == manager->assets.end()) {
+        return;
+    }
+    manager->assets.erase(iterator);
+    // The loader still holds the asset, CompleteStreamIn frees it
+    if (asset->streaming) {
+        asset->unregistered = true;
+        manager->unregistered_assets.push_back(asset);
+        return;
+    }
+    FreeAsset(manager, asset);
+}
+
+void Touch(ResidencyManager* manager, ResidentAsset* asset, float priority, uint32_t requested_level_count) {
+    std::lock_guard<std::mutex> lock(manager->mutex);
+    // An asset touched several times in one frame keeps its most demanding request
+    if (asset->last_used_frame != manager->frame) {
+        asset->priority = priority;
+        asset->requested_level_count = 0;
+    }
+    asset->priority = std::max(asset->priority, priority);
+    asset->requested_level_count = std::max(
+        asset->requested_level_count,
+        std::min(requested_level_count, static_cast<uint32_t>(asset->info.level_sizes.size())));
+    asset->last_used_frame = manager->frame;
+}
+void CompleteStreamIn(ResidencyManager* manager, ResidentAsset* asset, uint32_t level, bool success) {
+    std::lock_guard<std::mutex> lock(manager->mutex);
+    if (!asset->streaming || level != asset->resident_level_count) {
+        RENDER_LOG_ERROR("RESIDENCY: Unexpected Stream In Completion!");
+        return;
+    }
+    asset->streaming = false;
+    manager->streaming_bytes[asset->info.heap_index] -= asset->info.level_sizes[level];
+    if (success) {
+        asset->resident_level_count++;
+        asset->resident_bytes += asset->info.level_sizes[level];
+        manager->statistics.streamed_level_count++;
+    }
+    if (asset->unregistered) {
+        auto& unregistered_assets = manager->unregistered_assets;
+        unregistered_assets.erase(std::find(unregistered_assets.begin(), unregistered_assets.end(), asset));
+        FreeAsset(manager, asset);
+    }
+}
+
+void Update(ResidencyManager* manager) {
+    std::vector<StreamIn> stream_ins{};
+    {
+        std::lock_guard<std::mutex> lock(manager->mutex);
+        manager->frame++;
+
+        // The frame index lets VMA refresh its budget from VK_EXT_memory_budget instead of estimating it
+        vmaSetCurrentFrameIndex(context.vma_allocator, static_cast<uint32_t>(manager->frame));
+        vmaGetHeapBudgets(context.vma_allocator, manager->budgets);
+
+        // Least recently used first, lower priority first among assets used in the same frame
+        std::vector<ResidentAsset*> eviction_order{};
+        for (ResidentAsset* asset : manager->assets) {
+            if (asset->resident_level_count > 1 && !asset->streaming) {
+                eviction_order.push_back(asset);
+            }
+        }
+        std::sort(eviction_order.begin(), eviction_order.end(), [](ResidentAsset* a, ResidentAsset* b) {
+            if (a->last_used_frame != b->last_used_frame) {
+                return a->last_used_frame < b->last_used_frame;
+            }
+            return a->priority < b->priority;
+        });
+
+        // Evictions free memory immediately from the budget's point of view, VMA catches up next frame
+        VkDeviceSize evicted_bytes[VK_MAX_MEMORY_HEAPS]{};
+        for (ResidentAsset* asset : eviction_order) {
+            uint32_t heap_index = asset->info.heap_index;
+            VkDeviceSize budget = HeapBudget(manager, heap_index);
+            VkDeviceSize usage = HeapUsage(manager, heap_index, evicted_bytes[heap_index]);
+            if (usage <= static_cast<VkDeviceSize>(budget * manager->info.budget_fraction)) {
+                continue;
+            }
+            VkDeviceSize eviction_target = static_cast<VkDeviceSize>(budget * manager->info.eviction_fraction);
+            while (asset->resident_level_count > 1 && usage > eviction_target) {
+                VkDeviceSize level_size = asset->info.level_sizes[asset->resident_level_count - 1];
+                EvictLevel(manager, asset);
+                evicted_bytes[heap_index] += level_size;
+                usage -= std::min(usage, level_size);
+            }
+        }
+
+        std::vector<ResidentAsset*> stream_order{};
+        for (ResidentAsset* asset : manager->assets) {
+            if (!asset->streaming && asset->requested_level_count > asset->resident_level_count) {
+                stream_order.push_back(asset);
+            }
+        }
+        std::sort(stream_order.begin(), stream_order.end(), [](ResidentAsset* a, ResidentAsset* b) {
+            if (a->priority != b->priority) {
+                return a->priority > b->priority;
+            }
+            return a->last_used_frame > b->last_used_frame;
+        });
+
+        // Level 0 is always streamed, it is what an asset falls back to once everything else is evicted
+        VkDeviceSize frame_stream_bytes = 0;
+        for (ResidentAsset* asset : stream_order) {
+            uint32_t heap_index = asset->info.heap_index;
+            uint32_t level = asset->resident_level_count;
+            VkDeviceSize level_size = asset->info.level_sizes[level];
+
+            VkDeviceSize budget = HeapBudget(manager, heap_index);
+            VkDeviceSize usage = HeapUsage(manager, heap_index, evicted_bytes[heap_index]);
+            if (level > 0) {
+                // A heap that had to evict this frame gets no new levels, otherwise the two would chase each other
+                if (evicted_bytes[heap_index] > 0) {
+                    continue;
+                }
+                if (usage + level_size > static_cast<VkDeviceSize>(budget * manager->info.budget_fraction)) {
+                    continue;
+                }
+                if (frame_stream_bytes + level_size > manager->info.stream_bytes_per_frame) {
+                    continue;
+                }
+            }
+            asset->streaming = true;
+            manager->streaming_bytes[heap_index] += level_size;
+            frame_stream_bytes += level_size;
+            stream_ins.push_back({asset, level, asset->info.stream_in});
+        }
+
+        ResidencyStatistics& statistics = manager->statistics;
+        statistics.budget = HeapBudget(manager, manager->device_local_heap);
+        statistics.usage = manager->budgets[manager->device_local_heap].usage;
+        statistics.resident_bytes = 0;
+        statistics.streaming_bytes = manager->streaming_bytes[manager->device_local_heap];
+        statistics.resident_asset_count = 0;
+        for (ResidentAsset* asset : manager->assets) {
+            statistics.resident_bytes += asset->resident_bytes;
+            statistics.resident_asset_count += asset->resident_level_count > 0;
+        }
+    }
+
+    /* Callbacks run unlocked, a synchronous loader may call CompleteStreamIn from within stream_in. They run
+     * from copies, since an asset unregistered meanwhile is freed by the CompleteStreamIn of its loader. An
+     * asset whose stream_in returns false is still streaming, and so still allocated, until reported here. */
+    for (StreamIn& stream_in : stream_ins) {
+        if (!stream_in.function || !stream_in.function(stream_in.level)) {
+            CompleteStreamIn(manager, stream_in.asset, stream_in.level, false);
+        }
+    }
+}
+ResidencyStatistics GetStatistics(ResidencyManager* manager) {
+    std::lock_guard<std::mutex> lock(manager->mutex);
+    return manager->statistics;
+}
+} // namespace residency
+} // namespace render
@@ -0,0 +1,176 @@
+#include "resource.h"
+
+#include "defrag.h"
+#include "render.h"
+#include "stats.h"
+
+namespace render {
+namespace {
+core::Pool<Buffer> buffer_pool{};
+core::Pool<Image> image_pool{};
+} // namespace
+Buffer* Resolve(BufferHandle handle) {
+    return core::pool::Get(&buffer_pool, handle);
+}
+Image* Resolve(ImageHandle handle) {
+    return core::pool::Get(&image_pool, handle);
+}
+
+namespace buffer {
+void Initialize(Buffer* buffer, BufferInfo info) {
+    VkBufferCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    create_info.pNext = nullptr;
+    create_info.size = info.size;
+    create_info.usage = info.usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (info.defragmentable) {
+        // A move copies the buffer into its new VkBuffer
+        create_info.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    }
+
+    VmaAllocationCreateInfo allocation_create_info{};
+    allocation_create_info.usage = info.memory_usage;
+    allocation_create_info.flags = info.allocation_flags;
+    // The defragmenter finds the buffer of an allocation through its user data
+    allocation_create_info.pUserData = &buffer->resource_type;
+
+    VmaAllocationInfo allocation_info{};
+    VkResult result = vmaCreateBuffer(context.vma_allocator, &create_info, &allocation_create_info,
+                                      &buffer->vk_buffer, &buffer->vma_allocation, &allocation_info);
+    if (result != VK_SUCCESS) {
+        RENDER_LOG_ERROR("BUFFER CREATION: Failed to Create VkBuffer!");
+        return;
+    }
+    buffer->size = info.size;
+    buffer->mapping = allocation_info.pMappedData;
+    buffer->usage = create_info.usage;
+    // A move would leave the mapping on the old memory
+    buffer->defragmentable = info.defragmentable && buffer->mapping == nullptr;
+    stats::Count(STAT_BUFFER_ALLOCATIONS);
+}
+void Finalize(Buffer* buffer) {
+    if (buffer->defragmentable) {
+        defragmentation::FinalizeBuffer(buffer);
+    } else {
+        vmaDestroyBuffer(context.vma_allocator, buffer->vk_buffer, buffer->vma_allocation);
+    }
+    *buffer = Buffer{};
+}
+
+void Invalidate(Buffer* buffer) {
+    vmaInvalidateAllocation(context.vma_allocator, buffer->vma_allocation, 0, VK_WHOLE_SIZE);
+}
+void Flush(Buffer* buffer) { vmaFlushAllocation(context.vma_allocator, buffer->vma_allocation, 0, VK_WHOLE_SIZE); }
+} // namespace buffer
+Buffer* CreateBuffer(BufferInfo info) {
+    auto buffer = core::pool::Create(&buffer_pool);
+    buffer::Initialize(buffer, info);
+    return buffer;
+}
+void DestroyBuffer(Buffer* buffer) {
+    buffer::Finalize(buffer);
+    core::pool::Destroy(&buffer_pool, buffer);
+}
+
+namespace image {
+void Initialize(Image* image, ImageInfo info) {
+    image->extent = info.extent;
+    image->format = info.format;
+    image->usage = info.usage;
+    if (info.defragmentable) {
+        // A move copies the image into its new VkImage
+        image->usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    image->aspect = info.aspect;
+    image->defragmentable = info.defragmentable;
+    VkImageCreateInfo create_info = VkCreateInfo(image);
+
+    VmaAllocationCreateInfo allocation_create_info{};
+    allocation_create_info.usage = info.memory_usage;
+    allocation_create_info.pUserData = &image->resource_type;
+
+    VkResult result = vmaCreateImage(context.vma_allocator, &create_info, &allocation_create_info, &image->vk_image,
+                                     &image->vma_allocation, nullptr);
+    if (result != VK_SUCCESS) {
+        RENDER_LOG_ERROR("IMAGE CREATION: Failed to Create VkImage!");
+        return;
+    }
+    stats::Count(STAT_IMAGE_ALLOCATIONS);
+    image->vk_image_view = CreateVkImageView(image, image->vk_image);
+}
+void Finalize(Image* image) {
+    if (image->defragmentable) {
+        defragmentation::FinalizeImage(image);
+    } else {
+        vkDestroyImageView(context.vk_device, image->vk_image_view, nullptr);
+        vmaDestroyImage(context.vma_allocator, image->vk_image, image->vma_allocation);
+    }
+    *image = Image{};
+}
+
+VkImageCreateInfo VkCreateInfo(const Image* image) {
+    VkImageCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.pNext = nullptr;
+    create_info.imageType = image->extent.z > 1 ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+    create_info.format = image->format;
+    create_info.extent = {image->extent.x, image->extent.y, std::max(image->extent.z, 1u)};
+    create_info.mipLevels = 1;
+    create_info.arrayLayers = 1;
+    create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage = image->usage;
+    create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    return create_info;
+}
+VkImageView CreateVkImageView(const Image* image, VkImage vk_image) {
+    VkImageViewCreateInfo view_create_info{};
+    view_create_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_create_info.image = vk_image;
+    view_create_info.viewType = image->extent.z > 1 ? VK_IMAGE_VIEW_TYPE_3D : VK_IMAGE_VIEW_TYPE_2D;
+    view_create_info.format = image->format;
+    view_create_info.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_create_info.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_create_info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_create_info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    view_create_info.subresourceRange.aspectMask = image->aspect;
+    view_create_info.subresourceRange.baseMipLevel = 0;
+    view_create_info.subresourceRange.levelCount = 1;
+    view_create_info.subresourceRange.baseArrayLayer = 0;
+    view_create_info.subresourceRange.layerCount = 1;
+    VkImageView vk_image_view = VK_NULL_HANDLE;
+    if (vkCreateImageView(context.vk_device, &view_create_info, nullptr, &vk_image_view) != VK_SUCCESS) {
+        RENDER_LOG_ERROR("IMAGE CREATION: Failed to Create VkImageView!");
+    }
+    return vk_image_view;
+}
+} // namespace image
+Image* CreateImage(ImageInfo info) {
+    auto image = core::pool::Create(&image_pool);
+    image::Initialize(image, info);
+    return image;
+}
+void DestroyImage(Image* image) {
+    image::Finalize(image);
+    core::pool::Destroy(&image_pool, image);
+}
+
+namespace command {
+void CopyBuffer(CommandBuffer* command_buffer, Buffer* source, Buffer* destination, VkDeviceSize size,
+                VkDeviceSize source_offset, VkDeviceSize destination_offset) {
+    VkBufferCopy region{source_offset, destination_offset, size};
+    vkCmdCopyBuffer(command_buffer->vk_command_buffer, source->vk_buffer, destination->vk_buffer, 1, &region);
+    if (source->mapping != nullptr) {
+        stats::Count(STAT_UPLOADED_BYTES, size);
+    }
+}
+void BindIndexBuffer(CommandBuffer* command_buffer, Buffer* buffer, VkIndexType index_type, VkDeviceSize offset) {
+    vkCmdBindIndexBuffer(command_buffer->vk_command_buffer, buffer->vk_buffer, offset, index_type);
+}
+void BindVertexBuffer(CommandBuffer* command_buffer, uint32_t binding, Buffer* buffer, VkDeviceSize offset) {
+    vkCmdBindVertexBuffers(command_buffer->vk_command_buffer, binding, 1, &buffer->vk_buffer, &offset);
+}
+} // namespace command
+} // namespace render
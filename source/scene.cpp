@@ -0,0 +1,89 @@
+#include "scene.h"
+
+#include <algorithm>
+
+#include "trace.h"
+
+namespace core {
+namespace {
+void UpdateRange(TransformHierarchy* hierarchy, const uint32_t* nodes, uint32_t count) {
+    const uint32_t* parents = hierarchy->parents.data();
+    const Vec3* positions = hierarchy->positions.data();
+    const Quat* rotations = hierarchy->rotations.data();
+    const Vec3* scales = hierarchy->scales.data();
+    Mat4* world_matrices = hierarchy->world_matrices.data();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t node = nodes[i];
+        Mat4 local = mat4::Compose(positions[node], rotations[node], scales[node]);
+        uint32_t parent = parents[node];
+        world_matrices[node] = parent == NO_PARENT ? local : world_matrices[parent] * local;
+    }
+}
+} // namespace
+
+TransformHierarchy* CreateTransformHierarchy(TransformHierarchyInfo info) {
+    auto hierarchy = new TransformHierarchy{};
+    hierarchy->info = info;
+    hierarchy->info.nodes_per_job = std::max(info.nodes_per_job, 1u);
+    hierarchy->parents.reserve(info.node_capacity);
+    hierarchy->positions.reserve(info.node_capacity);
+    hierarchy->rotations.reserve(info.node_capacity);
+    hierarchy->scales.reserve(info.node_capacity);
+    hierarchy->world_matrices.reserve(info.node_capacity);
+    hierarchy->depths.reserve(info.node_capacity);
+    return hierarchy;
+}
+void DestroyTransformHierarchy(TransformHierarchy* hierarchy) { delete hierarchy; }
+namespace transform_hierarchy {
+uint32_t AddNode(TransformHierarchy* hierarchy, uint32_t parent, const Transform& local) {
+    uint32_t node = (uint32_t)hierarchy->parents.size();
+    uint32_t depth = parent == NO_PARENT ? 0 : hierarchy->depths[parent] + 1;
+    hierarchy->parents.emplace_back(parent);
+    hierarchy->positions.emplace_back(local.position);
+    hierarchy->rotations.emplace_back(local.rotation);
+    hierarchy->scales.emplace_back(local.scale);
+    hierarchy->world_matrices.emplace_back();
+    hierarchy->depths.emplace_back(depth);
+    if (depth == hierarchy->levels.size()) {
+        hierarchy->levels.emplace_back();
+    }
+    hierarchy->levels[depth].emplace_back(node);
+    return node;
+}
+void SetLocal(TransformHierarchy* hierarchy, uint32_t node, const Transform& local) {
+    hierarchy->positions[node] = local.position;
+    hierarchy->rotations[node] = local.rotation;
+    hierarchy->scales[node] = local.scale;
+}
+void Clear(TransformHierarchy* hierarchy) {
+    hierarchy->parents.clear();
+    hierarchy->positions.clear();
+    hierarchy->rotations.clear();
+    hierarchy->scales.clear();
+    hierarchy->world_matrices.clear();
+    hierarchy->depths.clear();
+    hierarchy->levels.clear();
+}
+
+void Update(TransformHierarchy* hierarchy) {
+    CORE_TRACE_ZONE("transform_hierarchy::Update");
+    ThreadPool* pool = hierarchy->info.thread_pool;
+    uint32_t max_job_count = pool == nullptr ? 1 : (uint32_t)pool->threads.size() + 1;
+    for (const std::vector<uint32_t>& level : hierarchy->levels) {
+        uint32_t count = (uint32_t)level.size();
+        uint32_t job_count = std::min(max_job_count, (count + hierarchy->info.nodes_per_job - 1) /
+                                                         hierarchy->info.nodes_per_job);
+        if (job_count <= 1) {
+            UpdateRange(hierarchy, level.data(), count);
+            continue;
+        }
+        uint32_t job_size = (count + job_count - 1) / job_count;
+        threadpool::Dispatch(pool, job_count, [hierarchy, &level, count, job_size](uint32_t job) {
+            uint32_t begin = std::min(count, job * job_size);
+            uint32_t end = std::min(count, begin + job_size);
+            UpdateRange(hierarchy, level.data() + begin, end - begin);
+        });
+    }
+}
+} // namespace transform_hierarchy
+} // namespace core
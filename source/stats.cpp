@@ -0,0 +1,142 @@
+#include "stats.h"
+
+namespace render {
+namespace stats {
+std::atomic<uint64_t> counters[STAT_COUNT]{};
+} // namespace stats
+
+namespace {
+const VkQueryPipelineStatisticFlags PIPELINE_STATISTIC_FLAGS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+void Resolve(Stats* stats, PipelineStatisticsQuery* query) {
+    // The last element is the availability of the query
+    uint64_t results[PIPELINE_STATISTIC_COUNT + 1]{};
+    VkResult result = vkGetQueryPoolResults(context.vk_device, query->vk_query_pool, 0, 1, sizeof(results), results,
+                                            sizeof(results),
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if ((result != VK_SUCCESS && result != VK_NOT_READY) || results[PIPELINE_STATISTIC_COUNT] == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(stats->mutex);
+    stats->frame_stats.pipeline_statistics_available = true;
+    stats->frame_stats.pipeline_statistics_frame = query->frame;
+    for (uint32_t i = 0; i < PIPELINE_STATISTIC_COUNT; i++) {
+        stats->frame_stats.pipeline_statistics[i] = results[i];
+    }
+}
+} // namespace
+
+Stats* CreateStats(StatsInfo info) {
+    auto stats = new Stats{};
+    stats->info = info;
+    stats->pipeline_statistics_supported = context.vk_enabled_features.pipelineStatisticsQuery == VK_TRUE;
+    for (uint32_t i = 0; i < STAT_COUNT; i++) {
+        stats->counter_snapshot[i] = stats::counters[i].load(std::memory_order_relaxed);
+    }
+    if (!stats->pipeline_statistics_supported) {
+        return stats;
+    }
+    for (PipelineStatisticsQuery& query : stats->queries) {
+        VkQueryPoolCreateInfo create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        create_info.pNext = nullptr;
+        create_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        create_info.queryCount = 1;
+        create_info.pipelineStatistics = PIPELINE_STATISTIC_FLAGS;
+        VkResult result = vkCreateQueryPool(context.vk_device, &create_info, nullptr, &query.vk_query_pool);
+        if (result != VK_SUCCESS) {
+            RENDER_LOG_ERROR("STATS: Failed to Create VkQueryPool!");
+            stats->pipeline_statistics_supported = false;
+        }
+    }
+    return stats;
+}
+void DestroyStats(Stats* stats) {
+    for (PipelineStatisticsQuery& query : stats->queries) {
+        vkDestroyQueryPool(context.vk_device, query.vk_query_pool, nullptr);
+    }
+    delete stats;
+}
+namespace stats {
+PipelineStatisticsQuery* BeginFrame(Stats* stats) {
+    stats->mutex.lock();
+    stats->frame_stats.frame = frame - 1;
+    for (uint32_t i = 0; i < STAT_COUNT; i++) {
+        uint64_t count = counters[i].load(std::memory_order_relaxed);
+        stats->frame_stats.counters[i] = count - stats->counter_snapshot[i];
+        stats->counter_snapshot[i] = count;
+    }
+    stats->mutex.unlock();
+
+    PipelineStatisticsQuery* query = &stats->queries[frame % frames_in_flight];
+    if (query->recorded) {
+        Resolve(stats, query);
+    }
+    query->frame = frame;
+    query->recorded = false;
+
+    if (stats->info.log_interval_frames > 0 && frame % stats->info.log_interval_frames == 0) {
+        Log(Snapshot(stats));
+    }
+    return query;
+}
+FrameStats Snapshot(Stats* stats) {
+    VmaTotalStatistics total_statistics{};
+    vmaCalculateStatistics(context.vma_allocator, &total_statistics);
+
+    std::lock_guard<std::mutex> lock(stats->mutex);
+    FrameStats frame_stats = stats->frame_stats;
+    frame_stats.vma_statistics = total_statistics.total.statistics;
+    return frame_stats;
+}
+void Log(const FrameStats& frame_stats) {
+    const uint64_t* counters = frame_stats.counters;
+    RENDER_LOG_INFO("STATS: Frame {}, {} Draws, {} Vertices, {} Dispatches, {} Pipeline Binds, {} Submits, "
+                    "{} Command Buffers, {} Buffers, {} Images, {} KB Uploaded, {} Binds Elided",
+                    frame_stats.frame, counters[STAT_DRAW_CALLS], counters[STAT_DRAWN_VERTICES],
+                    counters[STAT_DISPATCHES], counters[STAT_PIPELINE_BINDS], counters[STAT_QUEUE_SUBMITS],
+                    counters[STAT_COMMAND_BUFFERS_RECORDED], counters[STAT_BUFFER_ALLOCATIONS],
+                    counters[STAT_IMAGE_ALLOCATIONS], counters[STAT_UPLOADED_BYTES] / 1024,
+                    counters[STAT_ELIDED_BINDS]);
+    const VmaStatistics& vma = frame_stats.vma_statistics;
+    RENDER_LOG_INFO("STATS: VMA {} Blocks Of {} MB, {} Allocations Of {} MB", vma.blockCount,
+                    vma.blockBytes / (1024 * 1024), vma.allocationCount, vma.allocationBytes / (1024 * 1024));
+    if (frame_stats.pipeline_statistics_available) {
+        const uint64_t* statistics = frame_stats.pipeline_statistics;
+        RENDER_LOG_INFO("STATS: Frame {} Pipeline, {} Vertices, {} Primitives, {} Vertex Invocations, "
+                        "{} Clipped Primitives, {} Fragment Invocations, {} Compute Invocations",
+                        frame_stats.pipeline_statistics_frame,
+                        statistics[PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES],
+                        statistics[PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES],
+                        statistics[PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS],
+                        statistics[PIPELINE_STATISTIC_CLIPPING_PRIMITIVES],
+                        statistics[PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS],
+                        statistics[PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS]);
+    }
+}
+} // namespace stats
+
+namespace command {
+void BeginPipelineStatistics(CommandBuffer* command_buffer, Stats* stats, PipelineStatisticsQuery* query) {
+    if (!stats->pipeline_statistics_supported) {
+        return;
+    }
+    vkCmdResetQueryPool(command_buffer->vk_command_buffer, query->vk_query_pool, 0, 1);
+    vkCmdBeginQuery(command_buffer->vk_command_buffer, query->vk_query_pool, 0, 0);
+    query->recorded = true;
+}
+void EndPipelineStatistics(CommandBuffer* command_buffer, Stats* stats, PipelineStatisticsQuery* query) {
+    if (!query->recorded) {
+        return;
+    }
+    vkCmdEndQuery(command_buffer->vk_command_buffer, query->vk_query_pool, 0);
+}
+} // namespace command
+} // namespace render
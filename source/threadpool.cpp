@@ -0,0 +1,112 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+#include "trace.h"
+
+namespace core {
+ThreadPool* CreateThreadPool(uint32_t thread_count) {
+    auto pool = new ThreadPool{};
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency() - 1);
+    }
+    for (uint32_t i = 0; i < thread_count; i++) {
+        pool->threads.emplace_back(threadpool::ThreadFunction, pool);
+    }
+    return pool;
+}
+void DestroyThreadPool(ThreadPool* pool) {
+    pool->mutex.lock();
+    pool->active = false;
+    pool->mutex.unlock();
+    pool->condition_variable.notify_all();
+
+    for (std::thread& thread : pool->threads) {
+        thread.join();
+    }
+    delete pool;
+}
+namespace threadpool {
+void Enqueue(ThreadPool* pool, std::function<void()> function, JobPriority priority) {
+    pool->mutex.lock();
+    pool->job_queues[priority].emplace_back(std::move(function));
+    pool->mutex.unlock();
+    pool->condition_variable.notify_one();
+}
+void AwaitIdle(ThreadPool* pool) {
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    pool->idle_condition_variable.wait(lock, [pool]() {
+        if (pool->running_job_count > 0) {
+            return false;
+        }
+        for (auto& queue : pool->job_queues) {
+            if (queue.size() > 0) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void Dispatch(ThreadPool* pool, uint32_t job_count, const std::function<void(uint32_t)>& function) {
+    if (pool == nullptr || job_count <= 1) {
+        for (uint32_t job = 0; job < job_count; job++) {
+            function(job);
+        }
+        return;
+    }
+    // Waits on its own jobs only, AwaitIdle would also wait out unrelated work queued on the pool
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    uint32_t remaining = job_count - 1;
+    for (uint32_t job = 1; job < job_count; job++) {
+        Enqueue(
+            pool,
+            [&, job]() {
+                function(job);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--remaining == 0) {
+                    condition.notify_one();
+                }
+            },
+            JOB_PRIORITY_HIGH);
+    }
+    function(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&remaining]() { return remaining == 0; });
+}
+
+void ThreadFunction(ThreadPool* pool) {
+    CORE_TRACE_THREAD_NAME("worker");
+    std::unique_lock<std::mutex> lock(pool->mutex);
+    while (true) {
+        std::deque<std::function<void()>>* queue = nullptr;
+        pool->condition_variable.wait(lock, [pool, &queue]() {
+            for (int priority = JOB_PRIORITY_COUNT - 1; priority >= 0; priority--) {
+                if (pool->job_queues[priority].size() > 0) {
+                    queue = &pool->job_queues[priority];
+                    return true;
+                }
+            }
+            return !pool->active;
+        });
+        if (queue == nullptr) {
+            return;
+        }
+        auto function = std::move(queue->front());
+        queue->pop_front();
+        pool->running_job_count++;
+        lock.unlock();
+
+        {
+            CORE_TRACE_ZONE("Job");
+            function();
+        }
+
+        lock.lock();
+        pool->running_job_count--;
+        pool->idle_condition_variable.notify_all();
+    }
+}
+} // namespace threadpool
+} // namespace core
@@ -0,0 +1,270 @@
+#include "trace.h"
+
+#ifdef ENGINE_ENABLE_TRACING
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace core {
+namespace {
+// Function local so threads started during static initialization, such as the submission thread, can trace
+std::mutex& BufferMutex() {
+    static std::mutex mutex{};
+    return mutex;
+}
+std::vector<std::unique_ptr<TraceBuffer>>& Buffers() {
+    static std::vector<std::unique_ptr<TraceBuffer>> buffers{};
+    return buffers;
+}
+std::chrono::steady_clock::time_point Epoch() {
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return epoch;
+}
+std::atomic<uint64_t> next_flow_id{1};
+
+// Registration is the only locked step, it happens once per thread
+TraceBuffer* ThreadBuffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        auto owned_buffer = std::make_unique<TraceBuffer>();
+        buffer = owned_buffer.get();
+        std::lock_guard<std::mutex> lock(BufferMutex());
+        buffer->thread_index = static_cast<uint32_t>(Buffers().size()) + 1;
+        Buffers().emplace_back(std::move(owned_buffer));
+    }
+    return buffer;
+}
+
+struct ThreadEvents {
+    uint32_t thread_index;
+    const char* thread_name;
+    std::vector<TraceEvent> events;
+};
+// Copies out the events still held by every buffer, oldest first
+std::vector<ThreadEvents> Collect() {
+    std::vector<ThreadEvents> threads{};
+    std::lock_guard<std::mutex> lock(BufferMutex());
+    for (auto& buffer : Buffers()) {
+        uint64_t write_index = buffer->write_index.load(std::memory_order_acquire);
+        uint64_t first = write_index > CORE_TRACE_BUFFER_CAPACITY ? write_index - CORE_TRACE_BUFFER_CAPACITY : 0;
+        ThreadEvents thread{buffer->thread_index, buffer->thread_name.load(std::memory_order_relaxed), {}};
+        thread.events.reserve(write_index - first);
+        for (uint64_t i = first; i < write_index; i++) {
+            thread.events.emplace_back(buffer->events[i % CORE_TRACE_BUFFER_CAPACITY]);
+        }
+        threads.emplace_back(std::move(thread));
+    }
+    return threads;
+}
+
+void WriteEscaped(FILE* file, const char* string) {
+    for (; *string != '\0'; string++) {
+        if (*string == '"' || *string == '\\') {
+            fputc('\\', file);
+        }
+        fputc(*string, file);
+    }
+}
+bool WriteChromeJSON(FILE* file, const std::vector<ThreadEvents>& threads) {
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&first, file]() {
+        if (!first) {
+            fprintf(file, ",\n");
+        }
+        first = false;
+    };
+    for (const ThreadEvents& thread : threads) {
+        if (thread.thread_name != nullptr) {
+            separator();
+            fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                    thread.thread_index);
+            WriteEscaped(file, thread.thread_name);
+            fprintf(file, "\"}}");
+        }
+        for (const TraceEvent& event : thread.events) {
+            // Flow events bind to the zone enclosing them on their thread
+            const char* phase = "B";
+            switch (event.type) {
+            case TRACE_EVENT_ZONE_BEGIN:
+                phase = "B";
+                break;
+            case TRACE_EVENT_ZONE_END:
+                phase = "E";
+                break;
+            case TRACE_EVENT_FLOW_BEGIN:
+                phase = "s";
+                break;
+            case TRACE_EVENT_FLOW_STEP:
+                phase = "t";
+                break;
+            case TRACE_EVENT_FLOW_END:
+                phase = "f";
+                break;
+            }
+            separator();
+            fprintf(file, "{\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"", phase, thread.thread_index,
+                    event.timestamp_ns / 1000.0);
+            WriteEscaped(file, event.name);
+            fprintf(file, "\"");
+            if (event.type >= TRACE_EVENT_FLOW_BEGIN) {
+                fprintf(file, ",\"cat\":\"flow\",\"id\":%llu,\"bp\":\"e\"", (unsigned long long)event.flow_id);
+            }
+            fprintf(file, "}");
+        }
+    }
+    fprintf(file, "\n]}\n");
+    return true;
+}
+
+/* A minimal protobuf writer for the few perfetto.protos.TracePacket fields used, so the engine does
+ * not depend on the Perfetto SDK. */
+struct ProtoWriter {
+    std::vector<uint8_t> bytes{};
+
+    void Varint(uint64_t value) {
+        while (value >= 0x80) {
+            bytes.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        bytes.push_back(static_cast<uint8_t>(value));
+    }
+    void Tag(uint32_t field, uint32_t wire_type) { Varint((uint64_t(field) << 3) | wire_type); }
+    void VarintField(uint32_t field, uint64_t value) {
+        Tag(field, 0);
+        Varint(value);
+    }
+    void Fixed64Field(uint32_t field, uint64_t value) {
+        Tag(field, 1);
+        for (int i = 0; i < 8; i++) {
+            bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+    void BytesField(uint32_t field, const void* data, size_t size) {
+        Tag(field, 2);
+        Varint(size);
+        bytes.insert(bytes.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+    }
+    void StringField(uint32_t field, const char* string) { BytesField(field, string, strlen(string)); }
+    void MessageField(uint32_t field, const ProtoWriter& message) {
+        BytesField(field, message.bytes.data(), message.bytes.size());
+    }
+};
+// Field numbers from perfetto/protos/perfetto/trace/
+enum {
+    TRACE_PACKET = 1,
+    PACKET_TIMESTAMP = 8,
+    PACKET_SEQUENCE_ID = 10,
+    PACKET_TRACK_EVENT = 11,
+    PACKET_SEQUENCE_FLAGS = 13,
+    PACKET_TRACK_DESCRIPTOR = 60,
+    DESCRIPTOR_UUID = 1,
+    DESCRIPTOR_NAME = 2,
+    DESCRIPTOR_THREAD = 4,
+    THREAD_PID = 1,
+    THREAD_TID = 2,
+    THREAD_NAME = 5,
+    EVENT_TYPE = 9,
+    EVENT_TRACK_UUID = 11,
+    EVENT_NAME = 23,
+    EVENT_FLOW_IDS = 47,
+    EVENT_TERMINATING_FLOW_IDS = 48,
+    EVENT_TYPE_SLICE_BEGIN = 1,
+    EVENT_TYPE_SLICE_END = 2,
+    EVENT_TYPE_INSTANT = 3,
+    SEQUENCE_INCREMENTAL_STATE_CLEARED = 1,
+};
+bool WritePerfetto(FILE* file, const std::vector<ThreadEvents>& threads) {
+    ProtoWriter trace{};
+    for (const ThreadEvents& thread : threads) {
+        uint32_t sequence_id = thread.thread_index;
+        uint64_t track_uuid = thread.thread_index;
+
+        ProtoWriter thread_descriptor{};
+        thread_descriptor.VarintField(THREAD_PID, 1);
+        thread_descriptor.VarintField(THREAD_TID, thread.thread_index);
+        if (thread.thread_name != nullptr) {
+            thread_descriptor.StringField(THREAD_NAME, thread.thread_name);
+        }
+        ProtoWriter track_descriptor{};
+        track_descriptor.VarintField(DESCRIPTOR_UUID, track_uuid);
+        track_descriptor.MessageField(DESCRIPTOR_THREAD, thread_descriptor);
+        ProtoWriter packet{};
+        packet.VarintField(PACKET_SEQUENCE_ID, sequence_id);
+        packet.VarintField(PACKET_SEQUENCE_FLAGS, SEQUENCE_INCREMENTAL_STATE_CLEARED);
+        packet.MessageField(PACKET_TRACK_DESCRIPTOR, track_descriptor);
+        trace.MessageField(TRACE_PACKET, packet);
+
+        for (const TraceEvent& event : thread.events) {
+            ProtoWriter track_event{};
+            track_event.VarintField(EVENT_TRACK_UUID, track_uuid);
+            switch (event.type) {
+            case TRACE_EVENT_ZONE_BEGIN:
+                track_event.VarintField(EVENT_TYPE, EVENT_TYPE_SLICE_BEGIN);
+                track_event.StringField(EVENT_NAME, event.name);
+                break;
+            case TRACE_EVENT_ZONE_END:
+                track_event.VarintField(EVENT_TYPE, EVENT_TYPE_SLICE_END);
+                break;
+            case TRACE_EVENT_FLOW_BEGIN:
+            case TRACE_EVENT_FLOW_STEP:
+                // Perfetto attaches flows to events, so each flow point is an instant on its thread
+                track_event.VarintField(EVENT_TYPE, EVENT_TYPE_INSTANT);
+                track_event.StringField(EVENT_NAME, event.name);
+                track_event.Fixed64Field(EVENT_FLOW_IDS, event.flow_id);
+                break;
+            case TRACE_EVENT_FLOW_END:
+                track_event.VarintField(EVENT_TYPE, EVENT_TYPE_INSTANT);
+                track_event.StringField(EVENT_NAME, event.name);
+                track_event.Fixed64Field(EVENT_TERMINATING_FLOW_IDS, event.flow_id);
+                break;
+            }
+            ProtoWriter event_packet{};
+            event_packet.VarintField(PACKET_TIMESTAMP, event.timestamp_ns);
+            event_packet.VarintField(PACKET_SEQUENCE_ID, sequence_id);
+            event_packet.MessageField(PACKET_TRACK_EVENT, track_event);
+            trace.MessageField(TRACE_PACKET, event_packet);
+        }
+    }
+    return fwrite(trace.bytes.data(), 1, trace.bytes.size(), file) == trace.bytes.size();
+}
+} // namespace
+
+namespace trace {
+void Record(TraceEventType type, const char* name, uint64_t flow_id) {
+    TraceBuffer* buffer = ThreadBuffer();
+    uint64_t write_index = buffer->write_index.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[write_index % CORE_TRACE_BUFFER_CAPACITY];
+    event.name = name;
+    event.timestamp_ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Epoch()).count();
+    event.flow_id = flow_id;
+    event.type = type;
+    buffer->write_index.store(write_index + 1, std::memory_order_release);
+}
+void SetThreadName(const char* name) { ThreadBuffer()->thread_name.store(name, std::memory_order_relaxed); }
+uint64_t NewFlowId() { return next_flow_id.fetch_add(1, std::memory_order_relaxed); }
+
+bool Write(const std::string& filepath) {
+    bool json = filepath.size() >= 5 && filepath.compare(filepath.size() - 5, 5, ".json") == 0;
+    return Write(filepath, json ? TRACE_FORMAT_CHROME_JSON : TRACE_FORMAT_PERFETTO);
+}
+bool Write(const std::string& filepath, TraceFormat format) {
+    FILE* file = fopen(filepath.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    std::vector<ThreadEvents> threads = Collect();
+    bool result = format == TRACE_FORMAT_CHROME_JSON ? WriteChromeJSON(file, threads) : WritePerfetto(file, threads);
+    fclose(file);
+    return result;
+}
+} // namespace trace
+} // namespace core
+
+#endif
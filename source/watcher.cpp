@@ -0,0 +1,151 @@
+#include "watcher.h"
+
+#include <system_error>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+namespace {
+std::string NormalizeFilepath(const std::string& filepath) {
+    std::error_code error{};
+    std::filesystem::path path = std::filesystem::weakly_canonical(filepath, error);
+    if (error) {
+        path = std::filesystem::absolute(filepath, error).lexically_normal();
+    }
+    return path.string();
+}
+std::filesystem::file_time_type ModificationTime(const std::string& filepath) {
+    std::error_code error{};
+    auto time = std::filesystem::last_write_time(filepath, error);
+    return error ? std::filesystem::file_time_type::min() : time;
+}
+} // namespace
+
+FileWatcher* CreateFileWatcher(FileWatcherInfo info) {
+    auto watcher = new FileWatcher{};
+    watcher->poll_interval_ms = info.poll_interval_ms;
+#ifdef __linux__
+    watcher->inotify_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    watcher->thread = std::thread(file_watcher::WatcherThreadFunction, watcher);
+    return watcher;
+}
+void DestroyFileWatcher(FileWatcher* watcher) {
+    watcher->mutex.lock();
+    watcher->active = false;
+    watcher->mutex.unlock();
+    watcher->thread.join();
+#ifdef __linux__
+    if (watcher->inotify_descriptor >= 0) {
+        close(watcher->inotify_descriptor);
+    }
+#endif
+    delete watcher;
+}
+namespace file_watcher {
+std::string Watch(FileWatcher* watcher, std::string filepath) {
+    filepath = NormalizeFilepath(filepath);
+    std::string directory = std::filesystem::path(filepath).parent_path().string();
+
+    std::lock_guard<std::mutex> lock(watcher->mutex);
+    watcher->filepaths.insert(filepath);
+    watcher->modification_times[filepath] = ModificationTime(filepath);
+#ifdef __linux__
+    if (watcher->inotify_descriptor >= 0) {
+        // Watching the same directory twice returns the existing watch descriptor
+        int watch_descriptor = inotify_add_watch(watcher->inotify_descriptor, directory.c_str(),
+                                                 IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (watch_descriptor >= 0) {
+            watcher->directories[watch_descriptor] = directory;
+        }
+    }
+#endif
+    return filepath;
+}
+void Unwatch(FileWatcher* watcher, std::string filepath) {
+    filepath = NormalizeFilepath(filepath);
+    std::string directory = std::filesystem::path(filepath).parent_path().string();
+
+    std::lock_guard<std::mutex> lock(watcher->mutex);
+    watcher->filepaths.erase(filepath);
+    watcher->modification_times.erase(filepath);
+    watcher->changes.erase(filepath);
+#ifdef __linux__
+    for (const std::string& remaining : watcher->filepaths) {
+        if (std::filesystem::path(remaining).parent_path() == directory) {
+            return;
+        }
+    }
+    for (auto iterator = watcher->directories.begin(); iterator != watcher->directories.end(); iterator++) {
+        if (iterator->second == directory) {
+            inotify_rm_watch(watcher->inotify_descriptor, iterator->first);
+            watcher->directories.erase(iterator);
+            break;
+        }
+    }
+#endif
+}
+
+std::vector<std::string> Poll(FileWatcher* watcher) {
+    std::lock_guard<std::mutex> lock(watcher->mutex);
+    std::vector<std::string> changes(watcher->changes.begin(), watcher->changes.end());
+    watcher->changes.clear();
+    return changes;
+}
+
+void WatcherThreadFunction(FileWatcher* watcher) {
+    while (true) {
+#ifdef __linux__
+        if (watcher->inotify_descriptor >= 0) {
+            pollfd poll_descriptor{watcher->inotify_descriptor, POLLIN, 0};
+            int ready = poll(&poll_descriptor, 1, static_cast<int>(watcher->poll_interval_ms));
+
+            std::lock_guard<std::mutex> lock(watcher->mutex);
+            if (!watcher->active) {
+                return;
+            }
+            if (ready <= 0) {
+                continue;
+            }
+            alignas(inotify_event) char buffer[4096];
+            ssize_t size;
+            while ((size = read(watcher->inotify_descriptor, buffer, sizeof(buffer))) > 0) {
+                for (char* pointer = buffer; pointer < buffer + size;) {
+                    auto event = reinterpret_cast<inotify_event*>(pointer);
+                    pointer += sizeof(inotify_event) + event->len;
+
+                    auto directory = watcher->directories.find(event->wd);
+                    if (event->len == 0 || directory == watcher->directories.end()) {
+                        continue;
+                    }
+                    std::string filepath = (std::filesystem::path(directory->second) / event->name).string();
+                    if (watcher->filepaths.count(filepath) > 0) {
+                        watcher->changes.insert(filepath);
+                    }
+                }
+            }
+            continue;
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::milliseconds(watcher->poll_interval_ms));
+
+        std::lock_guard<std::mutex> lock(watcher->mutex);
+        if (!watcher->active) {
+            return;
+        }
+        for (const std::string& filepath : watcher->filepaths) {
+            auto time = ModificationTime(filepath);
+            auto& previous_time = watcher->modification_times[filepath];
+            if (time != previous_time) {
+                previous_time = time;
+                watcher->changes.insert(filepath);
+            }
+        }
+    }
+}
+} // namespace file_watcher
+} // namespace core
@@ -1,7 +1,7 @@
 #include "window.h"
 
 namespace core {
-void Initialize() { SDL_Init(SDL_INIT_EVERYTHING); }
+void Initialize(uint32_t sdl_subsystems) { SDL_Init(sdl_subsystems); }
 void Finalize() { SDL_Quit(); }
 
 Window CreateWindow(WindowInfo info) {
@@ -27,4 +27,62 @@ void CreateVkSurface(Window window, void* vk_instance, void* vk_surface) {
     SDL_Vulkan_CreateSurface(window.sdl_window, *(VkInstance*)vk_instance, (VkSurfaceKHR*)vk_surface);
 }
 } // namespace window
+
+EventQueue* CreateEventQueue() {
+    auto queue = new EventQueue{};
+    queue->wake_event_type = SDL_RegisterEvents(1);
+    return queue;
+}
+void DestroyEventQueue(EventQueue* queue) { delete queue; }
+namespace event_queue {
+void Pump(EventQueue* queue, int timeout_ms) {
+    SDL_Event event{};
+    if (!SDL_WaitEventTimeout(&event, timeout_ms)) {
+        return;
+    }
+    queue->pending_events.clear();
+    do {
+        if (event.type != queue->wake_event_type) {
+            queue->pending_events.emplace_back(event);
+        }
+    } while (SDL_PollEvent(&event));
+
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    for (const SDL_Event& pending_event : queue->pending_events) {
+        if (pending_event.type == SDL_QUIT) {
+            queue->quit = true;
+        }
+        if (pending_event.type == SDL_WINDOWEVENT && pending_event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+            Extent2D extent = {(uint32_t)pending_event.window.data1, (uint32_t)pending_event.window.data2};
+            // Latest wins, a drag that resizes a hundred times recreates the swapchain once
+            bool coalesced = false;
+            for (WindowResize& resize : queue->resizes) {
+                if (resize.window_id == pending_event.window.windowID) {
+                    resize.extent = extent;
+                    coalesced = true;
+                }
+            }
+            if (!coalesced) {
+                queue->resizes.push_back({pending_event.window.windowID, extent});
+            }
+            continue;
+        }
+        queue->events.emplace_back(pending_event);
+    }
+}
+void Wake(EventQueue* queue) {
+    SDL_Event event{};
+    event.type = queue->wake_event_type;
+    SDL_PushEvent(&event);
+}
+
+void TakeSnapshot(EventQueue* queue, EventSnapshot* snapshot) {
+    snapshot->events.clear();
+    snapshot->resizes.clear();
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    std::swap(snapshot->events, queue->events);
+    std::swap(snapshot->resizes, queue->resizes);
+    snapshot->quit = queue->quit;
+}
+} // namespace event_queue
 } // namespace core
\ No newline at end of file
@@ -0,0 +1,24 @@
+#include "asset.h"
+
+#include <cstring>
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("usage: %s <directory> <output archive> [none|lz4|zstd]\n", argv[0]);
+        return 1;
+    }
+    ASSET_LOG_INITIALIZE
+
+    asset::PackInfo pack_info{};
+    pack_info.directory = argv[1];
+    pack_info.output_filepath = argv[2];
+    if (argc > 3 && strcmp(argv[3], "lz4") == 0) {
+        pack_info.compression = asset::COMPRESSION_LZ4;
+    } else if (argc > 3 && strcmp(argv[3], "zstd") == 0) {
+        pack_info.compression = asset::COMPRESSION_ZSTD;
+    }
+    bool packed = asset::archive::Pack(pack_info);
+
+    ASSET_LOG_FINALIZE
+    return packed ? 0 : 1;
+}